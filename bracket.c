@@ -0,0 +1,321 @@
+/**
+ * @file bracket.c
+ * @author re-nanashi
+ * @brief Bracket matching over the current buffer; the depth of the brackets
+ * of chunks of lines is summed up so a match far away is found without
+ * reading the rows in between
+ */
+
+#include "bracket.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "buflist.h"
+#include "cold.h"
+
+/* @brief Internal macros */
+// Lines of a new chunk; a chunk grown to twice as many is split
+#define BRACKET_CHUNK 256
+// Kinds of brackets; (), [] and {}
+#define BRACKET_KINDS 3
+// Chunks holding a number of lines
+#define CHUNKS(n) (((n) + BRACKET_CHUNK - 1) / BRACKET_CHUNK)
+
+typedef struct {
+    /* number of lines of the chunk */
+    linenr_T lines;
+    /* true if lines of the chunk changed since it was counted */
+    bool dirty;
+    /* change of depth over the chunk for each kind of bracket; an opening
+     * bracket goes one deeper */
+    long delta[BRACKET_KINDS];
+    /* lowest depth reached in the chunk; the depth before it is 0 */
+    long low[BRACKET_KINDS];
+} brchunk_T;
+
+/* @brief Kind of bracket of each byte counted from 1; negative for closing
+ * brackets */
+static const signed char kinds[256] = {
+    ['('] = 1, [')'] = -1, ['['] = 2, [']'] = -2, ['{'] = 3, ['}'] = -3,
+};
+
+/* @brief Chunks of the lines of the buffer in order */
+static brchunk_T *chunks;
+static size_t nchunks, cap;
+/* @brief Number of lines of the buffer counted */
+static linenr_T lines;
+/* @brief Buffer counted; -1 before the first match */
+static int cur_buf = -1;
+/* @brief Chunk found last and its first line; chunks are looked up from it */
+static size_t hint;
+static linenr_T hint_start;
+
+static void
+bracket_grow(size_t n)
+{
+    if (n <= cap) return;
+    cap = n > cap * 2 ? n : cap * 2;
+    chunks = realloc(chunks, sizeof(brchunk_T) * cap);
+}
+
+// Start over for another buffer or one read again
+static void
+bracket_reset()
+{
+    cur_buf = buflist_current();
+    lines = econfig.line_count;
+    nchunks = CHUNKS(lines);
+    bracket_grow(nchunks);
+    for (size_t c = 0; c < nchunks; c++) {
+        linenr_T left = lines - c * BRACKET_CHUNK;
+        chunks[c].lines = left < BRACKET_CHUNK ? left : BRACKET_CHUNK;
+        chunks[c].dirty = true;
+    }
+    hint = hint_start = 0;
+}
+
+// Find the chunk holding a line; lines past the last are in the last chunk
+static size_t
+bracket_chunk(linenr_T lnum, linenr_T *start)
+{
+    if (lnum < hint_start) hint = hint_start = 0;
+    while (hint + 1 < nchunks && hint_start + chunks[hint].lines <= lnum)
+        hint_start += chunks[hint++].lines;
+    *start = hint_start;
+    return hint;
+}
+
+// Text of a row as the parts before and after its gap; packed rows are read
+// without unpacking them
+static void
+bracket_row_text(const editor_row_T *row, const unsigned char **seg,
+                 colnr_T *n)
+{
+    colnr_T len = rbuf_len(row);
+    if (row->cold) {
+        size_t size;
+        seg[0] = (const unsigned char *)cold_text(row, &size);
+        n[0] = len;
+        seg[1] = NULL;
+        n[1] = 0;
+    }
+    else {
+        seg[0] = (const unsigned char *)row->chars;
+        n[0] = row->front;
+        seg[1] = seg[0] + row->gap + row->front;
+        n[1] = len - row->front;
+    }
+}
+
+// Count the depth a chunk reaches for every kind of bracket
+static void
+bracket_count(brchunk_T *ch, linenr_T start)
+{
+    long depth[BRACKET_KINDS] = { 0 }, low[BRACKET_KINDS] = { 0 };
+    const unsigned char *seg[2];
+    colnr_T n[2];
+    for (linenr_T lnum = start; lnum < start + ch->lines; lnum++) {
+        bracket_row_text(&econfig.rows[lnum], seg, n);
+        for (int s = 0; s < 2; s++) {
+            for (colnr_T i = 0; i < n[s]; i++) {
+                int k = kinds[seg[s][i]];
+                if (k > 0)
+                    depth[k - 1]++;
+                else if (k < 0 && --depth[-k - 1] < low[-k - 1])
+                    low[-k - 1] = depth[-k - 1];
+            }
+        }
+    }
+    memcpy(ch->delta, depth, sizeof(depth));
+    memcpy(ch->low, low, sizeof(low));
+    ch->dirty = false;
+}
+
+// Go through a row from a column counting the depth of a kind of bracket;
+// the column where it goes back to 0, MAXCOL if it does not
+static colnr_T
+bracket_scan_fwd(const editor_row_T *row, colnr_T col, int kind, long *depth)
+{
+    const unsigned char *seg[2];
+    colnr_T n[2], base = 0;
+    bracket_row_text(row, seg, n);
+    for (int s = 0; s < 2; base += n[s++]) {
+        for (colnr_T i = col > base ? col - base : 0; i < n[s]; i++) {
+            int k = kinds[seg[s][i]];
+            if (k == kind)
+                (*depth)++;
+            else if (k == -kind && --*depth == 0)
+                return base + i;
+        }
+    }
+    return MAXCOL;
+}
+
+// Go back through the columns of a row before col; closing brackets go one
+// deeper
+static colnr_T
+bracket_scan_bck(const editor_row_T *row, colnr_T col, int kind, long *depth)
+{
+    const unsigned char *seg[2];
+    colnr_T n[2];
+    bracket_row_text(row, seg, n);
+    for (int s = 1; s >= 0; s--) {
+        colnr_T base = s ? n[0] : 0;
+        colnr_T i = col > base ? col - base : 0;
+        if (i > n[s]) i = n[s];
+        while (i-- > 0) {
+            int k = kinds[seg[s][i]];
+            if (k == -kind)
+                (*depth)++;
+            else if (k == kind && --*depth == 0)
+                return base + i;
+        }
+    }
+    return MAXCOL;
+}
+
+bool
+bracket_find(linenr_T lnum, colnr_T *col)
+{
+    if (lnum >= econfig.line_count) return false;
+    const editor_row_T *row = &econfig.rows[lnum];
+    for (colnr_T c = *col; c < rbuf_len(row); c++) {
+        if (kinds[(unsigned char)rbuf_char_at(row, c)]) {
+            *col = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+bracket_match(pos_T *pos, linenr_T top, linenr_T bot)
+{
+    if (cur_buf != buflist_current() || lines != econfig.line_count)
+        bracket_reset();
+    if (pos->lnum >= lines) return false;
+    if (bot > lines) bot = lines;
+
+    const editor_row_T *row = &econfig.rows[pos->lnum];
+    if (pos->col >= rbuf_len(row)) return false;
+    int kind = kinds[(unsigned char)rbuf_char_at(row, pos->col)];
+    if (kind == 0) return false;
+
+    long depth = 0;
+    linenr_T lnum = pos->lnum, start;
+    size_t c = bracket_chunk(lnum, &start);
+    colnr_T col;
+    if (kind > 0) {
+        col = bracket_scan_fwd(row, pos->col, kind, &depth);
+        while (col == MAXCOL) {
+            if (++lnum >= bot) return false;
+
+            // Chunks are passed whole while their brackets never close the
+            // one matched
+            if (lnum == start + chunks[c].lines) {
+                for (start = lnum, c++; c < nchunks; c++) {
+                    brchunk_T *ch = &chunks[c];
+                    if (start + ch->lines > bot) break;
+                    if (ch->dirty) bracket_count(ch, start);
+                    if (depth + ch->low[kind - 1] <= 0) break;
+                    depth += ch->delta[kind - 1];
+                    start += ch->lines;
+                }
+                lnum = start;
+                if (lnum >= bot) return false;
+            }
+            col = bracket_scan_fwd(&econfig.rows[lnum], 0, kind, &depth);
+        }
+    }
+    else {
+        kind = -kind;
+        col = bracket_scan_bck(row, pos->col + 1, kind, &depth);
+        while (col == MAXCOL) {
+            if (lnum <= top) return false;
+            lnum--;
+
+            // Chunks are passed whole while their brackets never open the
+            // one matched
+            if (lnum < start) {
+                linenr_T end = start;
+                for (; c > 0; c--) {
+                    brchunk_T *ch = &chunks[c - 1];
+                    if (end - ch->lines < top) break;
+                    if (ch->dirty) bracket_count(ch, end - ch->lines);
+                    if (depth - ch->delta[kind - 1] + ch->low[kind - 1] <= 0)
+                        break;
+                    depth -= ch->delta[kind - 1];
+                    end -= ch->lines;
+                }
+                if (end <= top) return false;
+                start = end - chunks[--c].lines;
+                lnum = end - 1;
+            }
+            col = bracket_scan_bck(&econfig.rows[lnum], MAXCOL, kind, &depth);
+        }
+    }
+
+    pos->lnum = lnum;
+    pos->col = col;
+    return true;
+}
+
+void
+bracket_changed_lines(linenr_T lnum, linenr_T lnume, long xtra)
+{
+    if (cur_buf != buflist_current()) return;
+    // An empty buffer has no chunk to grow; it is counted from the start
+    if (nchunks == 0) {
+        cur_buf = -1;
+        return;
+    }
+
+    // The chunks holding the changed lines are counted again
+    linenr_T start, end = lnume > lnum ? lnume : lnum + 1;
+    size_t c = bracket_chunk(lnum, &start);
+    for (size_t d = c; d < nchunks && start < end; start += chunks[d++].lines)
+        chunks[d].dirty = true;
+    if (xtra == 0) return;
+    lines += xtra;
+
+    if (xtra > 0) {
+        // Added lines go to the chunk of the last changed line
+        if (lnume > lnum) c = bracket_chunk(lnume - 1, &start);
+        brchunk_T *ch = &chunks[c];
+        ch->lines += xtra;
+        ch->dirty = true;
+        if (ch->lines < 2 * BRACKET_CHUNK) return;
+
+        // A chunk grown too long is split
+        linenr_T total = ch->lines;
+        size_t parts = CHUNKS(total);
+        bracket_grow(nchunks + parts - 1);
+        memmove(&chunks[c + parts], &chunks[c + 1],
+                sizeof(brchunk_T) * (nchunks - c - 1));
+        nchunks += parts - 1;
+        for (size_t p = 0; p < parts; p++) {
+            linenr_T left = total - p * BRACKET_CHUNK;
+            chunks[c + p].lines = left < BRACKET_CHUNK ? left : BRACKET_CHUNK;
+            chunks[c + p].dirty = true;
+        }
+        return;
+    }
+
+    // Removed lines are taken from the chunks of the changed lines; chunks
+    // left empty are dropped
+    c = bracket_chunk(lnum, &start);
+    linenr_T rem = -xtra, from = lnum - start;
+    size_t d = c, keep = c;
+    for (; d < nchunks && rem > 0; d++, from = 0) {
+        linenr_T take = chunks[d].lines - from;
+        if (take > rem) take = rem;
+        chunks[d].lines -= take;
+        rem -= take;
+        if (chunks[d].lines) chunks[keep++] = chunks[d];
+    }
+    memmove(&chunks[keep], &chunks[d], sizeof(brchunk_T) * (nchunks - d));
+    nchunks -= d - keep;
+    hint = hint_start = 0;
+}
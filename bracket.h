@@ -0,0 +1,50 @@
+/**
+ * @file bracket.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for bracket matching; how the
+ * brackets of chunks of lines of the current buffer nest
+ */
+
+#ifndef BRACKET_H
+#define BRACKET_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/**
+ * @brief Find the first bracket at or after a column of a line
+ *
+ * @param lnum Index of the line of the current buffer
+ * @param col Column to start at; set to the column of the bracket
+ * @return true if the line has one
+ */
+bool bracket_find(linenr_T lnum, colnr_T *col);
+
+/**
+ * @brief Find the bracket matching the one at a position of the current
+ * buffer
+ *
+ * Only brackets of the same kind, (), [] or {}, are counted. The lines are
+ * summed up in chunks of a few hundred giving the change in depth over the
+ * chunk and the lowest depth within; a chunk is passed without looking at
+ * its rows when the depth it starts with proves the match is not in it. The
+ * summaries are counted again for chunks changed since the last call.
+ *
+ * @param pos Position of a bracket; set to the position of the match
+ * @param top Index of the first line to search
+ * @param bot Index after the last line to search
+ * @return true if the match was found; pos is not changed otherwise
+ */
+bool bracket_match(pos_T *pos, linenr_T top, linenr_T bot);
+
+/**
+ * @brief Count the lines of the current buffer changed since the last match
+ *
+ * @param lnum First changed line
+ * @param lnume Line after the last changed line, before the change
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void bracket_changed_lines(linenr_T lnum, linenr_T lnume, long xtra);
+
+#endif /* BRACKET_H */
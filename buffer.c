@@ -13,6 +13,27 @@
 
 #define INIT_SIZE 128
 
+// Give the row its own copy of a text buffer that is shared with other rows
+// before writing to it
+static void
+rbuf_own(editor_row_T *row)
+{
+    if (row->shared == NULL) return;
+
+    // Last reference; the buffer belongs to this row alone
+    if (*row->shared == 1) {
+        free(row->shared);
+        row->shared = NULL;
+        return;
+    }
+
+    (*row->shared)--;
+    char *chars = malloc(row->size + 1);
+    memcpy(chars, row->chars, row->size);
+    row->chars = chars;
+    row->shared = NULL;
+}
+
 void
 rbuf_init(editor_row_T *row)
 {
@@ -21,21 +42,77 @@ rbuf_init(editor_row_T *row)
     row->front = 0;
     // A row buffer's initial size would be 1024
     row->chars = malloc(INIT_SIZE + 1);
+    row->shared = NULL;
+    row->cold = NULL;
 }
 
 void
 rbuf_destroy(editor_row_T *row)
 {
-    free(row->chars);
+    // Release the reference of a shared buffer; the last one frees it
+    if (row->shared && *row->shared > 1) {
+        (*row->shared)--;
+    }
+    else {
+        free(row->shared);
+        free(row->chars);
+    }
     free(row->render);
 
     row->chars = NULL;
     row->render = NULL;
+    row->shared = NULL;
+}
+
+void
+rbuf_share(editor_row_T *dst, editor_row_T *src)
+{
+    if (src->shared == NULL) {
+        src->shared = malloc(sizeof(int));
+        *src->shared = 1;
+    }
+    (*src->shared)++;
+
+    *dst = *src;
+    dst->render = NULL;
+    dst->rsize = 0;
+}
+
+size_t
+rbuf_len(const editor_row_T *row)
+{
+    return row->size - row->gap;
+}
+
+int
+rbuf_char_at(const editor_row_T *row, size_t i)
+{
+    return (unsigned char)row->chars[i < row->front ? i : i + row->gap];
+}
+
+size_t
+rbuf_copy(const editor_row_T *row, size_t start, size_t len, char *dest)
+{
+    size_t rlen = rbuf_len(row);
+    if (start >= rlen) return 0;
+    if (len > rlen - start) len = rlen - start;
+
+    // Part before the gap then the part after it
+    size_t n = 0;
+    if (start < row->front) {
+        n = row->front - start < len ? row->front - start : len;
+        memcpy(dest, row->chars + start, n);
+    }
+    memcpy(dest + n, row->chars + row->gap + start + n, len - n);
+
+    return len;
 }
 
 void
 rbuf_insert(editor_row_T *row, int c)
 {
+    rbuf_own(row);
+
     // There is no more gap so create new gap
     if (!row->gap) {
         // Get the tail position of the gap buffer
@@ -43,7 +120,7 @@ rbuf_insert(editor_row_T *row, int c)
         row->gap = row->size;
         row->size *= 2; // increase total size
         // Reallocate new size then move the character string to new address
-        row->chars = realloc(row->chars, row->size);
+        row->chars = realloc(row->chars, row->size + 1);
         memmove(row->chars + row->front + row->gap, row->chars + row->front,
                 tail);
     }
@@ -64,6 +141,14 @@ rbuf_insertstr(editor_row_T *row, const char *s)
     while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
         len--;
 
+    rbuf_insertn(row, s, len);
+}
+
+void
+rbuf_insertn(editor_row_T *row, const char *s, size_t len)
+{
+    rbuf_own(row);
+
     size_t tail = row->size - row->front - row->gap;
 
     while (row->gap < len) {
@@ -84,6 +169,7 @@ rbuf_insertstr(editor_row_T *row, const char *s)
 void
 rbuf_backward(editor_row_T *row)
 {
+    rbuf_own(row);
     if (row->front > 0) {
         row->chars[row->front + row->gap - 1] = row->chars[row->front - 1];
         row->front--;
@@ -95,6 +181,7 @@ rbuf_backward(editor_row_T *row)
 void
 rbuf_forward(editor_row_T *row)
 {
+    rbuf_own(row);
     size_t tail = row->size - row->front - row->gap;
     // if there are chars after gap
     if (tail > 0) {
@@ -111,6 +198,9 @@ rbuf_move(editor_row_T *row, ptrdiff_t amt)
     size_t len = 0;
     char *dest, *src;
 
+    if (amt == 0) return;
+    rbuf_own(row);
+
     if (amt < 0) {
         len -= amt; // abs value
         // Prevent the amt of movement to get past the front of the buffer
@@ -139,6 +229,13 @@ rbuf_delete(editor_row_T *row)
     if (row->size > row->front + row->gap) row->gap++;
 }
 
+void
+rbuf_delete_n(editor_row_T *row, size_t n)
+{
+    size_t tail = row->size - row->front - row->gap;
+    row->gap += n < tail ? n : tail;
+}
+
 void
 rbuf_backspace(editor_row_T *row)
 {
@@ -46,6 +46,15 @@ void rbuf_insert(editor_row_T *row, int c);
  */
 void rbuf_insertstr(editor_row_T *row, const char *s);
 
+/**
+ * @brief Inserts len characters of a string to a gap buffer
+ *
+ * @param rows Pointer to current row cursor is at
+ * @param s String to insert
+ * @param len Number of characters to insert
+ */
+void rbuf_insertn(editor_row_T *row, const char *s, size_t len);
+
 /**
  * @brief Moves buffer to the left by one
  *
@@ -78,6 +87,16 @@ void rbuf_move(editor_row_T *row, ptrdiff_t amt);
  */
 void rbuf_delete(editor_row_T *row);
 
+/**
+ * @brief Deletes n characters after the gap buffer
+ *
+ * This is done by widening the gap over them in a single step
+ *
+ * @param rows Pointer to current row cursor is at
+ * @param n Number of characters to delete
+ */
+void rbuf_delete_n(editor_row_T *row, size_t n);
+
 /**
  * @brief Deletes the first character before the gap buffer
  *
@@ -87,4 +106,41 @@ void rbuf_delete(editor_row_T *row);
  */
 void rbuf_backspace(editor_row_T *row);
 
+/**
+ * @brief Make dst a row sharing the text buffer of src
+ *
+ * No text is copied; the buffer is copied by whichever row writes to it
+ * first (copy on write). The render buffer of dst is left empty.
+ *
+ * @param dst Pointer to row to initialize
+ * @param src Pointer to row to share the text buffer of
+ */
+void rbuf_share(editor_row_T *dst, editor_row_T *src);
+
+/**
+ * @brief Get the number of characters in the buffer; excludes the gap
+ *
+ * @param rows Pointer to row
+ */
+size_t rbuf_len(const editor_row_T *row);
+
+/**
+ * @brief Get the character at an index of the buffer; skips the gap
+ *
+ * @param rows Pointer to row
+ * @param i Index of the character; must be less than rbuf_len
+ */
+int rbuf_char_at(const editor_row_T *row, size_t i);
+
+/**
+ * @brief Copy characters of the buffer around the gap to dest
+ *
+ * @param rows Pointer to row
+ * @param start Index of the first character to copy
+ * @param len Number of characters to copy; clamped to the end of the buffer
+ * @param dest Destination; not null terminated
+ * @return Number of characters copied
+ */
+size_t rbuf_copy(const editor_row_T *row, size_t start, size_t len, char *dest);
+
 #endif
@@ -0,0 +1,322 @@
+/**
+ * @file buflist.c
+ * @author re-nanashi
+ * @brief List of edited files; only the current one lives in the editor
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "buflist.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "edit.h"
+#include "file_io.h"
+#include "screen.h"
+#include "follow.h"
+#include "swap.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Most bytes the rows of loaded buffers take before clean hidden buffers are
+// unloaded
+#define BUFLIST_MEM_MAX ((size_t)512 << 20)
+
+/* @brief Buffers in the order they were added */
+static filebuf_T *buflist;
+static int buflist_len, buflist_cap;
+/* @brief Index of the buffer edited in the editor; -1 before the first */
+static int curbuf = -1;
+/* @brief Number of the buffer added last */
+static int buflist_last_fnum;
+/* @brief Counter ordering the uses of buffers */
+static unsigned long buflist_tick;
+
+// Bytes taken by rows and their text
+static size_t
+buflist_count_bytes(const editor_row_T *rows, linenr_T n)
+{
+    size_t bytes = n * sizeof(editor_row_T);
+    for (linenr_T i = 0; i < n; i++)
+        bytes += rows[i].size + rows[i].rsize;
+    return bytes;
+}
+
+// Copy the state of the editor to the current buffer
+static void
+buflist_save()
+{
+    filebuf_T *buf = &buflist[curbuf];
+    buf->filename = econfig.filename;
+    buf->rows = econfig.rows;
+    buf->line_count = econfig.line_count;
+    buf->cx = econfig.cx;
+    buf->cy = econfig.cy;
+    buf->col_offset = econfig.col_offset;
+    buf->row_offset = econfig.row_offset;
+    buf->dirty = econfig.dirty;
+    buf->swap = econfig.swap;
+    buf->follow = econfig.follow;
+}
+
+// Free the rows of a buffer; its file is read again when it is entered
+static void
+buflist_unload(filebuf_T *buf)
+{
+    for (linenr_T i = 0; i < buf->line_count; i++)
+        row_free(&buf->rows[i]);
+    free(buf->rows);
+    buf->rows = NULL;
+    swap_close(buf->swap);
+    buf->swap = NULL;
+    follow_stop(buf->follow);
+    buf->follow = NULL;
+    buf->line_count = 0;
+    buf->dirty = 0;
+    buf->bytes = 0;
+    buf->loaded = false;
+}
+
+// Read the file of the current buffer into the editor
+static void
+buflist_load()
+{
+    filebuf_T *buf = &buflist[curbuf];
+    econfig.rows = NULL;
+    econfig.line_count = 0;
+    if (buf->filename) file_open(buf->filename);
+    econfig.dirty = 0;
+    swap_open();
+    buf->loaded = true;
+
+    // The file may have changed since the cursor was on it; a cursor past
+    // the lines read so far waits for the rest
+    if (econfig.cy >= econfig.line_count) file_load_finish();
+    if (econfig.cy >= econfig.line_count) {
+        econfig.cy = econfig.line_count ? econfig.line_count - 1 : 0;
+        econfig.cx = 0;
+    }
+    else if (econfig.cx > rbuf_len(&econfig.rows[econfig.cy])) {
+        econfig.cx = 0;
+    }
+}
+
+// Unload clean hidden buffers, least recently used first, until the loaded
+// ones fit in BUFLIST_MEM_MAX
+static void
+buflist_trim()
+{
+    size_t total = buflist_count_bytes(econfig.rows, econfig.line_count);
+    for (int i = 0; i < buflist_len; i++) {
+        if (i != curbuf && buflist[i].loaded) total += buflist[i].bytes;
+    }
+
+    while (total > BUFLIST_MEM_MAX) {
+        int lru = -1;
+        for (int i = 0; i < buflist_len; i++) {
+            filebuf_T *buf = &buflist[i];
+            if (i == curbuf || !buf->loaded || buf->dirty || buf->follow
+                || win_shows_buffer(i))
+                continue;
+            if (lru == -1 || buf->last_used < buflist[lru].last_used) lru = i;
+        }
+        if (lru == -1) break;
+
+        total -= buflist[lru].bytes;
+        buflist_unload(&buflist[lru]);
+    }
+}
+
+int
+buflist_add(const char *filename)
+{
+    for (int i = 0; filename && i < buflist_len; i++) {
+        const char *name = i == curbuf ? econfig.filename : buflist[i].filename;
+        if (name && strcmp(name, filename) == 0) return i;
+    }
+
+    if (buflist_len == buflist_cap) {
+        buflist_cap = buflist_cap ? buflist_cap * 2 : 8;
+        buflist = realloc(buflist, sizeof(filebuf_T) * buflist_cap);
+    }
+    filebuf_T *buf = &buflist[buflist_len];
+    memset(buf, 0, sizeof(*buf));
+    buf->fnum = ++buflist_last_fnum;
+    buf->filename = filename ? strdup(filename) : NULL;
+    return buflist_len++;
+}
+
+void
+buflist_enter(int idx)
+{
+    if (idx == curbuf) return;
+
+    // Leave the current buffer as it is
+    if (curbuf >= 0) {
+        file_load_finish();
+        swap_flush();
+        buflist_save();
+        filebuf_T *cur = &buflist[curbuf];
+        cur->bytes = buflist_count_bytes(cur->rows, cur->line_count);
+    }
+
+    curbuf = idx;
+    filebuf_T *buf = &buflist[idx];
+    econfig.filename = buf->filename;
+    econfig.rows = buf->rows;
+    econfig.line_count = buf->line_count;
+    econfig.cx = buf->cx;
+    econfig.cy = buf->cy;
+    econfig.col_offset = buf->col_offset;
+    econfig.row_offset = buf->row_offset;
+    econfig.dirty = buf->dirty;
+    econfig.swap = buf->swap;
+    econfig.follow = buf->follow;
+    econfig.visual_type = 0;
+
+    // A buffer is read when it is first shown
+    if (!buf->loaded)
+        buflist_load();
+    else
+        statusbar_set_message("\"%s\" %lu lines",
+                              buf->filename ? buf->filename : "[No Name]",
+                              econfig.line_count);
+
+    buf->last_used = ++buflist_tick;
+    buflist_trim();
+}
+
+void
+buflist_edit(const char *filename, bool forceit)
+{
+    bool same = filename == NULL
+                || (econfig.filename
+                    && strcmp(econfig.filename, filename) == 0);
+    if (same || forceit) {
+        if (econfig.dirty && !forceit) {
+            statusbar_set_message(
+                "No write since last change (add ! to override)");
+            return;
+        }
+        if (same && econfig.filename == NULL) {
+            statusbar_set_message("No file name");
+            return;
+        }
+
+        // The changes are dropped by reading the file again; the windows
+        // showing them draw the buffer again
+        file_load_stop();
+        buflist_save();
+        win_changed_lines(0, econfig.line_count, -(long)econfig.line_count);
+        buflist_unload(&buflist[curbuf]);
+        econfig.rows = NULL;
+        econfig.line_count = 0;
+        econfig.dirty = 0;
+        econfig.swap = NULL;
+        econfig.follow = NULL;
+        if (same) {
+            buflist_load();
+            return;
+        }
+    }
+
+    buflist_enter(buflist_add(filename));
+}
+
+void
+buflist_next(int count)
+{
+    buflist_enter(((curbuf + count) % buflist_len + buflist_len)
+                  % buflist_len);
+}
+
+void
+buflist_goto(const char *arg)
+{
+    if (*arg == '\0') return;
+
+    if (isdigit(*arg)) {
+        int fnum = atoi(arg);
+        for (int i = 0; i < buflist_len; i++) {
+            if (buflist[i].fnum == fnum) {
+                buflist_enter(i);
+                return;
+            }
+        }
+        statusbar_set_message("Buffer %d does not exist", fnum);
+        return;
+    }
+
+    buflist_save();
+    int match = -1;
+    for (int i = 0; i < buflist_len; i++) {
+        if (buflist[i].filename == NULL || !strstr(buflist[i].filename, arg))
+            continue;
+        if (match != -1) {
+            statusbar_set_message("More than one match for %s", arg);
+            return;
+        }
+        match = i;
+    }
+    if (match == -1)
+        statusbar_set_message("No matching buffer for %s", arg);
+    else
+        buflist_enter(match);
+}
+
+void
+buflist_list()
+{
+    buflist_save();
+    char **lines = malloc(sizeof(char *) * buflist_len);
+    for (int i = 0; i < buflist_len; i++) {
+        const filebuf_T *buf = &buflist[i];
+        char name[256];
+        snprintf(name, sizeof(name), "\"%s\"",
+                 buf->filename ? buf->filename : "[No Name]");
+
+        // % is the current buffer; a is shown, h is loaded but hidden
+        lines[i] = malloc(sizeof(name) + 64);
+        sprintf(lines[i], "%3d %c%c %c %-30s line %lu", buf->fnum,
+                i == curbuf ? '%' : ' ',
+                i == curbuf ? 'a' : buf->loaded ? 'h' : ' ',
+                buf->dirty ? '+' : ' ', name, buf->cy + 1);
+    }
+
+    screen_show_lines(lines, buflist_len);
+    for (int i = 0; i < buflist_len; i++)
+        free(lines[i]);
+    free(lines);
+}
+
+int
+buflist_current()
+{
+    return curbuf;
+}
+
+const filebuf_T *
+buflist_get(int idx)
+{
+    if (idx == curbuf) buflist_save();
+    return &buflist[idx];
+}
+
+bool
+buflist_other_changed()
+{
+    for (int i = 0; i < buflist_len; i++) {
+        if (i == curbuf || !buflist[i].dirty) continue;
+        statusbar_set_message("No write since last change for buffer %d "
+                              "(add ! to override)",
+                              buflist[i].fnum);
+        return true;
+    }
+    return false;
+}
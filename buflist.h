@@ -0,0 +1,112 @@
+/**
+ * @file buflist.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for the list of edited files
+ */
+
+#ifndef BUFLIST_H
+#define BUFLIST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+/* @brief File in the buffer list and its state while another is edited */
+typedef struct filebuf {
+    /* number shown by :ls and taken by :buffer */
+    int fnum;
+    /* name of the file; NULL if it has none */
+    char *filename;
+    /* rows of text; NULL when not loaded */
+    editor_row_T *rows;
+    /* number of rows */
+    linenr_T line_count;
+    /* cursor and scroll position */
+    colnr_T cx;
+    linenr_T cy;
+    colnr_T col_offset;
+    linenr_T row_offset;
+    /* changes counter */
+    int dirty;
+    /* journal of the changes; NULL if none */
+    struct swapfile *swap;
+    /* follower of the file; NULL if it is not followed */
+    struct follow *follow;
+    /* true once the file is read; hidden clean buffers may be unloaded */
+    bool loaded;
+    /* bytes taken by the rows; counted when the buffer is left */
+    size_t bytes;
+    /* order of last use; the least recently used buffer is unloaded first */
+    unsigned long last_used;
+} filebuf_T;
+
+/**
+ * @brief Add a file to the buffer list without reading it
+ *
+ * A file that is already listed is not added again.
+ *
+ * @param filename Name of the file; NULL for a buffer without a name
+ * @return Index of the buffer in the list
+ */
+int buflist_add(const char *filename);
+
+/**
+ * @brief Edit a buffer of the list
+ *
+ * The text of the current buffer is kept in the list, changed or not. The
+ * file of the entered buffer is read if it was not loaded yet; clean hidden
+ * buffers are then unloaded, least recently used first, while the loaded
+ * ones take more memory than the cap.
+ *
+ * @param idx Index of the buffer in the list
+ */
+void buflist_enter(int idx);
+
+/**
+ * @brief Edit a file; adds it to the list if it is not listed
+ *
+ * @param filename Name of the file; NULL to read the current file again
+ * @param forceit True to drop the changes of the current buffer
+ */
+void buflist_edit(const char *filename, bool forceit);
+
+/**
+ * @brief Go to a buffer further down the list; wraps around at the ends
+ *
+ * @param count Number of buffers to move; negative to move up the list
+ */
+void buflist_next(int count);
+
+/**
+ * @brief Go to the buffer with a number, or one whose name contains a string
+ *
+ * @param arg Buffer number or part of a name
+ */
+void buflist_goto(const char *arg);
+
+/* @brief Show the buffer list */
+void buflist_list();
+
+/* @brief Get the index of the buffer edited in the editor */
+int buflist_current();
+
+/**
+ * @brief Get a buffer of the list
+ *
+ * The state of the current buffer is copied from the editor first.
+ *
+ * @param idx Index of the buffer in the list
+ */
+const filebuf_T *buflist_get(int idx);
+
+/**
+ * @brief Check for a changed buffer other than the current one
+ *
+ * Sets a status bar message naming the first one found.
+ *
+ * @return True if there is one
+ */
+bool buflist_other_changed();
+
+#endif /* BUFLIST_H */
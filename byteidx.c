@@ -0,0 +1,220 @@
+/**
+ * @file byteidx.c
+ * @author re-nanashi
+ * @brief Byte offsets of the lines of the current buffer; a Fenwick tree
+ * over the bytes of chunks of lines so finding a byte or the offset of a
+ * line never sums every row
+ */
+
+#include "byteidx.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "buflist.h"
+
+/* @brief Internal macros */
+// Lines of a chunk; a query sums the rows of one chunk at most
+#define BYTEIDX_CHUNK 256
+// Lowest set bit of a node number; the number of chunks the node holds
+#define LOWBIT(i) ((i) & (~(i) + 1))
+// Chunks holding a number of lines
+#define CHUNKS(n) (((n) + BYTEIDX_CHUNK - 1) / BYTEIDX_CHUNK)
+
+/* @brief Bytes of each chunk with the line breaks of its lines */
+static uint64_t *sums;
+/* @brief Fenwick tree over sums; node i holds chunks i - LOWBIT(i) up to
+ * i - 1. Node 0 is unused. */
+static uint64_t *tree;
+static size_t cap;
+/* @brief Number of lines of the buffer counted */
+static linenr_T lines;
+/* @brief Number of chunks whose tree nodes are up to date */
+static size_t tree_valid;
+/* @brief Chunks whose lines changed; their sums are counted again */
+static size_t dirty_lo, dirty_hi;
+/* @brief Buffer counted; -1 before the first use */
+static int cur_buf = -1;
+
+// Bytes of the lines from lnum to lnume; lines past the last count nothing
+static uint64_t
+byteidx_rows(linenr_T lnum, linenr_T lnume)
+{
+    uint64_t sum = 0;
+    if (lnume > lines) lnume = lines;
+    for (; lnum < lnume; lnum++)
+        sum += rbuf_len(&econfig.rows[lnum]) + 1;
+    return sum;
+}
+
+// Bytes of the chunks before chunk c; c must not be past tree_valid
+static uint64_t
+byteidx_sum(size_t c)
+{
+    uint64_t sum = 0;
+    for (; c > 0; c -= LOWBIT(c))
+        sum += tree[c];
+    return sum;
+}
+
+static void
+byteidx_dirty(size_t lo, size_t hi)
+{
+    if (lo >= hi) return;
+    if (dirty_lo >= dirty_hi) {
+        dirty_lo = lo;
+        dirty_hi = hi;
+        return;
+    }
+    if (lo < dirty_lo) dirty_lo = lo;
+    if (hi > dirty_hi) dirty_hi = hi;
+}
+
+static void
+byteidx_grow(size_t n)
+{
+    if (n <= cap) return;
+    cap = n > cap * 2 ? n : cap * 2;
+    sums = realloc(sums, sizeof(uint64_t) * cap);
+    tree = realloc(tree, sizeof(uint64_t) * (cap + 1));
+}
+
+// Count the changed chunks again and bring the tree up to date. The nodes
+// of unchanged chunks are kept; a few changed chunks are added to them and
+// the nodes after more are built in one pass from their children.
+static void
+byteidx_update()
+{
+    // Another buffer or one read again is counted from the start
+    if (cur_buf != buflist_current() || lines != econfig.line_count) {
+        cur_buf = buflist_current();
+        lines = econfig.line_count;
+        tree_valid = 0;
+        dirty_lo = 0;
+        dirty_hi = CHUNKS(lines);
+        byteidx_grow(dirty_hi);
+    }
+
+    size_t n = CHUNKS(lines);
+    bool few = dirty_hi - dirty_lo <= 8;
+    for (size_t c = dirty_lo; c < dirty_hi; c++) {
+        uint64_t sum = byteidx_rows(c * BYTEIDX_CHUNK,
+                                    (c + 1) * BYTEIDX_CHUNK);
+        if (few && c < tree_valid) {
+            for (size_t i = c + 1; i <= tree_valid; i += LOWBIT(i))
+                tree[i] += sum - sums[c];
+        }
+        sums[c] = sum;
+    }
+    if (!few && dirty_lo < tree_valid) tree_valid = dirty_lo;
+    dirty_lo = dirty_hi = 0;
+    if (tree_valid > n) tree_valid = n;
+    if (tree_valid == n) return;
+
+    size_t m = tree_valid;
+    for (size_t i = m + 1; i <= n; i++)
+        tree[i] = sums[i - 1];
+    // The kept nodes a new node holds are the ones summing the kept chunks
+    for (size_t i = m; i > 0; i -= LOWBIT(i)) {
+        size_t parent = i + LOWBIT(i);
+        if (parent <= n) tree[parent] += tree[i];
+    }
+    for (size_t i = m + 1; i <= n; i++) {
+        size_t parent = i + LOWBIT(i);
+        if (parent <= n) tree[parent] += tree[i];
+    }
+    tree_valid = n;
+}
+
+uint64_t
+byteidx_offset(linenr_T lnum)
+{
+    byteidx_update();
+    if (lnum > lines) lnum = lines;
+    size_t c = lnum / BYTEIDX_CHUNK;
+    return byteidx_sum(c) + byteidx_rows(c * BYTEIDX_CHUNK, lnum);
+}
+
+linenr_T
+byteidx_find(uint64_t off, colnr_T *col)
+{
+    byteidx_update();
+    *col = 0;
+    if (lines == 0) return 0;
+
+    // Go down the tree for the chunks ending at or before the byte, then
+    // through the lines of the next one
+    size_t n = CHUNKS(lines), c = 0, step = 1;
+    while (step <= n / 2)
+        step *= 2;
+    for (; step; step /= 2) {
+        if (c + step <= n && tree[c + step] <= off) {
+            c += step;
+            off -= tree[c];
+        }
+    }
+
+    linenr_T lnum = c * BYTEIDX_CHUNK;
+    for (; lnum < lines; lnum++) {
+        colnr_T len = rbuf_len(&econfig.rows[lnum]);
+        if (off <= len) break;
+        off -= len + 1;
+    }
+    if (lnum >= lines) {
+        lnum = lines - 1;
+        off = MAXCOL;
+    }
+
+    colnr_T len = rbuf_len(&econfig.rows[lnum]);
+    if (off < len)
+        *col = off;
+    else if (len)
+        *col = len - 1;
+    return lnum;
+}
+
+void
+byteidx_goto(uint64_t off)
+{
+    colnr_T col;
+    econfig.cy = byteidx_find(off, &col);
+    econfig.cx = col;
+}
+
+void
+byteidx_changed_lines(linenr_T lnum, linenr_T lnume, long xtra)
+{
+    if (cur_buf != buflist_current()) return;
+
+    size_t c0 = lnum / BYTEIDX_CHUNK;
+    linenr_T old = lines;
+    lines += xtra;
+    size_t n = CHUNKS(lines);
+    byteidx_grow(n);
+    if (xtra == 0) {
+        if (lnume > lnum) byteidx_dirty(c0, CHUNKS(lnume));
+        return;
+    }
+    if (tree_valid > c0) tree_valid = c0;
+
+    // The lines after the change moved to other chunks. A chunk made of
+    // unchanged lines takes the bytes of the lines moved in and gives up
+    // those moved out; the others are counted again.
+    linenr_T x = xtra > 0 ? xtra : -xtra;
+    linenr_T moved = xtra > 0 ? lnume + xtra : lnume;
+    size_t first = CHUNKS(moved);
+    if (dirty_hi > c0 || x > BYTEIDX_CHUNK / 2) first = n;
+    byteidx_dirty(c0, first < n ? first : n);
+    for (size_t c = first; c < n; c++) {
+        linenr_T start = c * BYTEIDX_CHUNK, end = start + BYTEIDX_CHUNK;
+        uint64_t sum = c < CHUNKS(old) ? sums[c] : 0;
+        if (xtra > 0)
+            sums[c] = sum + byteidx_rows(start, start + x)
+                      - byteidx_rows(end, end + x);
+        else
+            sums[c] = sum - byteidx_rows(start - x, start)
+                      + byteidx_rows(end - x, end);
+    }
+    if (dirty_hi > n) dirty_hi = n;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file byteidx.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for the byte index; offsets
+ * of the lines of the current buffer as the file would hold them
+ */
+
+#ifndef BYTEIDX_H
+#define BYTEIDX_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+/**
+ * @brief Get the offset of the first byte of a line of the current buffer
+ *
+ * Every line counts its characters and a line break. Lines are counted in
+ * chunks of a few hundred; a call sums the rows of one chunk and the chunks
+ * changed since the last call. Lines added or removed move the sums of the
+ * chunks after them without counting their rows again.
+ *
+ * @param lnum Index of the line; line_count gives the size of the buffer
+ */
+uint64_t byteidx_offset(linenr_T lnum);
+
+/**
+ * @brief Find the line of the current buffer holding a byte
+ *
+ * @param off Offset of the byte; past the end gives the last line
+ * @param col Set to the column of the byte; a line break gives the last
+ * character
+ * @return Index of the line; 0 for an empty buffer
+ */
+linenr_T byteidx_find(uint64_t off, colnr_T *col);
+
+/**
+ * @brief Move the cursor to a byte of the current buffer
+ *
+ * @param off Offset of the byte; past the end goes to the last character
+ */
+void byteidx_goto(uint64_t off);
+
+/**
+ * @brief Count the lines of the current buffer changed since the last query
+ *
+ * @param lnum First changed line
+ * @param lnume Line after the last changed line, before the change
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void byteidx_changed_lines(linenr_T lnum, linenr_T lnume, long xtra);
+
+#endif /* BYTEIDX_H */
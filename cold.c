@@ -0,0 +1,428 @@
+/**
+ * @file cold.c
+ * @author re-nanashi
+ * @brief Cold rows; runs of rows nobody looks at are packed into blocks
+ * compressed with a small LZ77 codec and unpacked when they are needed again
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "cold.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "buffer.h"
+#include "buflist.h"
+#include "edit.h"
+#include "fold.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Rows this close to a cursor or a view are never packed
+#define COLD_MARGIN 1000
+// Time the editor must be left alone before rows are packed
+#define COLD_IDLE_MS 2000
+// Packed text of a block; every match offset then fits in 16 bits
+#define COLD_BLOCK_SIZE (64 << 10)
+// Bytes of rows looked at per idle call so typing is never held up long
+#define COLD_PACK_BUDGET (1 << 20)
+// Shortest match of the codec and bits of its hash table
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 13
+// Length written in the 4 bits of a token; longer ones continue in bytes
+#define LZ_RUN_MASK 15
+
+/* @brief Compressed text of consecutive rows; each row text is a LEB128
+ * varint length followed by the characters */
+typedef struct coldblock {
+    /* packed rows whose text is still in the block */
+    linenr_T refs;
+    /* length of the text once unpacked */
+    size_t ulen;
+    /* length of the compressed text */
+    size_t clen;
+    unsigned char data[];
+} coldblock_T;
+
+/* @brief The block unpacked last; rows of a block are mostly wanted
+ * together */
+static const coldblock_T *cache_block;
+static char *cache_text;
+static size_t cache_cap;
+/* offset of each row text in cache_text; its varint length first */
+static size_t *cache_off;
+static size_t cache_off_cap;
+
+/* @brief State of the editor when it was last seen changing */
+static struct {
+    editor_row_T *rows;
+    linenr_T line_count;
+    linenr_T cy;
+    linenr_T row_offset;
+    int dirty;
+    long long since;
+} cold_seen;
+
+/* @brief Next row to look at and whether every row was looked at since the
+ * editor last changed */
+static linenr_T cold_scan;
+static bool cold_settled;
+
+static long long
+cold_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned char *
+cold_put_varint(unsigned char *p, size_t v)
+{
+    for (; v >= 0x80; v >>= 7)
+        *p++ = (v & 0x7f) | 0x80;
+    *p++ = v;
+    return p;
+}
+
+static size_t
+cold_get_varint(const char **p)
+{
+    size_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        unsigned char b = *(*p)++;
+        v |= (size_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+}
+
+static size_t
+cold_varint_len(size_t v)
+{
+    size_t n = 1;
+    for (; v >= 0x80; v >>= 7)
+        n++;
+    return n;
+}
+
+// A length past the token continues in bytes of 255 and a last smaller one
+static unsigned char *
+lz_put_len(unsigned char *op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = len;
+    return op;
+}
+
+static size_t
+lz_get_len(const unsigned char **ip, size_t len)
+{
+    if (len < LZ_RUN_MASK) return len;
+    unsigned char b;
+    do {
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+// Append a token, its literals and the match after them; mlen 0 ends the
+// text with the literals alone
+static unsigned char *
+lz_put_seq(unsigned char *op,
+           const unsigned char *lit,
+           size_t nlit,
+           size_t off,
+           size_t mlen)
+{
+    size_t mcode = mlen ? mlen - LZ_MIN_MATCH : 0;
+    *op++ = (nlit < LZ_RUN_MASK ? nlit : LZ_RUN_MASK) << 4
+            | (mcode < LZ_RUN_MASK ? mcode : LZ_RUN_MASK);
+    if (nlit >= LZ_RUN_MASK) op = lz_put_len(op, nlit - LZ_RUN_MASK);
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (mlen == 0) return op;
+
+    *op++ = off & 0xff;
+    *op++ = off >> 8;
+    if (mcode >= LZ_RUN_MASK) op = lz_put_len(op, mcode - LZ_RUN_MASK);
+    return op;
+}
+
+// Compress text of at most COLD_BLOCK_SIZE; dst holds len + len / 255 + 16
+static size_t
+lz_compress(const unsigned char *src, size_t len, unsigned char *dst)
+{
+    // Position + 1 of the last 4 bytes with each hash; 0 if none
+    static uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    const unsigned char *ip = src, *anchor = src, *end = src + len;
+    const unsigned char *limit = len > LZ_MIN_MATCH ? end - LZ_MIN_MATCH : src;
+    unsigned char *op = dst;
+    while (ip < limit) {
+        uint32_t seq;
+        memcpy(&seq, ip, sizeof(seq));
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        uint32_t cand = table[h];
+        table[h] = ip - src + 1;
+        if (cand == 0 || memcmp(src + cand - 1, ip, LZ_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        // Extend the match as far as the text repeats
+        const unsigned char *ref = src + cand - 1;
+        const unsigned char *m = ip + LZ_MIN_MATCH;
+        while (m < end && *m == ref[m - ip])
+            m++;
+        op = lz_put_seq(op, anchor, ip - anchor, ip - ref, m - ip);
+        ip = anchor = m;
+    }
+    return lz_put_seq(op, anchor, end - anchor, 0, 0) - dst;
+}
+
+static bool
+lz_decompress(const unsigned char *src, size_t clen, char *dst, size_t ulen)
+{
+    const unsigned char *ip = src, *end = src + clen;
+    char *op = dst, *oend = dst + ulen;
+    while (ip < end) {
+        int token = *ip++;
+        size_t nlit = lz_get_len(&ip, token >> 4);
+        if (nlit > (size_t)(oend - op)) return false;
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+        if (ip >= end) break;
+
+        // Matches may overlap the text they copy; copied a byte at a time
+        size_t off = ip[0] | ip[1] << 8;
+        ip += 2;
+        size_t mlen = lz_get_len(&ip, token & LZ_RUN_MASK) + LZ_MIN_MATCH;
+        if (off == 0 || off > (size_t)(op - dst)
+            || mlen > (size_t)(oend - op))
+            return false;
+        for (const char *ref = op - off; mlen--;)
+            *op++ = *ref++;
+    }
+    return op == oend;
+}
+
+// Unpack a block into the cache unless it is there already
+static void
+cold_unpack(const coldblock_T *b)
+{
+    if (cache_block == b) return;
+
+    if (b->ulen > cache_cap) {
+        cache_cap = b->ulen;
+        cache_text = realloc(cache_text, cache_cap);
+    }
+    lz_decompress(b->data, b->clen, cache_text, b->ulen);
+
+    // Rows keep the index they were packed with; the text of the rows that
+    // left the block is still there
+    size_t off = 0;
+    for (size_t i = 0; off < b->ulen; i++) {
+        if (i == cache_off_cap) {
+            cache_off_cap = cache_off_cap ? cache_off_cap * 2 : 256;
+            cache_off = realloc(cache_off, sizeof(size_t) * cache_off_cap);
+        }
+        cache_off[i] = off;
+        const char *p = cache_text + off;
+        size_t len = cold_get_varint(&p);
+        off = p - cache_text + len;
+    }
+    cache_block = b;
+}
+
+// A packed row left the block; the block goes with the last one
+static void
+cold_unref(coldblock_T *b)
+{
+    if (--b->refs) return;
+    if (cache_block == b) cache_block = NULL;
+    free(b);
+}
+
+const char *
+cold_text(const editor_row_T *row, size_t *len)
+{
+    cold_unpack(row->cold);
+    const char *p = cache_text + cache_off[row->cold_line];
+    *len = cold_get_varint(&p);
+    return p;
+}
+
+void
+cold_thaw(editor_row_T *row)
+{
+    coldblock_T *b = row->cold;
+    if (b == NULL) return;
+
+    size_t len;
+    const char *text = cold_text(row, &len);
+    rbuf_init(row);
+    row->render = NULL;
+    rbuf_insertn(row, text, len);
+    row_update(row);
+    cold_unref(b);
+}
+
+void
+cold_thaw_range(linenr_T lnum, linenr_T lnume)
+{
+    if (lnume > econfig.line_count) lnume = econfig.line_count;
+    for (linenr_T i = lnum; i < lnume; i++)
+        cold_thaw(&econfig.rows[i]);
+}
+
+void
+cold_release(editor_row_T *row)
+{
+    if (row->cold == NULL) return;
+    cold_unref(row->cold);
+    row->cold = NULL;
+}
+
+// Index after the rows kept around a cursor or a view of the current buffer
+// that hold lnum; lnum if it may be packed
+static linenr_T
+cold_kept_until(linenr_T lnum)
+{
+    linenr_T until = lnum;
+    for (int i = 0; i < win_count(); i++) {
+        win_T *wp = win_get(i);
+        if (wp->buf != buflist_current()) continue;
+
+        bool current = wp == win_current();
+        linenr_T top = current ? econfig.row_offset : wp->row_offset;
+        linenr_T cy = current ? econfig.cy : wp->cy;
+        linenr_T lo = top < cy ? top : cy;
+        linenr_T bot = fold_move(wp, top, wp->height) + 1;
+        linenr_T hi = bot > cy + 1 ? bot : cy + 1;
+        lo = lo > COLD_MARGIN ? lo - COLD_MARGIN : 0;
+        hi += COLD_MARGIN;
+        if (lnum >= lo && lnum < hi && hi > until) until = hi;
+    }
+    return until;
+}
+
+// Pack the rows [lnum, lnume) whose text with the varint lengths is ulen
+static void
+cold_pack(linenr_T lnum, linenr_T lnume, size_t ulen)
+{
+    static unsigned char text[COLD_BLOCK_SIZE];
+    static unsigned char packed[COLD_BLOCK_SIZE + COLD_BLOCK_SIZE / 255 + 16];
+
+    unsigned char *p = text;
+    for (linenr_T i = lnum; i < lnume; i++) {
+        editor_row_T *row = &econfig.rows[i];
+        size_t len = rbuf_len(row);
+        p = cold_put_varint(p, len);
+        p += rbuf_copy(row, 0, len, (char *)p);
+    }
+
+    // Text that does not shrink stays in the rows
+    size_t clen = lz_compress(text, ulen, packed);
+    if (clen >= ulen - ulen / 8) return;
+
+    coldblock_T *b = malloc(sizeof(coldblock_T) + clen);
+    b->refs = lnume - lnum;
+    b->ulen = ulen;
+    b->clen = clen;
+    memcpy(b->data, packed, clen);
+
+    for (linenr_T i = lnum; i < lnume; i++) {
+        editor_row_T *row = &econfig.rows[i];
+        size_t len = rbuf_len(row);
+        rbuf_destroy(row);
+        row->chars = NULL;
+        row->render = NULL;
+        row->rsize = 0;
+        row->size = len;
+        row->front = row->gap = 0;
+        row->shared = NULL;
+        row->cold = b;
+        row->cold_line = i - lnum;
+    }
+}
+
+void
+cold_idle()
+{
+    if (!econfig.coldrows) return;
+
+    // Anything done in the editor restarts the wait and the scan
+    long long now = cold_now_ms();
+    if (cold_seen.rows != econfig.rows
+        || cold_seen.line_count != econfig.line_count
+        || cold_seen.cy != econfig.cy
+        || cold_seen.row_offset != econfig.row_offset
+        || cold_seen.dirty != econfig.dirty)
+    {
+        if (cold_seen.rows != econfig.rows) cold_scan = 0;
+        cold_seen.rows = econfig.rows;
+        cold_seen.line_count = econfig.line_count;
+        cold_seen.cy = econfig.cy;
+        cold_seen.row_offset = econfig.row_offset;
+        cold_seen.dirty = econfig.dirty;
+        cold_seen.since = now;
+        cold_settled = false;
+    }
+    if (cold_settled || now - cold_seen.since < COLD_IDLE_MS) return;
+
+    size_t budget = COLD_PACK_BUDGET;
+    while (budget && cold_scan < econfig.line_count) {
+        linenr_T kept = cold_kept_until(cold_scan);
+        if (kept != cold_scan) {
+            cold_scan = kept;
+            continue;
+        }
+
+        // Gather the run of rows that may share a block
+        linenr_T end = cold_scan;
+        size_t ulen = 0;
+        while (end < econfig.line_count) {
+            editor_row_T *row = &econfig.rows[end];
+            size_t len = rbuf_len(row);
+            size_t need = cold_varint_len(len) + len;
+            if (row->cold || row->shared || ulen + need > COLD_BLOCK_SIZE
+                || cold_kept_until(end) != end)
+                break;
+            ulen += need;
+            end++;
+        }
+        budget -= ulen < budget ? ulen : budget;
+
+        if (end > cold_scan) {
+            cold_pack(cold_scan, end, ulen);
+            cold_scan = end;
+        }
+        // A row that is packed, shared or kept ends the run by itself
+        else {
+            cold_scan++;
+            budget -= budget < 64 ? budget : 64;
+        }
+    }
+
+    if (cold_scan >= econfig.line_count) {
+        cold_scan = 0;
+        cold_settled = true;
+#ifdef __GLIBC__
+        // Hand the freed text buffers back to the system
+        malloc_trim(0);
+#endif
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * @file cold.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for cold rows; rows whose text
+ * is kept in compressed blocks while nobody looks at them
+ */
+
+#ifndef COLD_H
+#define COLD_H
+
+#include <stddef.h>
+
+#include "config.h"
+
+/**
+ * @brief Pack rows of the current buffer into compressed blocks
+ *
+ * Called while no key is typed. Once the editor has been left alone for a
+ * few seconds with the coldrows option set, runs of consecutive rows far
+ * from the cursor and from every view of the buffer are packed a bit at a
+ * time.
+ */
+void cold_idle();
+
+/**
+ * @brief Give a packed row its text back as a gap buffer
+ *
+ * @param row Pointer to row; rows holding their text are left alone
+ */
+void cold_thaw(editor_row_T *row);
+
+/**
+ * @brief Give the packed rows of a range of the current buffer their text
+ *
+ * @param lnum Index of the first row
+ * @param lnume Index after the last row
+ */
+void cold_thaw_range(linenr_T lnum, linenr_T lnume);
+
+/**
+ * @brief Get the text of a packed row without unpacking it
+ *
+ * @param row Pointer to packed row
+ * @param len Set to the length of the text
+ * @return Text valid until the next call of a cold function
+ */
+const char *cold_text(const editor_row_T *row, size_t *len);
+
+/**
+ * @brief Drop the text of a packed row; the row is being freed
+ *
+ * @param row Pointer to row; rows holding their text are left alone
+ */
+void cold_release(editor_row_T *row);
+
+#endif /* COLD_H */
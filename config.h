@@ -16,6 +16,20 @@ typedef size_t linenr_T;
 /* @brief Column number type */
 typedef size_t colnr_T;
 
+/* @brief Position in the text */
+typedef struct pos {
+    /* line number */
+    linenr_T lnum;
+    /* column number */
+    colnr_T col;
+} pos_T;
+
+/* @brief Column past the end of any line */
+#define MAXCOL ((colnr_T)-1)
+
+/* @brief Motion types of operated text: characters, whole lines or a block */
+enum MotionType { MCHAR, MLINE, MBLOCK };
+
 /* @brief A row in the editor */
 typedef struct editor_row {
     /* text buffer */
@@ -30,6 +44,17 @@ typedef struct editor_row {
     char *render;
     /* size of the render buffer */
     size_t rsize;
+    /* number of '\t' in the text */
+    size_t tabs;
+    /* reference count of a text buffer shared with registers; NULL if the row
+     * owns its text buffer */
+    int *shared;
+    /* compressed block holding the text of a packed row; NULL if the row
+     * holds its text. A packed row has no text buffer; size is the length
+     * of its text */
+    struct coldblock *cold;
+    /* index of the row text within the block */
+    size_t cold_line;
 } editor_row_T;
 
 /* @brief Editor states */
@@ -65,14 +90,32 @@ typedef struct editor_config {
     editor_row_T *rows;
     /* editor mode */
     Mode mode;
+    /* visual mode type: 'v', 'V' or Ctrl-V; 0 when nothing is selected */
+    int visual_type;
+    /* position the selection started at; the cursor is its other end */
+    pos_T visual_start;
+    /* block selection extends to the end of every line */
+    int visual_eol;
     /* changes counter */
     int dirty;
     /* filename str */
     char *filename;
+    /* journal of the changes since the file was read; NULL if none */
+    struct swapfile *swap;
+    /* follower of the file growing; NULL if it is not followed */
+    struct follow *follow;
+    /* rows far from the views are packed into compressed blocks */
+    int coldrows;
+    /* rows longer than the window go on over the next screen lines */
+    int wrap;
+    /* command line being typed in command mode; without the ':' */
+    char cmdline[256];
     /* status message str */
     char statusmsg[80];
     /* status message timeout time */
     time_t statusmsg_time;
+    /* terminal supports synchronized output (DEC mode 2026) */
+    int sync_output;
     /* original termios config */
     struct termios orig_termios;
 } editor_config_T;
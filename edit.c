@@ -11,58 +11,266 @@
 #include <string.h>
 
 #include "buffer.h"
+#include "cold.h"
+#include "swap.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Distance between the columns of a long row remembered while walking it
+#define ROW_MARK_EVERY 4096
+
+/* @brief Column of a long row passed last while mapping columns; columns
+ * after it are mapped from it instead of from the start of the row. It holds
+ * while the text before it is unchanged */
+static struct {
+    const editor_row_T *row;
+    const char *chars;
+    int dirty;
+    colnr_T cx, rx;
+} row_mark;
 
 /* Row operations */
+editor_row_T *
+row_get(linenr_T lnum)
+{
+    cold_thaw(&econfig.rows[lnum]);
+    return &econfig.rows[lnum];
+}
+
+bool
+row_is_long(const editor_row_T *row)
+{
+    return rbuf_len(row) >= ZEX_LONG_ROW_LEN;
+}
+
+// Index of the first '\t' of a row in [from, to); to if there is none
+static colnr_T
+row_find_tab(const editor_row_T *row, colnr_T from, colnr_T to)
+{
+    // The text before the gap then the text after it
+    if (from < row->front) {
+        colnr_T end = to < row->front ? to : row->front;
+        const char *p = memchr(row->chars + from, '\t', end - from);
+        if (p) return p - row->chars;
+        from = end;
+    }
+    if (from >= to) return to;
+    const char *text = row->chars + row->gap;
+    const char *p = memchr(text + from, '\t', to - from);
+    return p ? (colnr_T)(p - text) : to;
+}
+
+// Walk a long row until cx reaches to_cx or the next character would pass
+// to_rx; the walk starts at the mark when it is before both
+static void
+row_long_walk(const editor_row_T *row,
+              colnr_T to_cx,
+              colnr_T to_rx,
+              colnr_T *cx,
+              colnr_T *rx)
+{
+    colnr_T c = 0, r = 0;
+    if (row_mark.row == row && row_mark.chars == row->chars
+        && row_mark.dirty == econfig.dirty && row_mark.cx <= to_cx
+        && row_mark.rx <= to_rx)
+    {
+        c = row_mark.cx;
+        r = row_mark.rx;
+    }
+
+    // Characters between tabs take one cell each and are skipped at once.
+    // The mark is left at the last multiple of ROW_MARK_EVERY passed.
+    colnr_T len = rbuf_len(row), mark_cx = c, mark_rx = r;
+    colnr_T stop = to_cx < len ? to_cx : len;
+    while (c < stop) {
+        colnr_T tab = row_find_tab(row, c, stop);
+        colnr_T run = tab - c;
+        if (r + run > to_rx) run = to_rx - r;
+        colnr_T m = (c + run) / ROW_MARK_EVERY * ROW_MARK_EVERY;
+        if (m > c) {
+            mark_cx = m;
+            mark_rx = r + (m - c);
+        }
+        c += run;
+        r += run;
+        if (c < tab || c == stop) break;
+
+        colnr_T w = ZEX_TAB_STOP - r % ZEX_TAB_STOP;
+        if (r + w > to_rx) break;
+        r += w;
+        c++;
+        if (c % ROW_MARK_EVERY == 0) {
+            mark_cx = c;
+            mark_rx = r;
+        }
+    }
+    row_mark.row = row;
+    row_mark.chars = row->chars;
+    row_mark.dirty = econfig.dirty;
+    row_mark.cx = mark_cx;
+    row_mark.rx = mark_rx;
+    *cx = c;
+    *rx = r;
+}
+
+// Keep the mark of a row edited at a column after it
+static void
+row_long_edited(const editor_row_T *row, colnr_T at)
+{
+    if (row_mark.row != row || at < row_mark.cx) return;
+    row_mark.chars = row->chars;
+    row_mark.dirty = econfig.dirty;
+}
+
 int
 row_convert_cx_to_rx(editor_row_T *row, int cx)
 {
     int rx = 0;
     // Loop through the characters in the row and replace the tab character to
     // the number of tab stop spaces declared in the header file
+    int len = rbuf_len(row);
+    if (cx > len) cx = len;
+    // Without tabs every character takes one cell
+    if (row->tabs == 0) return cx;
+    if (row_is_long(row)) {
+        colnr_T c, r;
+        row_long_walk(row, cx, MAXCOL, &c, &r);
+        return r;
+    }
     for (int j = 0; j < cx; j++) {
-        if (row->chars[j] == '\t')
+        if (rbuf_char_at(row, j) == '\t')
             rx += (ZEX_TAB_STOP - 1) - (rx % ZEX_TAB_STOP);
         rx++;
     }
     return rx; // return new length of row
 }
 
-void
-row_update(editor_row_T *row)
+colnr_T
+row_convert_rx_to_cx(editor_row_T *row, colnr_T rx)
 {
-    // Get the number of '\t' within the line
-    int tabs = 0;
-    size_t j;
-    for (j = 0; j < row->size; j++)
-        if (row->chars[j] == '\t') tabs++;
+    colnr_T len = rbuf_len(row);
+    colnr_T cur_rx = 0;
+    colnr_T cx;
+    if (row->tabs == 0) return rx < len ? rx : len;
+    if (row_is_long(row)) {
+        row_long_walk(row, MAXCOL, rx, &cx, &cur_rx);
+        return cx;
+    }
+    // Find the character whose rendered cells cover rx
+    for (cx = 0; cx < len; cx++) {
+        if (rbuf_char_at(row, cx) == '\t')
+            cur_rx += (ZEX_TAB_STOP - 1) - (cur_rx % ZEX_TAB_STOP);
+        cur_rx++;
+        if (cur_rx > rx) return cx;
+    }
+    return cx;
+}
+
+colnr_T
+row_width(const editor_row_T *row)
+{
+    if (!row_is_long(row)) return row->rsize;
+    if (row->tabs == 0) return rbuf_len(row);
+    colnr_T cx, rx;
+    row_long_walk(row, MAXCOL, MAXCOL, &cx, &rx);
+    return rx;
+}
+
+colnr_T
+row_render_cols(const editor_row_T *row,
+                colnr_T left,
+                colnr_T width,
+                char *dest)
+{
+    if (row->tabs == 0) return rbuf_copy(row, left, width, dest);
+
+    // A tab covering left shows the rest of its cells
+    colnr_T cx, rx, n = 0;
+    row_long_walk(row, MAXCOL, left, &cx, &rx);
+    for (colnr_T len = rbuf_len(row); cx < len && n < width; cx++) {
+        int c = rbuf_char_at(row, cx);
+        if (c != '\t') {
+            dest[n++] = c;
+            rx++;
+            continue;
+        }
+        do {
+            if (rx >= left && n < width) dest[n++] = ' ';
+            rx++;
+        } while (rx % ZEX_TAB_STOP != 0);
+    }
+    return n;
+}
+
+// Count the '\t' in text
+static size_t
+row_count_tabs(const char *s, size_t len)
+{
+    size_t tabs = 0;
+    const char *end = s + len;
+    while ((s = memchr(s, '\t', end - s)) != NULL) {
+        tabs++;
+        s++;
+    }
+    return tabs;
+}
+
+// Render a row whose tabs are counted; a long row is left without a render
+// buffer
+static void
+row_render(editor_row_T *row)
+{
+    // The text lies on both sides of the gap
+    const char *text[2] = { row->chars, row->chars + row->front + row->gap };
+    size_t len[2] = { row->front, row->size - row->front - row->gap };
+    size_t tabs = row->tabs;
 
     // Initialize render buffer
     free(row->render);
-    row->render = malloc(row->size + tabs * (ZEX_TAB_STOP - 1) + 1);
+    row->render = NULL;
+    row->rsize = 0;
+    if (row_is_long(row)) return;
+    row->render = malloc(len[0] + len[1] + tabs * (ZEX_TAB_STOP - 1) + 1);
 
     // Update the row to be renderable; Renderable means the there are no more
     // tab characters and now replaced by spaces configured at the header file.
     // It also means it skips rendering the gap buffer and only renders the
     // appropriate text to the screen
     size_t i = 0;
-    for (j = 0; j < row->size; j++) {
-        // Skip rendering the gap
-        if (j >= row->front && j < row->front + row->gap) continue;
-        // Render tab as spaces until tabstop
-        if (row->chars[j] == '\t') {
-            row->render[i++] = ' ';
-            while (i % ZEX_TAB_STOP != 0) {
-                row->render[i++] = ' '; // replace tabs with spaces
-            }
+    for (int s = 0; s < 2; s++) {
+        // Text without tabs is copied as is
+        if (tabs == 0) {
+            memcpy(row->render + i, text[s], len[s]);
+            i += len[s];
+            continue;
         }
-        else {
-            row->render[i++] = row->chars[j];
+        for (size_t j = 0; j < len[s]; j++) {
+            // Render tab as spaces until tabstop
+            if (text[s][j] == '\t') {
+                row->render[i++] = ' ';
+                while (i % ZEX_TAB_STOP != 0) {
+                    row->render[i++] = ' '; // replace tabs with spaces
+                }
+            }
+            else {
+                row->render[i++] = text[s][j];
+            }
         }
     }
     row->render[i] = '\0';
     row->rsize = i; // rsize is the real size(number of characters) of the row
 }
 
+void
+row_update(editor_row_T *row)
+{
+    // Get the number of '\t' within the line
+    size_t front = row->front, tail = row->size - row->front - row->gap;
+    row->tabs = row_count_tabs(row->chars, front)
+                + row_count_tabs(row->chars + front + row->gap, tail);
+    row_render(row);
+}
+
 void
 row_new(colnr_T at, char *s)
 {
@@ -90,13 +298,41 @@ row_new(colnr_T at, char *s)
 
     // Update editor status
     econfig.line_count++;
+    row_changed_lines(at, at, 1);
+    swap_lines_changed(at, at, 1);
+}
+
+editor_row_T *
+row_open_range(linenr_T at, linenr_T n)
+{
+    if (at > econfig.line_count) at = econfig.line_count;
+    econfig.rows =
+        realloc(econfig.rows, sizeof(editor_row_T) * (econfig.line_count + n));
+
+    // Move the proceeding rows after the hole
+    memmove(&econfig.rows[at + n], &econfig.rows[at],
+            sizeof(editor_row_T) * (econfig.line_count - at));
+
+    // Update editor status
+    econfig.line_count += n;
+    row_changed_lines(at, at, n);
+    swap_lines_changed(at, at, n);
+
+    return &econfig.rows[at];
+}
+
+void
+row_changed_lines(linenr_T lnum, linenr_T lnume, long xtra)
+{
     econfig.dirty++;
+    win_changed_lines(lnum, lnume, xtra);
 }
 
 // Basically, a wrapper for rbuf_destroy
 void
 row_free(editor_row_T *row)
 {
+    cold_release(row);
     rbuf_destroy(row);
 }
 
@@ -113,7 +349,60 @@ row_delete(linenr_T at)
 
     // Update editor status
     econfig.line_count--;
-    econfig.dirty++;
+    row_changed_lines(at, at + 1, -1);
+    swap_lines_changed(at, at + 1, -1);
+}
+
+void
+row_delete_range(linenr_T at, linenr_T n)
+{
+    if (at >= econfig.line_count) return; // no row to delete
+    if (n > econfig.line_count - at) n = econfig.line_count - at;
+
+    // Free the rows then close the hole with a single move of the proceeding
+    // rows
+    for (linenr_T i = at; i < at + n; i++)
+        row_free(&econfig.rows[i]);
+    memmove(&econfig.rows[at], &econfig.rows[at + n],
+            sizeof(editor_row_T) * (econfig.line_count - at - n));
+
+    // Update editor status
+    econfig.line_count -= n;
+    row_changed_lines(at, at + n, -n);
+    swap_lines_changed(at, at + n, -n);
+}
+
+void
+row_delete_marked(const linenr_T *at, linenr_T n)
+{
+    if (n == 0) return;
+
+    // Free the marked rows and slide the others down over them in one pass
+    linenr_T dst = at[0], k = 0;
+    for (linenr_T src = at[0]; src < econfig.line_count; src++) {
+        if (k < n && at[k] == src) {
+            row_free(&econfig.rows[src]);
+            k++;
+            continue;
+        }
+        econfig.rows[dst++] = econfig.rows[src];
+    }
+
+    // Update editor status
+    row_changed_lines(at[0], econfig.line_count, dst - econfig.line_count);
+    econfig.line_count = dst;
+
+    // Journal each run of adjacent rows as one deletion
+    linenr_T removed = 0;
+    for (k = 0; k < n;) {
+        linenr_T run = 1;
+        while (k + run < n && at[k + run] == at[k] + run)
+            run++;
+        swap_lines_changed(at[k] - removed, at[k] - removed + run,
+                           -(long)run);
+        removed += run;
+        k += run;
+    }
 }
 
 void
@@ -129,20 +418,48 @@ row_insert_char(editor_row_T *row, colnr_T at, int c)
 
     // Insert character to the front of the buffer
     rbuf_insert(row, c);
+    // Update char string to render string; only the new text is looked at
+    row->tabs += c == '\t';
+    row_render(row);
+    // Flag dirty; changes have been made
+    row_changed_lines(row - econfig.rows, row - econfig.rows + 1, 0);
+    row_long_edited(row, at);
+    char ch = c;
+    swap_insert_text(row - econfig.rows, at, &ch, 1);
+}
+
+void
+row_insert_str(editor_row_T *row, colnr_T at, const char *s, size_t len)
+{
+    // Check if within row size
+    size_t rstrlen = row->size - row->gap;
+    if (at > rstrlen) at = rstrlen;
+
+    // Move the front of the gap buffer to at then insert the string
+    rbuf_move(row, at - row->front);
+    rbuf_insertn(row, s, len);
+
     // Update char string to render string
-    row_update(row);
+    row->tabs += row_count_tabs(s, len);
+    row_render(row);
     // Flag dirty; changes have been made
-    econfig.dirty++;
+    row_changed_lines(row - econfig.rows, row - econfig.rows + 1, 0);
+    row_long_edited(row, at);
+    swap_insert_text(row - econfig.rows, at, s, len);
 }
 
 void
 row_append_str(editor_row_T *row, char *s)
 {
+    colnr_T at = rbuf_len(row);
+    swap_insert_text(row - econfig.rows, at, s, strlen(s));
     rbuf_insertstr(row, s);
     // Update char string to render string
-    row_update(row);
+    row->tabs += row_count_tabs(s, strlen(s));
+    row_render(row);
     // Flag dirty; changes have been made
-    econfig.dirty++;
+    row_changed_lines(row - econfig.rows, row - econfig.rows + 1, 0);
+    row_long_edited(row, at);
 }
 
 void
@@ -152,12 +469,34 @@ row_delete_char(editor_row_T *row, colnr_T at)
     if (at < 0 || at >= rstrlen) return;
 
     // Moves the gap infront of  row[at] then deletes the ch after the gap
+    row->tabs -= rbuf_char_at(row, at) == '\t';
     rbuf_move(row, at - row->front);
     rbuf_delete(row);
 
     // Update the row to be renderable
-    row_update(row);
-    econfig.dirty++;
+    row_render(row);
+    row_changed_lines(row - econfig.rows, row - econfig.rows + 1, 0);
+    row_long_edited(row, at);
+    swap_delete_text(row - econfig.rows, at, 1);
+}
+
+void
+row_delete_chars(editor_row_T *row, colnr_T at, size_t n)
+{
+    size_t rstrlen = row->size - row->gap;
+    if (at >= rstrlen || n == 0) return;
+    if (n > rstrlen - at) n = rstrlen - at;
+
+    // Moves the gap infront of row[at] then widens it over the n chars
+    rbuf_move(row, at - row->front);
+    row->tabs -= row_count_tabs(row->chars + row->front + row->gap, n);
+    rbuf_delete_n(row, n);
+
+    // Update the row to be renderable
+    row_render(row);
+    row_changed_lines(row - econfig.rows, row - econfig.rows + 1, 0);
+    row_long_edited(row, at);
+    swap_delete_text(row - econfig.rows, at, n);
 }
 
 /* Editor operations */
@@ -169,7 +508,7 @@ editor_insert_char(int c)
         row_new(econfig.cy, "");
     }
 
-    row_insert_char(&econfig.rows[econfig.cy], econfig.cx, c);
+    row_insert_char(row_get(econfig.cy), econfig.cx, c);
     econfig.cx++;
 }
 
@@ -181,7 +520,7 @@ editor_insert_nline()
     if (econfig.cx == 0) row_new(econfig.cy, "");
     // Insert trailing chars to new row
     else {
-        editor_row_T *row = &econfig.rows[econfig.cy]; // cursor current row
+        editor_row_T *row = row_get(econfig.cy); // cursor current row
         rbuf_move(row, econfig.cx - row->front); // move gap infront of cursor
         // Get the size of the trailing characters
         size_t tail_sz = row->size - row->front - row->gap;
@@ -192,6 +531,8 @@ editor_insert_nline()
         row->gap += tail_sz;
         // Make row renderable
         row_update(row);
+        row_changed_lines(econfig.cy, econfig.cy + 1, 0);
+        swap_delete_text(econfig.cy, econfig.cx, tail_sz);
     }
 
     // Update cursor position
@@ -205,10 +546,10 @@ editor_delete_char()
     if (econfig.cy == econfig.line_count) return;
     if (econfig.cx == 0 && econfig.cy == 0) return; // no char to delete
 
-    editor_row_T *row = &econfig.rows[econfig.cy];
+    editor_row_T *row = row_get(econfig.cy);
     // Check if cur is at the beginning of a line
     if (econfig.cx == 0) {
-        editor_row_T *prev_row = &econfig.rows[econfig.cy - 1];
+        editor_row_T *prev_row = row_get(econfig.cy - 1);
 
         // Move gap to the end of prev_row's char
         size_t tail_sz = prev_row->size - prev_row->front
@@ -220,7 +561,12 @@ editor_delete_char()
 
         // Put cursor at the EOL of prev_row then insert text
         econfig.cx = prev_row->size - prev_row->gap;
-        row_append_str(prev_row, row->render);
+        size_t len = rbuf_len(row);
+        char *text = malloc(len + 1);
+        rbuf_copy(row, 0, len, text);
+        text[len] = '\0';
+        row_append_str(prev_row, text);
+        free(text);
 
         // Delete row
         row_delete(econfig.cy);
@@ -7,11 +7,25 @@
 #ifndef EDIT_H
 #define EDIT_H
 
+#include <stdbool.h>
+
 #include "config.h"
 
 #define ZEX_TAB_STOP 4
+// Rows at least this long are not rendered as a whole; only the columns
+// drawn are expanded
+#define ZEX_LONG_ROW_LEN (1 << 16)
 
 /* row operations */
+/**
+ * @brief Get a row of the current buffer holding its text
+ *
+ * A packed row is unpacked first; see cold.h.
+ *
+ * @param lnum Index of the row
+ */
+editor_row_T *row_get(linenr_T lnum);
+
 /**
  * @brief Convert cx to rx to accomodate '\t' ch
  *
@@ -20,6 +34,46 @@
  */
 int row_convert_cx_to_rx(editor_row_T *row, int cx);
 
+/**
+ * @brief Convert rx to the index of the character drawn at it
+ *
+ * @param row Row to convert from
+ * @param rx Screen column
+ * @return Index of the character; the length of the row if rx is past its end
+ */
+colnr_T row_convert_rx_to_cx(editor_row_T *row, colnr_T rx);
+
+/**
+ * @brief Check if a row is long; long rows have no render buffer
+ *
+ * Columns of a long row are mapped from a column mapped before near them,
+ * and only the part of it shown on the screen is expanded.
+ *
+ * @param row Row to check
+ */
+bool row_is_long(const editor_row_T *row);
+
+/**
+ * @brief Get the number of screen columns the text of a row takes
+ *
+ * @param row Row to measure
+ */
+colnr_T row_width(const editor_row_T *row);
+
+/**
+ * @brief Expand the screen columns [left, left + width) of a row
+ *
+ * @param row Row to expand
+ * @param left First screen column
+ * @param width Most columns to expand
+ * @param dest Buffer of at least width bytes
+ * @return Number of columns expanded; less than width past the end
+ */
+colnr_T row_render_cols(const editor_row_T *row,
+                        colnr_T left,
+                        colnr_T width,
+                        char *dest);
+
 /**
  * @brief Update row and change '\t' to spaces
  *
@@ -41,6 +95,30 @@ void row_update(editor_row_T *row);
  */
 void row_new(linenr_T at, char *str);
 
+/**
+ * @brief Open a hole of n rows in the editor
+ *
+ * The proceeding rows are moved once for all n rows. The rows of the hole are
+ * left uninitialized and must be filled by the caller, e.g. with rbuf_share.
+ *
+ * @param at Index of the first row of the hole
+ * @param n Number of rows
+ * @return Pointer to the first row of the hole
+ */
+editor_row_T *row_open_range(linenr_T at, linenr_T n);
+
+/**
+ * @brief Flag lines as changed
+ *
+ * Every change to the rows goes through here; the windows showing the lines
+ * draw them again.
+ *
+ * @param lnum Index of the first changed line
+ * @param lnume Index after the last changed line, before the change
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void row_changed_lines(linenr_T lnum, linenr_T lnume, long xtra);
+
 /**
  * @brief Free a memory allocated for row
  *
@@ -55,6 +133,22 @@ void row_free(editor_row_T *row);
  */
 void row_delete(linenr_T at);
 
+/**
+ * @brief Delete a range of rows at once
+ *
+ * @param at Index of the first row to delete
+ * @param n Number of rows to delete; clamped to the last row
+ */
+void row_delete_range(linenr_T at, linenr_T n);
+
+/**
+ * @brief Delete rows at sorted indices with a single pass over the rows
+ *
+ * @param at Indices of the rows to delete in increasing order
+ * @param n Number of indices
+ */
+void row_delete_marked(const linenr_T *at, linenr_T n);
+
 /**
  * @brief Insert a character to the line/row
  *
@@ -64,6 +158,16 @@ void row_delete(linenr_T at);
  */
 void row_insert_char(editor_row_T *row, colnr_T at, int c);
 
+/**
+ * @brief Insert string to the line/row
+ *
+ * @param row  Pointer to row to insert to
+ * @param at Cursor x pos; position of the first character inserted
+ * @param s String to insert
+ * @param len Length of string to insert
+ */
+void row_insert_str(editor_row_T *row, colnr_T at, const char *s, size_t len);
+
 /**
  * @brief Append string
  *
@@ -81,6 +185,15 @@ void row_append_str(editor_row_T *row, char *str);
  */
 void row_delete_char(editor_row_T *row, colnr_T at);
 
+/**
+ * @brief Delete characters from line/row in a single gap buffer operation
+ *
+ * @param row  Pointer to row to delete from
+ * @param at Cursor x pos; position of the first character to delete
+ * @param n Number of characters to delete; clamped to the end of the row
+ */
+void row_delete_chars(editor_row_T *row, colnr_T at, size_t n);
+
 /* editor operations */
 /**
  * @brief Insert a new char to the editor
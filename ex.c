@@ -0,0 +1,952 @@
+/**
+ * @file ex.c
+ * @author re-nanashi
+ * @brief Ex commands typed on the command line
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "ex.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "buflist.h"
+#include "byteidx.h"
+#include "edit.h"
+#include "file_io.h"
+#include "fold.h"
+#include "follow.h"
+#include "ops.h"
+#include "register.h"
+#include "screen.h"
+#include "search.h"
+#include "shell.h"
+#include "sort.h"
+#include "swap.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Command accepts a range
+#define EX_RANGE 0x01
+// Command accepts '!' after its name
+#define EX_BANG 0x02
+// Default range of the command is the whole file
+#define EX_DFLALL 0x04
+
+typedef void (*ex_func_T)(exarg_T *);
+
+static void ex_bang(exarg_T *eap);
+static void ex_bnext(exarg_T *eap);
+static void ex_buffer(exarg_T *eap);
+static void ex_delete(exarg_T *eap);
+static void ex_close(exarg_T *eap);
+static void ex_edit(exarg_T *eap);
+static void ex_fold(exarg_T *eap);
+static void ex_foldindent(exarg_T *eap);
+static void ex_follow(exarg_T *eap);
+static void ex_global(exarg_T *eap);
+static void ex_goto(exarg_T *eap);
+static void ex_ls(exarg_T *eap);
+static void ex_only(exarg_T *eap);
+static void ex_qall(exarg_T *eap);
+static void ex_quit(exarg_T *eap);
+static void ex_read(exarg_T *eap);
+static void ex_set(exarg_T *eap);
+static void ex_shift(exarg_T *eap);
+static void ex_sort(exarg_T *eap);
+static void ex_split(exarg_T *eap);
+static void ex_write(exarg_T *eap);
+static void ex_wq(exarg_T *eap);
+static void ex_xit(exarg_T *eap);
+static void ex_yank(exarg_T *eap);
+
+/* @brief Ex commands; a typed name matches the first command it abbreviates */
+static const struct {
+    /* full name */
+    const char *name;
+    /* length of the shortest abbreviation */
+    size_t minlen;
+    /* function executing the command */
+    ex_func_T func;
+    /* EX_ flags */
+    int flags;
+} ex_cmds[] = {
+    { "buffer", 1, ex_buffer, 0 },
+    { "buffers", 7, ex_ls, 0 },
+    { "bnext", 2, ex_bnext, 0 },
+    { "bNext", 2, ex_bnext, 0 },
+    { "bprevious", 2, ex_bnext, 0 },
+    { "close", 3, ex_close, EX_BANG },
+    { "delete", 1, ex_delete, EX_RANGE },
+    { "edit", 1, ex_edit, EX_BANG },
+    { "files", 5, ex_ls, 0 },
+    { "follow", 3, ex_follow, 0 },
+    { "fold", 2, ex_fold, EX_RANGE },
+    { "foldindent", 5, ex_foldindent, EX_RANGE | EX_DFLALL },
+    { "global", 1, ex_global, EX_RANGE | EX_BANG | EX_DFLALL },
+    { "goto", 2, ex_goto, 0 },
+    { "ls", 2, ex_ls, 0 },
+    { "only", 2, ex_only, EX_BANG },
+    { "qall", 2, ex_qall, EX_BANG },
+    { "quit", 1, ex_quit, EX_BANG },
+    { "read", 1, ex_read, EX_RANGE },
+    { "set", 2, ex_set, 0 },
+    { "split", 2, ex_split, 0 },
+    { "sort", 3, ex_sort, EX_RANGE | EX_BANG | EX_DFLALL },
+    { "vglobal", 1, ex_global, EX_RANGE | EX_DFLALL },
+    { "vsplit", 2, ex_split, 0 },
+    { "write", 1, ex_write, EX_BANG },
+    { "wq", 2, ex_wq, EX_BANG },
+    { "xit", 1, ex_xit, EX_BANG },
+    { "yank", 1, ex_yank, EX_RANGE },
+    { ">", 1, ex_shift, EX_RANGE },
+    { "<", 1, ex_shift, EX_RANGE },
+    { "!", 1, ex_bang, EX_RANGE },
+};
+
+/* @brief Options of :set; every option is on or off */
+static const struct {
+    /* full name */
+    const char *name;
+    /* value in the editor */
+    int *value;
+} ex_options[] = {
+    { "coldrows", &econfig.coldrows },
+    { "wrap", &econfig.wrap },
+};
+
+/* @brief Pattern typed last; used for an empty pattern */
+static char *ex_last_pattern;
+/* @brief True while :global executes its command */
+static bool ex_in_global;
+
+static const char *
+skipwhite(const char *p)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
+    return p;
+}
+
+// Move the cursor to the first non-blank of a line
+static void
+ex_cursor_line(linenr_T lnum)
+{
+    econfig.cy = lnum;
+    econfig.cx = 0;
+    if (lnum >= econfig.line_count) return;
+
+    editor_row_T *row = row_get(lnum);
+    colnr_T len = rbuf_len(row);
+    while (econfig.cx < len && isspace(rbuf_char_at(row, econfig.cx)))
+        econfig.cx++;
+    if (econfig.cx == len && len) econfig.cx--;
+}
+
+// Clear the screen and leave the editor
+static void
+ex_exit()
+{
+    swap_remove_all();
+    write(STDOUT_FILENO, "\x1b[2J", 4); // clears the screen; check VT100
+    write(STDOUT_FILENO, "\x1b[H", 3); // reposition cursor to top
+    exit(0);
+}
+
+// Read a pattern up to an unescaped delimiter; the backslash of an escaped
+// delimiter is dropped. Returns a pointer past the closing delimiter.
+static const char *
+ex_read_pattern(const char *p, int delim, char **pat, size_t *len)
+{
+    char *buf = malloc(strlen(p) + 1);
+    size_t n = 0;
+    while (*p && *p != delim) {
+        if (*p == '\\' && p[1] == delim)
+            p++;
+        else if (*p == '\\' && p[1])
+            buf[n++] = *p++;
+        buf[n++] = *p++;
+    }
+    if (*p == delim) p++;
+    buf[n] = '\0';
+
+    *pat = buf;
+    *len = n;
+    return p;
+}
+
+// Compile a typed pattern; an empty one is the pattern typed last
+static bool
+ex_compile_pattern(spat_T *sp, const char *pat, size_t len)
+{
+    if (len == 0) {
+        if (ex_last_pattern == NULL) {
+            statusbar_set_message("No previous regular expression");
+            return false;
+        }
+        return search_compile(sp, ex_last_pattern, strlen(ex_last_pattern),
+                              false);
+    }
+
+    free(ex_last_pattern);
+    ex_last_pattern = strdup(pat);
+    return search_compile(sp, pat, len, false);
+}
+
+// Line number of the first line after or before a line that matches a
+// pattern; the search wraps around the file. Line numbers start at 1 and 0
+// is returned if no line matches.
+static long
+ex_search_line(const spat_T *sp, long from, int dir)
+{
+    long n = econfig.line_count;
+    for (long i = 1; i <= n; i++) {
+        long lnum = ((from - 1 + dir * i) % n + n) % n;
+        if (search_match_row(sp, &econfig.rows[lnum])) return lnum + 1;
+    }
+    return 0;
+}
+
+// Parse an address and its offsets into a line number starting at 1. Sets
+// found to false if there is no address. Returns NULL on error.
+static const char *
+ex_parse_addr(const char *p, long *lnum, bool *found)
+{
+    char *end;
+    long cur = econfig.cy + 1;
+
+    *found = true;
+    p = skipwhite(p);
+    if (isdigit(*p)) {
+        *lnum = strtol(p, &end, 10);
+        p = end;
+    }
+    else if (*p == '.') {
+        *lnum = cur;
+        p++;
+    }
+    else if (*p == '$') {
+        // The last line is only known once the whole file is read
+        file_load_finish();
+        *lnum = econfig.line_count;
+        p++;
+    }
+    else if (*p == '/' || *p == '?') {
+        // Next line that matches searching forward or backward; the search
+        // wraps around the whole file
+        int delim = *p;
+        char *pat;
+        size_t len;
+        p = ex_read_pattern(p + 1, delim, &pat, &len);
+
+        spat_T sp;
+        bool ok = ex_compile_pattern(&sp, pat, len);
+        free(pat);
+        if (!ok) return NULL;
+
+        file_load_finish();
+        *lnum = ex_search_line(&sp, cur, delim == '/' ? 1 : -1);
+        search_free(&sp);
+        if (*lnum == 0) {
+            statusbar_set_message("Pattern not found: %s", ex_last_pattern);
+            return NULL;
+        }
+    }
+    else if (*p == '+' || *p == '-') {
+        // Offset from the current line
+        *lnum = cur;
+    }
+    else {
+        *found = false;
+        return p;
+    }
+
+    // Offsets; a sign without a number is 1
+    for (p = skipwhite(p); *p == '+' || *p == '-'; p = skipwhite(p)) {
+        long sign = *p++ == '+' ? 1 : -1;
+        long n = 1;
+        if (isdigit(*p)) {
+            n = strtol(p, &end, 10);
+            p = end;
+        }
+        *lnum += sign * n;
+    }
+
+    return p;
+}
+
+// Parse the range in front of a command into line numbers starting at 1.
+// Returns a pointer to the command name or NULL on error.
+static const char *
+ex_parse_range(const char *p, exarg_T *eap, long *line1, long *line2)
+{
+    *line1 = *line2 = econfig.cy + 1;
+    eap->addr_count = 0;
+
+    p = skipwhite(p);
+    if (*p == '%') {
+        // Whole file
+        file_load_finish();
+        *line1 = 1;
+        *line2 = econfig.line_count;
+        eap->addr_count = 2;
+        return skipwhite(p + 1);
+    }
+
+    bool separated = false;
+    for (;;) {
+        long lnum;
+        bool found;
+        p = ex_parse_addr(p, &lnum, &found);
+        if (p == NULL) return NULL;
+
+        // An address left out next to a separator is the current line
+        if (!found) {
+            if (!separated && *p != ',' && *p != ';') break;
+            lnum = econfig.cy + 1;
+        }
+
+        *line1 = *line2;
+        *line2 = lnum;
+        eap->addr_count++;
+        separated = false;
+
+        if (*p == ';') {
+            // The following address is relative to this one
+            if (lnum > 0 && lnum <= (long)econfig.line_count)
+                econfig.cy = lnum - 1;
+        }
+        else if (*p != ',') {
+            break;
+        }
+        separated = true;
+        p++;
+    }
+
+    if (eap->addr_count == 1) *line1 = *line2;
+    return skipwhite(p);
+}
+
+void
+ex_execute(const char *cmdline)
+{
+    exarg_T ea = { 0 };
+    const char *p = cmdline;
+    while (*p == ':' || *p == ' ' || *p == '\t')
+        p++;
+
+    long line1, line2;
+    p = ex_parse_range(p, &ea, &line1, &line2);
+    if (p == NULL) return;
+
+    if (ea.addr_count
+        && (line1 < 0 || line2 < 0 || line1 > (long)econfig.line_count
+            || line2 > (long)econfig.line_count))
+    {
+        statusbar_set_message("Invalid range");
+        return;
+    }
+    if (line1 > line2) {
+        long tmp = line1;
+        line1 = line2;
+        line2 = tmp;
+    }
+
+    // Command name; letters or a run of a shift character
+    const char *name = p;
+    if (isalpha(*p)) {
+        while (isalpha(*p))
+            p++;
+    }
+    else if (*p == '>' || *p == '<') {
+        while (*p == *name)
+            p++;
+    }
+    else if (*p == '!') {
+        p++;
+    }
+    size_t namelen = p - name;
+
+    if (namelen == 0) {
+        if (*p) {
+            statusbar_set_message("Not an editor command: %s", cmdline);
+            return;
+        }
+
+        // A range alone moves the cursor to its last line
+        if (ea.addr_count && econfig.line_count)
+            ex_cursor_line(line2 > 0 ? line2 - 1 : 0);
+        return;
+    }
+
+    // Shift commands repeat the character to shift more
+    size_t cmdlen = *name == '>' || *name == '<' ? 1 : namelen;
+    size_t idx;
+    for (idx = 0; idx < sizeof(ex_cmds) / sizeof(ex_cmds[0]); idx++) {
+        if (cmdlen >= ex_cmds[idx].minlen
+            && cmdlen <= strlen(ex_cmds[idx].name)
+            && strncmp(ex_cmds[idx].name, name, cmdlen) == 0)
+            break;
+    }
+    if (idx == sizeof(ex_cmds) / sizeof(ex_cmds[0])) {
+        statusbar_set_message("Not an editor command: %s", cmdline);
+        return;
+    }
+
+    int flags = ex_cmds[idx].flags;
+    if (ea.addr_count && !(flags & EX_RANGE)) {
+        statusbar_set_message("No range allowed");
+        return;
+    }
+    if (*p == '!' && (flags & EX_BANG)) {
+        ea.forceit = true;
+        p++;
+    }
+    if (ea.addr_count == 0 && (flags & EX_DFLALL)) {
+        file_load_finish();
+        line1 = 1;
+        line2 = econfig.line_count;
+    }
+
+    // Line numbers of commands start at 0; line 0 of a range is the first
+    // line
+    ea.line0 = line2 == 0;
+    ea.line1 = line1 > 0 ? line1 - 1 : 0;
+    ea.line2 = line2 > 0 ? line2 - 1 : 0;
+    ea.cmd = name;
+    ea.arg = skipwhite(p);
+    ex_cmds[idx].func(&ea);
+}
+
+// Read the register name and count after :delete and :yank. A count makes
+// the range count lines starting at its last line.
+static bool
+ex_regcount(exarg_T *eap, int *regname)
+{
+    const char *p = eap->arg;
+    *regname = 0;
+    if (*p && !isdigit(*p) && reg_valid(*p)) {
+        *regname = *p++;
+        p = skipwhite(p);
+    }
+
+    if (isdigit(*p)) {
+        char *end;
+        long n = strtol(p, &end, 10);
+        if (n <= 0) {
+            statusbar_set_message("Positive count required");
+            return false;
+        }
+        eap->line1 = eap->line2;
+        eap->line2 = eap->line1 + n - 1;
+        if (eap->line2 >= econfig.line_count)
+            eap->line2 = econfig.line_count - 1;
+        p = skipwhite(end);
+    }
+
+    if (*p) {
+        statusbar_set_message("Trailing characters: %s", p);
+        return false;
+    }
+    return true;
+}
+
+// Operator arguments for the lines of the range
+static void
+ex_range_oparg(const exarg_T *eap, oparg_T *oap, int op_type, int regname)
+{
+    memset(oap, 0, sizeof(*oap));
+    oap->op_type = op_type;
+    oap->regname = regname;
+    oap->motion_type = MLINE;
+    oap->start.lnum = eap->line1;
+    oap->end.lnum = eap->line2;
+}
+
+static void
+ex_delete(exarg_T *eap)
+{
+    int regname;
+    if (econfig.line_count == 0 || !ex_regcount(eap, &regname)) return;
+
+    oparg_T oa;
+    ex_range_oparg(eap, &oa, 'd', regname);
+    op_delete(&oa);
+    ex_cursor_line(econfig.cy);
+}
+
+static void
+ex_yank(exarg_T *eap)
+{
+    int regname;
+    if (econfig.line_count == 0 || !ex_regcount(eap, &regname)) return;
+
+    oparg_T oa;
+    ex_range_oparg(eap, &oa, 'y', regname);
+    op_yank(&oa, false);
+}
+
+static void
+ex_shift(exarg_T *eap)
+{
+    if (econfig.line_count == 0) return;
+
+    int amount = 0;
+    while (eap->cmd[amount] == eap->cmd[0])
+        amount++;
+
+    oparg_T oa;
+    ex_range_oparg(eap, &oa, eap->cmd[0], 0);
+    op_shift(&oa, eap->cmd[0] == '>' ? amount : -amount);
+}
+
+// Check if the command of :global is a plain :delete; reads its register
+static bool
+ex_is_delete(const char *cmd, int *regname)
+{
+    const char *p = skipwhite(cmd);
+    const char *name = p;
+    while (isalpha(*p))
+        p++;
+    size_t len = p - name;
+    if (len == 0 || len > 6 || strncmp("delete", name, len) != 0) return false;
+
+    p = skipwhite(p);
+    *regname = 0;
+    if (*p && !isdigit(*p) && reg_valid(*p)) *regname = *p++;
+    return *skipwhite(p) == '\0';
+}
+
+// Delete the marked lines with a single compaction of the rows; the register
+// gets the last deleted line like it would from a :delete on each line
+static void
+ex_global_delete(const linenr_T *marks, linenr_T n, int regname)
+{
+    oparg_T oa = { 0 };
+    oa.regname = regname;
+    oa.motion_type = MLINE;
+    oa.start.lnum = oa.end.lnum = marks[n - 1];
+    if (!op_yank(&oa, true)) return;
+
+    row_delete_marked(marks, n);
+
+    // The cursor goes to the line after the last deleted one
+    linenr_T lnum = marks[n - 1] - (n - 1);
+    if (lnum >= econfig.line_count)
+        lnum = econfig.line_count ? econfig.line_count - 1 : 0;
+    ex_cursor_line(lnum);
+
+    if (n > 2) statusbar_set_message("%lu fewer lines", n);
+}
+
+// Execute a command on each marked line. The marks are line numbers from
+// before the first command ran; lines added or removed by a command are
+// taken to start at the line it ran on and shift the marks after it.
+static void
+ex_global_execute(const linenr_T *marks, linenr_T n, const char *cmd)
+{
+    long shift = 0;
+    linenr_T skip_until = 0;
+
+    for (linenr_T i = 0; i < n; i++) {
+        // Lines removed by an earlier command
+        if (marks[i] < skip_until) continue;
+
+        long lnum = (long)marks[i] + shift;
+        if (lnum < 0 || lnum >= (long)econfig.line_count) break;
+
+        econfig.cy = lnum;
+        econfig.cx = 0;
+        linenr_T before = econfig.line_count;
+        ex_execute(cmd);
+
+        long delta = (long)econfig.line_count - (long)before;
+        if (delta < 0) skip_until = marks[i] - delta;
+        shift += delta;
+    }
+}
+
+static void
+ex_global(exarg_T *eap)
+{
+    if (ex_in_global) {
+        statusbar_set_message("Cannot do :global recursive");
+        return;
+    }
+    bool invert = eap->cmd[0] == 'v' || eap->forceit;
+
+    int delim = *eap->arg;
+    if (delim == '\0' || isalnum(delim) || delim == '\\' || delim == '"'
+        || delim == '|')
+    {
+        statusbar_set_message("Regular expression missing from :global");
+        return;
+    }
+
+    char *pat;
+    size_t len;
+    const char *cmd = ex_read_pattern(eap->arg + 1, delim, &pat, &len);
+    spat_T sp;
+    bool ok = ex_compile_pattern(&sp, pat, len);
+    free(pat);
+    if (!ok) return;
+
+    // First pass: mark the lines to execute the command on; commands may
+    // move lines, so the whole file is read first
+    file_load_finish();
+    linenr_T n = 0;
+    linenr_T *marks = malloc(sizeof(linenr_T) * (eap->line2 - eap->line1 + 1));
+    for (linenr_T lnum = eap->line1;
+         lnum <= eap->line2 && lnum < econfig.line_count; lnum++)
+    {
+        if (search_match_row(&sp, &econfig.rows[lnum]) != invert)
+            marks[n++] = lnum;
+    }
+    search_free(&sp);
+
+    if (n == 0) {
+        statusbar_set_message(invert ? "Pattern found in every line: %s"
+                                     : "Pattern not found: %s",
+                              ex_last_pattern);
+        free(marks);
+        return;
+    }
+
+    // Second pass: execute the command; deleting is done all at once
+    int regname;
+    ex_in_global = true;
+    if (ex_is_delete(cmd, &regname))
+        ex_global_delete(marks, n, regname);
+    else
+        ex_global_execute(marks, n, cmd);
+    ex_in_global = false;
+
+    free(marks);
+}
+
+// Write the file, or the file named by the argument. Returns false if it
+// could not be written.
+static bool
+ex_write_file(exarg_T *eap)
+{
+    const char *name = eap->arg;
+    if (*name == '\0'
+        || (econfig.filename && strcmp(econfig.filename, name) == 0))
+        return file_write();
+
+    // Naming a file when there is none gives it that name
+    if (econfig.filename == NULL) {
+        econfig.filename = strdup(name);
+        return file_write();
+    }
+    return file_write_to(name);
+}
+
+static void
+ex_write(exarg_T *eap)
+{
+    ex_write_file(eap);
+}
+
+static void
+ex_quit(exarg_T *eap)
+{
+    // The buffer of a closed window stays in the buffer list
+    if (win_close()) return;
+    if (econfig.dirty && !eap->forceit) {
+        statusbar_set_message("No write since last change (add ! to override)");
+        return;
+    }
+    if (!eap->forceit && buflist_other_changed()) return;
+    ex_exit();
+}
+
+static void
+ex_qall(exarg_T *eap)
+{
+    if (!eap->forceit) {
+        if (econfig.dirty) {
+            statusbar_set_message(
+                "No write since last change (add ! to override)");
+            return;
+        }
+        if (buflist_other_changed()) return;
+    }
+    ex_exit();
+}
+
+static void
+ex_wq(exarg_T *eap)
+{
+    if (!ex_write_file(eap)) return;
+    if (win_close()) return;
+    if (!eap->forceit && buflist_other_changed()) return;
+    ex_exit();
+}
+
+static void
+ex_xit(exarg_T *eap)
+{
+    // Writes only when there are changes
+    if (econfig.dirty && !ex_write_file(eap)) return;
+    if (win_close()) return;
+    if (!eap->forceit && buflist_other_changed()) return;
+    ex_exit();
+}
+
+static void
+ex_bang(exarg_T *eap)
+{
+    if (*eap->arg == '\0') {
+        statusbar_set_message("Argument required");
+        return;
+    }
+
+    // Without a range the command runs on the terminal
+    if (eap->addr_count == 0) {
+        shell_execute(eap->arg);
+        return;
+    }
+    file_load_finish();
+    if (econfig.line_count == 0) return;
+
+    // The output of the command replaces the lines
+    linenr_T count = eap->line2 - eap->line1 + 1;
+    int status;
+    if (shell_filter(eap->arg, eap->line1, count, eap->line2 + 1, &status)
+        == -1)
+        return;
+    row_delete_range(eap->line1, count);
+    ex_cursor_line(eap->line1 < econfig.line_count ? eap->line1
+                   : econfig.line_count        ? econfig.line_count - 1
+                                               : 0);
+
+    if (status)
+        statusbar_set_message("shell returned %d", status);
+    else
+        statusbar_set_message("%lu lines filtered", count);
+}
+
+static void
+ex_read(exarg_T *eap)
+{
+    // Text goes below the line; line 0 puts it above the first line
+    linenr_T at = eap->line0 || econfig.line_count == 0 ? 0 : eap->line2 + 1;
+    const char *arg = eap->arg;
+    long n;
+    int status = 0;
+
+    if (*arg == '!') {
+        n = shell_filter(arg + 1, 0, 0, at, &status);
+    }
+    else if (*arg) {
+        n = file_read(arg, at);
+    }
+    else if (econfig.filename) {
+        n = file_read(econfig.filename, at);
+    }
+    else {
+        statusbar_set_message("No file name");
+        return;
+    }
+    if (n < 0) return;
+
+    if (n) ex_cursor_line(at);
+    if (status) statusbar_set_message("shell returned %d", status);
+}
+
+static void
+ex_sort(exarg_T *eap)
+{
+    sortopt_T opt = { 0 };
+    opt.reverse = eap->forceit;
+
+    char *pat = NULL;
+    size_t patlen = 0;
+    const char *p = eap->arg;
+    while (*p) {
+        if (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        else if (*p == 'i' || *p == 'n' || *p == 'r' || *p == 'u') {
+            if (*p == 'i') opt.ignore_case = true;
+            if (*p == 'n') opt.numeric = true;
+            if (*p == 'r') opt.key_is_match = true;
+            if (*p == 'u') opt.unique = true;
+            p++;
+        }
+        else if (*p == '"') {
+            break;
+        }
+        else if (pat == NULL && !isalnum(*p) && *p != '\\' && *p != '|') {
+            p = ex_read_pattern(p + 1, *p, &pat, &patlen);
+        }
+        else {
+            statusbar_set_message("Invalid argument: %s", p);
+            free(pat);
+            return;
+        }
+    }
+
+    // Check the pattern here; the sort compiles it again for each thread
+    if (pat) {
+        spat_T sp;
+        bool ok = ex_compile_pattern(&sp, pat, patlen);
+        free(pat);
+        if (!ok) return;
+        search_free(&sp);
+        opt.pat = ex_last_pattern;
+        opt.pat_len = strlen(ex_last_pattern);
+    }
+    else {
+        opt.key_is_match = false;
+    }
+
+    // Sorting moves the lines; the whole file is read first
+    file_load_finish();
+    linenr_T count = eap->line2 - eap->line1 + 1;
+    if (econfig.line_count == 0 || count < 2) return;
+
+    long removed = sort_lines(eap->line1, count, &opt);
+    if (removed < 0) return;
+
+    ex_cursor_line(eap->line1);
+    if (removed > 2) statusbar_set_message("%ld fewer lines", removed);
+}
+
+static void
+ex_edit(exarg_T *eap)
+{
+    buflist_edit(*eap->arg ? eap->arg : NULL, eap->forceit);
+}
+
+static void
+ex_buffer(exarg_T *eap)
+{
+    buflist_goto(eap->arg);
+}
+
+static void
+ex_bnext(exarg_T *eap)
+{
+    int count = *eap->arg ? atoi(eap->arg) : 1;
+    if (count <= 0) {
+        statusbar_set_message("Positive count required");
+        return;
+    }
+    buflist_next(eap->cmd[1] == 'n' ? count : -count);
+}
+
+// ":set name" turns an option on, ":set noname" off and ":set name?" shows it
+static void
+ex_set(exarg_T *eap)
+{
+    const char *name = eap->arg;
+    size_t len = strcspn(name, "? \t");
+    bool show = name[len] == '?';
+    int value = 1;
+    if (!show && strncmp(name, "no", 2) == 0) {
+        name += 2;
+        len -= 2;
+        value = 0;
+    }
+
+    for (size_t i = 0; i < sizeof(ex_options) / sizeof(ex_options[0]); i++) {
+        if (strlen(ex_options[i].name) != len
+            || strncmp(ex_options[i].name, name, len) != 0)
+            continue;
+        if (show)
+            statusbar_set_message("%s%s", *ex_options[i].value ? "" : "no",
+                                  ex_options[i].name);
+        else
+            *ex_options[i].value = value;
+        return;
+    }
+    statusbar_set_message("Unknown option: %s", eap->arg);
+}
+
+static void
+ex_split(exarg_T *eap)
+{
+    // :vsplit puts the new window on the left
+    if (!win_split(eap->cmd[0] == 'v')) return;
+    if (*eap->arg) buflist_edit(eap->arg, false);
+}
+
+static void
+ex_close(exarg_T *eap)
+{
+    (void)eap;
+    if (!win_close()) statusbar_set_message("Cannot close last window");
+}
+
+// Start following the file of the buffer or stop it
+static void
+ex_follow(exarg_T *eap)
+{
+    (void)eap;
+    if (econfig.follow == NULL) {
+        follow_start();
+        return;
+    }
+    follow_stop(econfig.follow);
+    econfig.follow = NULL;
+    statusbar_set_message("Stopped following \"%s\"",
+                          econfig.filename ? econfig.filename : "[No Name]");
+}
+
+static void
+ex_fold(exarg_T *eap)
+{
+    fold_create(eap->line1, eap->line2);
+}
+
+static void
+ex_foldindent(exarg_T *eap)
+{
+    long n = fold_indent(eap->line1, eap->line2);
+    statusbar_set_message("%ld fold%s", n, n == 1 ? "" : "s");
+}
+
+// ":goto n" moves to byte n of the buffer; the first byte without n
+static void
+ex_goto(exarg_T *eap)
+{
+    const char *p = eap->arg;
+    unsigned long long n = 1;
+    if (*p) {
+        char *end;
+        n = isdigit(*p) ? strtoull(p, &end, 10) : 0;
+        if (n == 0) {
+            statusbar_set_message("Positive count required");
+            return;
+        }
+        p = skipwhite(end);
+        if (*p) {
+            statusbar_set_message("Trailing characters: %s", p);
+            return;
+        }
+    }
+    file_load_finish();
+    byteidx_goto(n - 1);
+}
+
+static void
+ex_only(exarg_T *eap)
+{
+    (void)eap;
+    win_only();
+}
+
+static void
+ex_ls(exarg_T *eap)
+{
+    (void)eap;
+    buflist_list();
+}
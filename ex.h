@@ -0,0 +1,42 @@
+/**
+ * @file ex.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for ex commands
+ */
+
+#ifndef EX_H
+#define EX_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/* @brief Arguments of a parsed ex command */
+typedef struct exarg {
+    /* argument text after the command name; never NULL */
+    const char *arg;
+    /* name of the command as typed */
+    const char *cmd;
+    /* first line of the range */
+    linenr_T line1;
+    /* last line of the range */
+    linenr_T line2;
+    /* number of addresses typed */
+    int addr_count;
+    /* true if the last address is line 0; before the first line */
+    bool line0;
+    /* true if '!' followed the command name */
+    bool forceit;
+} exarg_T;
+
+/**
+ * @brief Execute a command line
+ *
+ * A command line is an optional range followed by a command and its
+ * arguments. A range without a command moves the cursor to its last line.
+ *
+ * @param cmdline Command line without the leading ':'
+ */
+void ex_execute(const char *cmdline);
+
+#endif /* EX_H */
@@ -16,66 +16,618 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "config.h"
 #include "screen.h"
 #include "edit.h"
 #include "logger.h"
 #include "input.h"
+#include "buffer.h"
+#include "cold.h"
+#include "swap.h"
+#include "lineidx.h"
+#include "win.h"
 
-char *
-editor_rows_to_str(int *buflen)
+/* @brief Internal macros */
+#define FILE_THREADS_MAX 64
+// Fewest lines given to a thread of its own
+#define FILE_LINES_PER_THREAD 65536
+
+// Most buffers handed to a single writev
+#define FILE_IOV_MAX 1024
+// Size of the buffer the text of packed rows is copied to before a write
+#define FILE_STAGE_SIZE 65536
+
+// Files at least this big are read in the background after the first lines
+#define FILE_LOAD_ASYNC_MIN (4 << 20)
+// Lines read before the editor is shown
+#define FILE_LOAD_FIRST_LINES 1000
+// Lines built into rows at a time by the background reader
+#define FILE_LOAD_BATCH_LINES 262144
+
+/* @brief Slice of the lines of a file built into rows by a thread */
+typedef struct filejob {
+    /* text of the file */
+    const char *data;
+    /* offsets of its lines */
+    const lineidx_T *idx;
+    /* rows of the lines from first on */
+    editor_row_T *rows;
+    linenr_T first;
+    /* lines [lo, hi) of the slice */
+    linenr_T lo, hi;
+} filejob_T;
+
+/* @brief Rows built by the background reader, waiting to be added */
+typedef struct loadbatch {
+    editor_row_T *rows;
+    linenr_T count;
+    /* bytes of the file read up to the end of the batch */
+    size_t end;
+    struct loadbatch *next;
+} loadbatch_T;
+
+/* @brief Reading of the rest of a big file while it is edited */
+typedef struct fileload {
+    /* name of the file */
+    char *filename;
+    /* status and mapped text of the file */
+    struct stat st;
+    char *data;
+    /* lines read before the reader was started */
+    linenr_T first;
+    pthread_t thread;
+    /* guards the fields below */
+    pthread_mutex_t lock;
+    /* batches built and not added yet; oldest first */
+    loadbatch_T *head, **tail;
+    /* true once every line was built */
+    bool done;
+    /* true if the rest of the file is not wanted anymore */
+    bool cancel;
+    /* bytes of the file added to the buffer; used by the editor only */
+    size_t read;
+} fileload_T;
+
+/* @brief Reading of the file of the current buffer; NULL when it is read */
+static fileload_T *file_loader;
+
+// Write all of the buffers; a short write goes on where it stopped
+static bool
+file_writev_all(int fd, struct iovec *iov, int n)
+{
+    while (n > 0) {
+        ssize_t written = writev(fd, iov, n);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t w = written;
+        for (; n > 0 && w >= iov->iov_len; iov++, n--)
+            w -= iov->iov_len;
+        if (n > 0) {
+            iov->iov_base = (char *)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    return true;
+}
+
+// Write the rows of the current buffer a batch at a time; a row is its text
+// on both sides of the gap and a line break. The text of a packed row is
+// only valid until the next one is read, so it is copied out first.
+static bool
+file_write_rows(int fd)
 {
-    int totallen = 0;
-    size_t i;
-    for (i = 0; i < econfig.line_count; i++)
-        totallen += econfig.rows[i].size + 1;
-    *buflen = totallen;
+    static const char nl = '\n';
+    struct iovec iov[FILE_IOV_MAX];
+    char *stage = malloc(FILE_STAGE_SIZE);
+    size_t staged = 0;
+    int n = 0;
+    bool ok = true;
 
-    // Copy all the strings of the editor to one big string; The resulting
-    // string address will be printed on the screen
-    char *buf = malloc(totallen);
-    char *tmp = buf;
-    for (i = 0; i < econfig.line_count; i++) {
-        memcpy(tmp, econfig.rows[i].chars, econfig.rows[i].size);
-        tmp += econfig.rows[i].size;
-        *tmp = '\n';
-        tmp++;
+    for (linenr_T l = 0; ok && l < econfig.line_count; l++) {
+        const editor_row_T *row = &econfig.rows[l];
+        size_t len = rbuf_len(row);
+        if (n + 3 > FILE_IOV_MAX
+            || (row->cold && staged + len > FILE_STAGE_SIZE))
+        {
+            ok = file_writev_all(fd, iov, n);
+            n = 0;
+            staged = 0;
+            if (!ok) break;
+        }
+
+        if (!row->cold) {
+            iov[n++] = (struct iovec){ row->chars, row->front };
+            iov[n++] = (struct iovec){ row->chars + row->front + row->gap,
+                                       len - row->front };
+        }
+        else if (len <= FILE_STAGE_SIZE) {
+            size_t size;
+            memcpy(stage + staged, cold_text(row, &size), len);
+            iov[n++] = (struct iovec){ stage + staged, len };
+            staged += len;
+        }
+        else {
+            // A row bigger than the stage is written by itself
+            size_t size;
+            iov[n++] = (struct iovec){ (char *)cold_text(row, &size), len };
+            ok = file_writev_all(fd, iov, n);
+            n = 0;
+        }
+        iov[n++] = (struct iovec){ (char *)&nl, 1 };
     }
+    if (ok && n) ok = file_writev_all(fd, iov, n);
 
-    // Return the initial address of the buffer; remember to free after use
-    return buf;
+    free(stage);
+    return ok;
 }
 
 void
-file_open(char *filename)
+file_reader_init(row_reader_T *rr)
 {
-    // Free filename from config when opening new file
-    free(econfig.filename);
-    econfig.filename = strdup(filename);
+    rr->rows = NULL;
+    rr->count = rr->cap = 0;
+    rr->partial = false;
+}
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) die("fopen");
+// Complete the line being read
+static void
+file_reader_end_line(row_reader_T *rr)
+{
+    if (!rr->partial) {
+        rbuf_init(&rr->line);
+        rr->line.render = NULL;
+    }
 
-    char *line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
+    // Drop the '\r' of a "\r\n" line break
+    size_t len = rbuf_len(&rr->line);
+    if (len && rbuf_char_at(&rr->line, len - 1) == '\r') {
+        rbuf_move(&rr->line, (ptrdiff_t)(len - 1) - (ptrdiff_t)rr->line.front);
+        rbuf_delete_n(&rr->line, 1);
+    }
+    row_update(&rr->line);
 
-    // Copy the text from the file to the editor rows by creating one row per
-    // line; Lines are separated by '\n' to each other.
-    while ((linelen = getline(&line, &linecap, (FILE *)fp)) != -1) {
-        while (linelen > 0
-               && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
-            linelen--;
-        row_new(econfig.line_count, line);
+    if (rr->count == rr->cap) {
+        rr->cap = rr->cap ? rr->cap * 2 : 64;
+        rr->rows = realloc(rr->rows, sizeof(editor_row_T) * rr->cap);
     }
+    rr->rows[rr->count++] = rr->line;
+    rr->partial = false;
+}
 
-    free(line);
-    fclose(fp);
-    econfig.dirty = 0; // No changes are made
+void
+file_reader_feed(row_reader_T *rr, const char *buf, size_t len)
+{
+    const char *end = buf + len;
+    while (buf < end) {
+        const char *nl = memchr(buf, '\n', end - buf);
+        const char *stop = nl ? nl : end;
+
+        // Add the text up to the line break to the line being read
+        if (stop > buf) {
+            if (!rr->partial) {
+                rbuf_init(&rr->line);
+                rr->line.render = NULL;
+                rr->partial = true;
+            }
+            rbuf_insertn(&rr->line, buf, stop - buf);
+        }
+
+        if (nl == NULL) break;
+        file_reader_end_line(rr);
+        buf = nl + 1;
+    }
+}
+
+linenr_T
+file_reader_insert(row_reader_T *rr, linenr_T at)
+{
+    if (rr->partial) file_reader_end_line(rr);
+
+    linenr_T n = rr->count;
+    if (n) {
+        editor_row_T *rows = row_open_range(at, n);
+        memcpy(rows, rr->rows, sizeof(editor_row_T) * n);
+    }
+
+    free(rr->rows);
+    file_reader_init(rr);
+    return n;
+}
+
+// Build a row from the text of a line
+static void
+file_build_row(editor_row_T *row, const char *s, size_t len)
+{
+    // Drop the '\r' of a "\r\n" line break
+    if (len && s[len - 1] == '\r') len--;
+
+    rbuf_init(row);
+    row->render = NULL;
+    if (len) rbuf_insertn(row, s, len);
+    row_update(row);
+}
+
+static void *
+file_thread_build(void *arg)
+{
+    filejob_T *job = arg;
+    for (linenr_T i = job->lo; i < job->hi; i++) {
+        uint64_t start = lineidx_offset(job->idx, i);
+        uint64_t end = lineidx_offset(job->idx, i + 1) - 1; // at the '\n'
+        file_build_row(&job->rows[i - job->first], job->data + start,
+                       end - start);
+    }
+    return NULL;
+}
+
+// Build the rows of the indexed lines [lo, hi); slices of them on every
+// processor
+static void
+file_build_rows(editor_row_T *rows,
+                const char *data,
+                const lineidx_T *idx,
+                linenr_T lo,
+                linenr_T hi)
+{
+    linenr_T count = hi - lo;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    linenr_T nthreads = ncpu > 0 ? (linenr_T)ncpu : 1;
+    if (nthreads > FILE_THREADS_MAX) nthreads = FILE_THREADS_MAX;
+    if (nthreads > count / FILE_LINES_PER_THREAD)
+        nthreads = count / FILE_LINES_PER_THREAD
+                       ? count / FILE_LINES_PER_THREAD
+                       : 1;
+
+    filejob_T jobs[FILE_THREADS_MAX];
+    pthread_t threads[FILE_THREADS_MAX];
+    bool started[FILE_THREADS_MAX];
+    for (linenr_T i = 0; i < nthreads; i++) {
+        jobs[i].data = data;
+        jobs[i].idx = idx;
+        jobs[i].rows = rows;
+        jobs[i].first = lo;
+        jobs[i].lo = lo + count * i / nthreads;
+        jobs[i].hi = lo + count * (i + 1) / nthreads;
+    }
+
+    // The calling thread builds the last slice; slices of threads that could
+    // not be created are built after it
+    for (linenr_T i = 0; i + 1 < nthreads; i++)
+        started[i] = pthread_create(&threads[i], NULL, file_thread_build,
+                                    &jobs[i])
+                     == 0;
+    file_thread_build(&jobs[nthreads - 1]);
+    for (linenr_T i = 0; i + 1 < nthreads; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            file_thread_build(&jobs[i]);
+    }
+}
+
+// Read a regular file through a mapping; its line offsets come from the
+// cache when it has them. Returns -1 if the file cannot be mapped.
+static long
+file_read_mapped(int fd, const char *filename, linenr_T at)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return -1;
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return -1;
+
+    // Only the lines after the cached ones are searched for
+    lineidx_T idx;
+    lineidx_load(&idx, filename, &st, data);
+    lineidx_scan(&idx, data, st.st_size);
+    lineidx_save(&idx, filename, &st, data);
+
+    // Text after the last line break is a line of its own
+    size_t covered = lineidx_offset(&idx, idx.count);
+    linenr_T n = idx.count + (covered < (size_t)st.st_size);
+    if (n) {
+        editor_row_T *rows = row_open_range(at, n);
+        if (idx.count) file_build_rows(rows, data, &idx, 0, idx.count);
+        if (n > idx.count)
+            file_build_row(&rows[idx.count], data + covered,
+                           st.st_size - covered);
+    }
+
+    lineidx_free(&idx);
+    munmap(data, st.st_size);
+    return n;
+}
+
+long
+file_read(const char *filename, linenr_T at)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        statusbar_set_message("Can't open file %s", filename);
+        return -1;
+    }
+
+    long n = file_read_mapped(fd, filename, at);
+    if (n >= 0) {
+        close(fd);
+        return n;
+    }
+
+    // Pipes and devices are read in chunks
+    row_reader_T rr;
+    file_reader_init(&rr);
+
+    char buf[65536];
+    ssize_t nread;
+    while ((nread = read(fd, buf, sizeof(buf))) != 0) {
+        if (nread == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        file_reader_feed(&rr, buf, nread);
+    }
+    close(fd);
+
+    return file_reader_insert(&rr, at);
+}
+
+// Hand rows built by the background reader to the editor
+static void
+file_load_push(fileload_T *lp, loadbatch_T *batch)
+{
+    batch->next = NULL;
+    pthread_mutex_lock(&lp->lock);
+    *lp->tail = batch;
+    lp->tail = &batch->next;
+    pthread_mutex_unlock(&lp->lock);
+}
+
+static bool
+file_load_cancelled(fileload_T *lp)
+{
+    pthread_mutex_lock(&lp->lock);
+    bool cancel = lp->cancel;
+    pthread_mutex_unlock(&lp->lock);
+    return cancel;
+}
+
+// Index the rest of the file and build its rows a batch at a time
+static void *
+file_load_thread(void *arg)
+{
+    fileload_T *lp = arg;
+    size_t size = lp->st.st_size;
+
+    lineidx_T idx;
+    lineidx_load(&idx, lp->filename, &lp->st, lp->data);
+    lineidx_scan(&idx, lp->data, size);
+    lineidx_save(&idx, lp->filename, &lp->st, lp->data);
+
+    for (linenr_T lo = lp->first; lo < idx.count && !file_load_cancelled(lp);
+         lo += FILE_LOAD_BATCH_LINES)
+    {
+        linenr_T hi = lo + FILE_LOAD_BATCH_LINES;
+        if (hi > idx.count) hi = idx.count;
+        loadbatch_T *batch = malloc(sizeof(loadbatch_T));
+        batch->rows = malloc(sizeof(editor_row_T) * (hi - lo));
+        batch->count = hi - lo;
+        batch->end = lineidx_offset(&idx, hi);
+        file_build_rows(batch->rows, lp->data, &idx, lo, hi);
+        file_load_push(lp, batch);
+    }
+
+    // Text after the last line break is a line of its own
+    size_t covered = lineidx_offset(&idx, idx.count);
+    if (covered < size && !file_load_cancelled(lp)) {
+        loadbatch_T *batch = malloc(sizeof(loadbatch_T));
+        batch->rows = malloc(sizeof(editor_row_T));
+        batch->count = 1;
+        batch->end = size;
+        file_build_row(&batch->rows[0], lp->data + covered, size - covered);
+        file_load_push(lp, batch);
+    }
+    lineidx_free(&idx);
+
+    pthread_mutex_lock(&lp->lock);
+    lp->done = true;
+    pthread_mutex_unlock(&lp->lock);
+    return NULL;
+}
+
+// Move the rows built so far to the end of the buffer. Lines added here are
+// text of the file, not changes to it; the buffer is not marked modified and
+// nothing is journaled. Returns true once the whole file was added.
+static bool
+file_load_splice(fileload_T *lp)
+{
+    // Every batch is queued before the reader is done
+    pthread_mutex_lock(&lp->lock);
+    loadbatch_T *batch = lp->head;
+    lp->head = NULL;
+    lp->tail = &lp->head;
+    bool done = lp->done;
+    pthread_mutex_unlock(&lp->lock);
+
+    while (batch) {
+        linenr_T at = econfig.line_count;
+        econfig.rows =
+            realloc(econfig.rows, sizeof(editor_row_T) * (at + batch->count));
+        memcpy(&econfig.rows[at], batch->rows,
+               sizeof(editor_row_T) * batch->count);
+        econfig.line_count += batch->count;
+        win_changed_lines(at, at, batch->count);
+        lp->read = batch->end;
+
+        loadbatch_T *next = batch->next;
+        free(batch->rows);
+        free(batch);
+        batch = next;
+    }
+    return done;
+}
+
+// Release a reader whose thread has ended; rows not added are dropped
+static void
+file_load_free(fileload_T *lp)
+{
+    while (lp->head) {
+        loadbatch_T *batch = lp->head;
+        lp->head = batch->next;
+        for (linenr_T i = 0; i < batch->count; i++)
+            row_free(&batch->rows[i]);
+        free(batch->rows);
+        free(batch);
+    }
+    munmap(lp->data, lp->st.st_size);
+    pthread_mutex_destroy(&lp->lock);
+    free(lp->filename);
+    free(lp);
+}
+
+// Read the first lines of a big regular file now and the rest of it in the
+// background. Returns the number of lines read or -1 if the file is to be
+// read at once.
+static long
+file_load_start(const char *filename, linenr_T at)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+    struct stat st;
+    char *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && st.st_size >= FILE_LOAD_ASYNC_MIN)
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    // A file of few long lines gains nothing from it
+    const char *end = data + st.st_size, *nl = data - 1;
+    linenr_T n = 0;
+    while (n < FILE_LOAD_FIRST_LINES
+           && (nl = memchr(nl + 1, '\n', end - nl - 1)) != NULL)
+        n++;
+    if (n < FILE_LOAD_FIRST_LINES) {
+        munmap(data, st.st_size);
+        return -1;
+    }
+
+    editor_row_T *rows = row_open_range(at, n);
+    const char *p = data;
+    for (linenr_T i = 0; i < n; i++) {
+        nl = memchr(p, '\n', end - p);
+        file_build_row(&rows[i], p, nl - p);
+        p = nl + 1;
+    }
+
+    fileload_T *lp = calloc(1, sizeof(fileload_T));
+    lp->filename = strdup(filename);
+    lp->st = st;
+    lp->data = data;
+    lp->first = n;
+    lp->read = p - data;
+    lp->tail = &lp->head;
+    pthread_mutex_init(&lp->lock, NULL);
+
+    // Without a thread the rest is read at once
+    if (pthread_create(&lp->thread, NULL, file_load_thread, lp) != 0) {
+        file_load_thread(lp);
+        file_load_splice(lp);
+        file_load_free(lp);
+        return econfig.line_count - at;
+    }
+    file_loader = lp;
+    return n;
+}
+
+bool
+file_loading()
+{
+    return file_loader != NULL;
+}
+
+void
+file_load_idle()
+{
+    fileload_T *lp = file_loader;
+    if (lp == NULL) return;
+
+    linenr_T old_count = econfig.line_count;
+    if (file_load_splice(lp)) {
+        pthread_join(lp->thread, NULL);
+        statusbar_set_message("\"%s\" %lu lines", lp->filename,
+                              econfig.line_count);
+        file_loader = NULL;
+        file_load_free(lp);
+    }
+    else if (econfig.line_count != old_count) {
+        statusbar_set_message("\"%s\" %lu lines so far (%d%%)", lp->filename,
+                              econfig.line_count,
+                              (int)(lp->read * 100 / lp->st.st_size));
+    }
+    else {
+        return;
+    }
+    screen_refresh();
 }
 
 void
+file_load_finish()
+{
+    fileload_T *lp = file_loader;
+    if (lp == NULL) return;
+
+    pthread_join(lp->thread, NULL);
+    file_load_splice(lp);
+    statusbar_set_message("\"%s\" %lu lines", lp->filename,
+                          econfig.line_count);
+    file_loader = NULL;
+    file_load_free(lp);
+}
+
+void
+file_load_stop()
+{
+    fileload_T *lp = file_loader;
+    if (lp == NULL) return;
+
+    pthread_mutex_lock(&lp->lock);
+    lp->cancel = true;
+    pthread_mutex_unlock(&lp->lock);
+    pthread_join(lp->thread, NULL);
+    file_loader = NULL;
+    file_load_free(lp);
+}
+
+void
+file_open(const char *filename)
+{
+    // A file that does not exist yet is created when written
+    if (access(filename, F_OK) == -1 && errno == ENOENT) {
+        statusbar_set_message("\"%s\" [New File]", filename);
+        return;
+    }
+
+    // The rest of a big file is added while the editor is used
+    long n = file_load_start(filename, econfig.line_count);
+    if (n >= 0) {
+        econfig.dirty = 0;
+        statusbar_set_message("\"%s\" %ld lines so far", filename, n);
+        return;
+    }
+
+    n = file_read(filename, econfig.line_count);
+    econfig.dirty = 0; // No changes are made
+    if (n >= 0) statusbar_set_message("\"%s\" %ld lines", filename, n);
+}
+
+bool
 file_write()
 {
     if (econfig.filename == NULL) {
@@ -83,31 +635,40 @@ file_write()
             get_user_input_prompt("Save as: %s"); // Get name from user
         if (econfig.filename == NULL) {
             statusbar_set_message("Save aborted");
-            return;
+            return false;
         }
     }
 
-    int len;
-    char *buf = editor_rows_to_str(&len);
+    if (!file_write_to(econfig.filename)) return false;
+    econfig.dirty = 0;
+    lineidx_forget(econfig.filename);
+    swap_checkpoint();
+    return true;
+}
+
+bool
+file_write_to(const char *filename)
+{
+    // The whole file is written
+    file_load_finish();
+
+    size_t len = 0;
+    for (linenr_T i = 0; i < econfig.line_count; i++)
+        len += rbuf_len(&econfig.rows[i]) + 1;
 
-    int fd = open(econfig.filename, O_RDWR | O_CREAT, 0644);
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
     // Error handling
     if (fd != -1) {
-        if (ftruncate(fd, len) != -1) {
-            if (write(fd, buf, len) == len) { // write the file
-                close(fd);
-                // Free buffer
-                free(buf);
-                econfig.dirty = 0;
-                statusbar_set_message("%d bytes written to disk", len);
-                return;
-            }
+        // The rows are written as they are; no copy of the file is made
+        if (ftruncate(fd, len) != -1 && file_write_rows(fd)) {
+            close(fd);
+            statusbar_set_message("%lu bytes written to disk", len);
+            return true;
         }
         close(fd);
     }
 
-    // Free buffer
-    free(buf);
     statusbar_set_message("File cannot be saved. I/O error: %s",
                           strerror(errno));
+    return false;
 }
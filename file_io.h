@@ -7,6 +7,25 @@
 #ifndef FILE_IO_H
 #define FILE_IO_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+/* @brief Rows built from text read in chunks */
+typedef struct row_reader {
+    /* completed rows */
+    editor_row_T *rows;
+    /* number of completed rows */
+    linenr_T count;
+    /* allocated number of rows */
+    linenr_T cap;
+    /* line being read; its text continues in the next chunk */
+    editor_row_T line;
+    /* true if text of the line being read was seen */
+    bool partial;
+} row_reader_T;
+
 /**
  * @brief Converts text from rows array to one big string
  *
@@ -15,13 +34,96 @@
 char *file_convert_rows_to_str(int *buflen);
 
 /**
- * @brief Opens file and extracts text to be drawn to editor
+ * @brief Initialize a row reader
+ *
+ * @param rr Pointer to row reader
+ */
+void file_reader_init(row_reader_T *rr);
+
+/**
+ * @brief Split a chunk of text into rows
+ *
+ * Lines may span chunks. A '\r' before a line break is dropped.
  *
- * @param filename Pointer to the (FILE *) variable that was passed
+ * @param rr Pointer to row reader
+ * @param buf Text
+ * @param len Length of text
  */
-void file_open(char *filename);
+void file_reader_feed(row_reader_T *rr, const char *buf, size_t len);
 
-/* @brief Saves the currently rendered text in the editor to a file */
-void file_write();
+/**
+ * @brief Insert the rows read into the editor with a single move of rows
+ *
+ * A last line without a line break becomes a row too. The reader is emptied.
+ *
+ * @param rr Pointer to row reader
+ * @param at Index of the first inserted row
+ * @return Number of rows inserted
+ */
+linenr_T file_reader_insert(row_reader_T *rr, linenr_T at);
+
+/**
+ * @brief Read a file into new rows
+ *
+ * @param filename Name of the file to read
+ * @param at Index of the first inserted row
+ * @return Number of rows inserted or -1 if the file cannot be read
+ */
+long file_read(const char *filename, linenr_T at);
+
+/**
+ * @brief Read a file into the rows of the editor
+ *
+ * A file that does not exist leaves the editor as it is; it is created when
+ * written. The editor is marked as not modified. Only the first lines of a
+ * big file are read now; the rest is read in the background and added to
+ * the end of the buffer while no key is typed.
+ *
+ * @param filename Name of the file to read
+ */
+void file_open(const char *filename);
+
+/**
+ * @brief Check if the file of the current buffer is still being read
+ */
+bool file_loading();
+
+/**
+ * @brief Add the lines of the file read in the background since the last call
+ *
+ * Called while no key is typed. The status bar shows how much was read.
+ */
+void file_load_idle();
+
+/**
+ * @brief Wait for the rest of the file of the current buffer and add it
+ *
+ * Does nothing if the whole file was read.
+ */
+void file_load_finish();
+
+/**
+ * @brief Stop reading the file of the current buffer; its rows are dropped
+ */
+void file_load_stop();
+
+/**
+ * @brief Saves the currently rendered text in the editor to a file
+ *
+ * Prompts for a file name if the editor has none.
+ *
+ * @return False if the file was not written
+ */
+bool file_write();
+
+/**
+ * @brief Write the text in the editor to a file
+ *
+ * The modified flag is left alone; the file may not be the edited one.
+ *
+ * @param filename Name of the file to write
+ * @return False if the file cannot be written
+ */
+bool file_write_to(const char *filename);
 
 #endif /* FILE_IO_H */
@@ -0,0 +1,638 @@
+/**
+ * @file fold.c
+ * @author re-nanashi
+ * @brief Folds of a window; the closed ones are kept as a sorted list of
+ * spans with the count of lines hidden before each, so a line and its place
+ * among the shown lines are mapped by a binary search
+ */
+
+#include "fold.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "buflist.h"
+#include "cold.h"
+#include "edit.h"
+#include "input.h"
+#include "screen.h"
+#include "win.h"
+
+/* @brief Lines of a buffer a window may show as one line */
+typedef struct fold {
+    /* first and last line */
+    linenr_T top;
+    linenr_T bot;
+    /* true if the lines are shown as one line */
+    bool closed;
+} fold_T;
+
+/* @brief Closed fold not held by another closed fold */
+typedef struct foldspan {
+    /* first and last line */
+    linenr_T top;
+    linenr_T bot;
+    /* number of folds holding the first line; the span included */
+    int level;
+    /* lines hidden by the spans before this one */
+    linenr_T hidden;
+} foldspan_T;
+
+/* @brief Folds of a window */
+typedef struct foldset {
+    /* index of the buffer the folds were made for */
+    int buf;
+    /* folds sorted by first line; a fold comes before the folds it holds */
+    fold_T *folds;
+    size_t count;
+    size_t cap;
+    /* closed folds as shown; sorted, apart from each other */
+    foldspan_T *spans;
+    size_t nspans;
+} foldset_T;
+
+// Folds of the buffer a window shows; NULL if there are none
+static foldset_T *
+fold_get(const win_T *wp)
+{
+    // The current window may not know yet that its buffer changed
+    int buf = wp == win_current() ? buflist_current() : wp->buf;
+    foldset_T *fs = wp->folds;
+    return fs && fs->buf == buf && fs->count ? fs : NULL;
+}
+
+// Folds of the current window; emptied if they were made for another buffer
+static foldset_T *
+fold_cur()
+{
+    win_T *wp = win_current();
+    if (wp->folds == NULL) wp->folds = calloc(1, sizeof(foldset_T));
+    foldset_T *fs = wp->folds;
+    if (fs->buf != buflist_current()) {
+        fs->buf = buflist_current();
+        fs->count = fs->nspans = 0;
+    }
+    return fs;
+}
+
+// Order of folds; by first line, then the longer fold first
+static int
+fold_cmp(const void *a, const void *b)
+{
+    const fold_T *fa = a, *fb = b;
+    if (fa->top != fb->top) return fa->top < fb->top ? -1 : 1;
+    if (fa->bot != fb->bot) return fa->bot > fb->bot ? -1 : 1;
+    return 0;
+}
+
+// Rebuild the spans after the folds changed; the folds are walked once with
+// a stack of the last lines of the folds holding the current one
+static void
+fold_update_spans(foldset_T *fs)
+{
+    fs->spans = realloc(fs->spans, sizeof(foldspan_T) * (fs->count + 1));
+    fs->nspans = 0;
+
+    linenr_T *stack = malloc(sizeof(linenr_T) * (fs->count + 1));
+    int depth = 0;
+    linenr_T hidden = 0;
+    for (size_t i = 0; i < fs->count; i++) {
+        const fold_T *fp = &fs->folds[i];
+        while (depth && stack[depth - 1] < fp->top)
+            depth--;
+        stack[depth++] = fp->bot;
+        if (!fp->closed) continue;
+
+        // Folds in a closed fold are hidden with it
+        foldspan_T *last = fs->nspans ? &fs->spans[fs->nspans - 1] : NULL;
+        if (last && fp->top <= last->bot) continue;
+        if (last) hidden += last->bot - last->top;
+
+        foldspan_T *sp = &fs->spans[fs->nspans++];
+        sp->top = fp->top;
+        sp->bot = fp->bot;
+        sp->level = depth;
+        sp->hidden = hidden;
+    }
+    free(stack);
+}
+
+// The folds of the current window changed; it draws its lines again
+static void
+fold_changed(foldset_T *fs)
+{
+    fold_update_spans(fs);
+    win_current()->cache_valid = false;
+}
+
+// Index of the last span starting at or before a line; -1 if none
+static long
+fold_find_span(const foldset_T *fs, linenr_T lnum)
+{
+    size_t lo = 0, hi = fs->nspans;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (fs->spans[mid].top <= lnum)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (long)lo - 1;
+}
+
+// Index of a line among the shown lines; a closed fold is one line
+static linenr_T
+fold_to_shown(const foldset_T *fs, linenr_T lnum)
+{
+    long i = fold_find_span(fs, lnum);
+    if (i < 0) return lnum;
+
+    const foldspan_T *sp = &fs->spans[i];
+    if (lnum <= sp->bot) return sp->top - sp->hidden;
+    return lnum - sp->hidden - (sp->bot - sp->top);
+}
+
+// Line shown at an index among the shown lines
+static linenr_T
+fold_from_shown(const foldset_T *fs, linenr_T shown)
+{
+    // Last span whose line is shown at or before the index
+    size_t lo = 0, hi = fs->nspans;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (fs->spans[mid].top - fs->spans[mid].hidden <= shown)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0) return shown;
+
+    const foldspan_T *sp = &fs->spans[lo - 1];
+    if (sp->top - sp->hidden == shown) return sp->top;
+    return shown + sp->hidden + (sp->bot - sp->top);
+}
+
+int
+fold_closed(const win_T *wp, linenr_T lnum, linenr_T *top, linenr_T *bot)
+{
+    const foldset_T *fs = fold_get(wp);
+    if (fs == NULL) return 0;
+
+    long i = fold_find_span(fs, lnum);
+    if (i < 0 || fs->spans[i].bot < lnum) return 0;
+    if (top) *top = fs->spans[i].top;
+    if (bot) *bot = fs->spans[i].bot;
+    return fs->spans[i].level;
+}
+
+linenr_T
+fold_move(const win_T *wp, linenr_T lnum, long count)
+{
+    if (econfig.line_count == 0) return 0;
+
+    const foldset_T *fs = fold_get(wp);
+    linenr_T last = econfig.line_count - 1;
+    linenr_T shown = lnum > last ? last : lnum;
+    if (fs) {
+        last = fold_to_shown(fs, last);
+        shown = fold_to_shown(fs, shown);
+    }
+
+    if (count < 0)
+        shown = (linenr_T)-count < shown ? shown + count : 0;
+    else
+        shown = (linenr_T)count < last - shown ? shown + count : last;
+    return fs ? fold_from_shown(fs, shown) : shown;
+}
+
+linenr_T
+fold_count_shown(const win_T *wp, linenr_T lnum, linenr_T lnume)
+{
+    if (lnume <= lnum) return 0;
+    const foldset_T *fs = fold_get(wp);
+    if (fs == NULL) return lnume - lnum;
+    return fold_to_shown(fs, lnume) - fold_to_shown(fs, lnum);
+}
+
+void
+fold_extend_range(linenr_T *top, linenr_T *bot)
+{
+    win_T *wp = win_current();
+    fold_closed(wp, *top, top, NULL);
+    fold_closed(wp, *bot, NULL, bot);
+}
+
+void
+fold_adjust_cursor()
+{
+    linenr_T top;
+    if (fold_closed(win_current(), econfig.cy, &top, NULL)
+        && top != econfig.cy)
+    {
+        econfig.cy = top;
+        input_clamp_cursor();
+    }
+}
+
+// Number of folds holding a line; their indexes are put in idx from the
+// outermost one
+static size_t
+fold_holding(const foldset_T *fs, linenr_T lnum, size_t *idx)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < fs->count && fs->folds[i].top <= lnum; i++)
+        if (fs->folds[i].bot >= lnum) idx[n++] = i;
+    return n;
+}
+
+// Open or close every fold holding the cursor line; false if there is none
+static bool
+fold_set_cursor(bool closed)
+{
+    foldset_T *fs = fold_cur();
+    size_t *idx = malloc(sizeof(size_t) * (fs->count + 1));
+    size_t n = fold_holding(fs, econfig.cy, idx);
+    for (size_t k = 0; k < n; k++)
+        fs->folds[idx[k]].closed = closed;
+    free(idx);
+    if (n) fold_changed(fs);
+    return n > 0;
+}
+
+void
+fold_open_cursor()
+{
+    if (fold_closed(win_current(), econfig.cy, NULL, NULL))
+        fold_set_cursor(false);
+}
+
+// Open the outermost closed fold holding the cursor line count times
+static bool
+fold_open_levels(long count)
+{
+    foldset_T *fs = fold_cur();
+    size_t *idx = malloc(sizeof(size_t) * (fs->count + 1));
+    size_t n = fold_holding(fs, econfig.cy, idx);
+    long opened = 0;
+    for (size_t k = 0; k < n && opened < count; k++) {
+        if (!fs->folds[idx[k]].closed) continue;
+        fs->folds[idx[k]].closed = false;
+        opened++;
+    }
+    free(idx);
+    if (n) fold_changed(fs);
+    return n > 0;
+}
+
+// Close the innermost open fold holding the cursor line that is not in a
+// closed fold; count times
+static bool
+fold_close_levels(long count)
+{
+    foldset_T *fs = fold_cur();
+    size_t *idx = malloc(sizeof(size_t) * (fs->count + 1));
+    size_t n = fold_holding(fs, econfig.cy, idx);
+    for (long c = 0; c < count; c++) {
+        size_t shown = 0;
+        while (shown < n && !fs->folds[idx[shown]].closed)
+            shown++;
+        if (shown == 0) break;
+        fs->folds[idx[shown - 1]].closed = true;
+    }
+    free(idx);
+    if (n) fold_changed(fs);
+    return n > 0;
+}
+
+// Remove the folds whose indexes are marked by a true in del
+static void
+fold_remove_marked(foldset_T *fs, const bool *del)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < fs->count; i++)
+        if (!del[i]) fs->folds[n++] = fs->folds[i];
+    fs->count = n;
+}
+
+// Delete the fold at the cursor line, the closed one shown if any; the folds
+// in it are deleted too if recursive
+static bool
+fold_delete_cursor(bool recursive)
+{
+    foldset_T *fs = fold_cur();
+    size_t *idx = malloc(sizeof(size_t) * (fs->count + 1));
+    size_t n = fold_holding(fs, econfig.cy, idx);
+    if (n == 0) {
+        free(idx);
+        return false;
+    }
+
+    size_t pick = n - 1;
+    for (size_t k = 0; k < n; k++) {
+        if (fs->folds[idx[k]].closed) {
+            pick = k;
+            break;
+        }
+    }
+    const fold_T gone = fs->folds[idx[pick]];
+    free(idx);
+
+    bool *del = calloc(fs->count, sizeof(bool));
+    for (size_t i = 0; i < fs->count; i++) {
+        const fold_T *fp = &fs->folds[i];
+        if (fp->top == gone.top && fp->bot == gone.bot)
+            del[i] = true;
+        else if (recursive && fp->top >= gone.top && fp->bot <= gone.bot)
+            del[i] = true;
+    }
+    fold_remove_marked(fs, del);
+    free(del);
+    fold_changed(fs);
+    return true;
+}
+
+// Move the cursor to the start of the next fold or the end of the previous
+// one count times
+static bool
+fold_jump(bool forward, long count)
+{
+    const foldset_T *fs = fold_get(win_current());
+    if (fs == NULL) return false;
+
+    linenr_T lnum = econfig.cy;
+    for (long c = 0; c < count; c++) {
+        bool found = false;
+        linenr_T best = 0;
+        for (size_t i = 0; i < fs->count; i++) {
+            linenr_T at = forward ? fs->folds[i].top : fs->folds[i].bot;
+            if (forward ? at <= lnum : at >= lnum) continue;
+            if (!found || (forward ? at < best : at > best)) best = at;
+            found = true;
+        }
+        if (!found) break;
+        lnum = best;
+    }
+    if (lnum == econfig.cy) return false;
+    econfig.cy = lnum;
+    input_clamp_cursor();
+    return true;
+}
+
+void
+fold_create(linenr_T top, linenr_T bot)
+{
+    if (econfig.line_count == 0) return;
+    if (top > bot) {
+        linenr_T tmp = top;
+        top = bot;
+        bot = tmp;
+    }
+    if (bot >= econfig.line_count) bot = econfig.line_count - 1;
+    foldset_T *fs = fold_cur();
+
+    // Grow the fold over the folds it partly overlaps until none is left
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (size_t i = 0; i < fs->count; i++) {
+            const fold_T *fp = &fs->folds[i];
+            if (fp->top < top && fp->bot >= top && fp->bot < bot) {
+                top = fp->top;
+                grown = true;
+            }
+            if (fp->top > top && fp->top <= bot && fp->bot > bot) {
+                bot = fp->bot;
+                grown = true;
+            }
+        }
+    }
+
+    // A fold over the same lines is closed again
+    for (size_t i = 0; i < fs->count; i++) {
+        if (fs->folds[i].top == top && fs->folds[i].bot == bot) {
+            fs->folds[i].closed = true;
+            fold_changed(fs);
+            return;
+        }
+    }
+
+    if (fs->count == fs->cap) {
+        fs->cap = fs->cap ? fs->cap * 2 : 16;
+        fs->folds = realloc(fs->folds, sizeof(fold_T) * fs->cap);
+    }
+    fold_T fold = { top, bot, true };
+    size_t at = 0;
+    while (at < fs->count && fold_cmp(&fs->folds[at], &fold) < 0)
+        at++;
+    memmove(&fs->folds[at + 1], &fs->folds[at],
+            sizeof(fold_T) * (fs->count - at));
+    fs->folds[at] = fold;
+    fs->count++;
+    fold_changed(fs);
+}
+
+// Indent level of a row; -1 if it is blank. Packed rows are read without
+// unpacking them.
+static int
+fold_indent_level(const editor_row_T *row)
+{
+    size_t len;
+    const char *text = row->cold ? cold_text(row, &len) : NULL;
+    if (text == NULL) len = rbuf_len(row);
+
+    colnr_T col = 0;
+    for (size_t i = 0; i < len; i++) {
+        int c = text ? text[i] : rbuf_char_at(row, i);
+        if (c == '\t')
+            col += ZEX_TAB_STOP - col % ZEX_TAB_STOP;
+        else if (c == ' ')
+            col++;
+        else
+            return col / ZEX_TAB_STOP;
+    }
+    return -1;
+}
+
+long
+fold_indent(linenr_T top, linenr_T bot)
+{
+    if (econfig.line_count == 0) return 0;
+    if (bot >= econfig.line_count) bot = econfig.line_count - 1;
+    foldset_T *fs = fold_cur();
+
+    // Folds in the range or partly over it make way for the new ones
+    bool *del = calloc(fs->count + 1, sizeof(bool));
+    for (size_t i = 0; i < fs->count; i++) {
+        const fold_T *fp = &fs->folds[i];
+        if (fp->bot >= top && fp->top <= bot
+            && !(fp->top <= top && fp->bot >= bot))
+            del[i] = true;
+    }
+    fold_remove_marked(fs, del);
+    free(del);
+
+    // A blank line takes the lower level of the lines around it
+    linenr_T n = bot - top + 1;
+    int *level = malloc(sizeof(int) * n);
+    int prev = 0;
+    for (linenr_T i = 0; i < n; i++) {
+        level[i] = fold_indent_level(&econfig.rows[top + i]);
+        if (level[i] >= 0) prev = level[i];
+        else level[i] = -1 - prev;
+    }
+    int next = 0;
+    for (linenr_T i = n; i-- > 0;) {
+        if (level[i] >= 0) {
+            next = level[i];
+            continue;
+        }
+        int above = -1 - level[i];
+        level[i] = above < next ? above : next;
+    }
+
+    // A run of lines at a level or deeper is a fold; the runs still open
+    // start at start[1..depth]
+    linenr_T *start = malloc(sizeof(linenr_T) * (n + 2));
+    int depth = 0;
+    long made = 0;
+    for (linenr_T i = 0; i <= n; i++) {
+        int lv = i < n ? level[i] : 0;
+        for (; depth > lv; depth--) {
+            if (fs->count == fs->cap) {
+                fs->cap = fs->cap ? fs->cap * 2 : 16;
+                fs->folds = realloc(fs->folds, sizeof(fold_T) * fs->cap);
+            }
+            fold_T fold = { top + start[depth], top + i - 1, true };
+            fs->folds[fs->count++] = fold;
+            made++;
+        }
+        for (; depth < lv; depth++)
+            start[depth + 1] = i;
+    }
+    free(start);
+    free(level);
+
+    qsort(fs->folds, fs->count, sizeof(fold_T), fold_cmp);
+    fold_changed(fs);
+    return made;
+}
+
+void
+fold_command(int key, long count)
+{
+    foldset_T *fs = fold_cur();
+    bool found = true;
+    switch (key) {
+        case 'F':
+            fold_create(econfig.cy, econfig.cy + count - 1);
+            break;
+
+        case 'o':
+            found = fold_open_levels(count);
+            break;
+        case 'O':
+        case 'v':
+            found = fold_set_cursor(false);
+            break;
+        case 'c':
+            found = fold_close_levels(count);
+            break;
+        case 'C':
+            found = fold_set_cursor(true);
+            break;
+        case 'a':
+            if (fold_closed(win_current(), econfig.cy, NULL, NULL))
+                found = fold_open_levels(count);
+            else
+                found = fold_close_levels(count);
+            break;
+        case 'A':
+            found = fold_set_cursor(
+                !fold_closed(win_current(), econfig.cy, NULL, NULL));
+            break;
+
+        case 'R':
+        case 'M':
+            for (size_t i = 0; i < fs->count; i++)
+                fs->folds[i].closed = key == 'M';
+            fold_changed(fs);
+            break;
+
+        case 'd':
+        case 'D':
+            found = fold_delete_cursor(key == 'D');
+            break;
+        case 'E':
+            fs->count = 0;
+            fold_changed(fs);
+            break;
+
+        case 'j':
+        case 'k':
+            fold_jump(key == 'j', count);
+            break;
+
+        default:
+            break;
+    }
+    if (!found) statusbar_set_message("No fold found");
+}
+
+void
+fold_changed_lines(foldset_T *fs, linenr_T lnum, linenr_T lnume, long xtra)
+{
+    if (fs == NULL || fs->buf != buflist_current() || fs->count == 0
+        || xtra == 0)
+        return;
+
+    // Lines after the changed ones move; removed lines take the first and
+    // last lines of the folds on them to the lines left around them
+    long end = (long)lnume + xtra;
+    bool *del = calloc(fs->count, sizeof(bool));
+    for (size_t i = 0; i < fs->count; i++) {
+        fold_T *fp = &fs->folds[i];
+        long top = fp->top, bot = fp->bot;
+        if (fp->top >= lnume)
+            top += xtra;
+        else if (fp->top >= lnum && xtra < 0 && top >= end)
+            top = end;
+        if (fp->bot >= lnume)
+            bot += xtra;
+        else if (fp->bot >= lnum && xtra < 0 && bot >= end)
+            bot = end - 1;
+
+        if (bot < top) {
+            del[i] = true;
+            continue;
+        }
+        fp->top = top;
+        fp->bot = bot;
+    }
+    fold_remove_marked(fs, del);
+    free(del);
+    fold_update_spans(fs);
+}
+
+foldset_T *
+fold_copy(const foldset_T *fs)
+{
+    if (fs == NULL) return NULL;
+
+    foldset_T *copy = calloc(1, sizeof(foldset_T));
+    copy->buf = fs->buf;
+    copy->count = copy->cap = fs->count;
+    copy->folds = malloc(sizeof(fold_T) * (fs->count + 1));
+    memcpy(copy->folds, fs->folds, sizeof(fold_T) * fs->count);
+    fold_update_spans(copy);
+    return copy;
+}
+
+void
+fold_free(foldset_T *fs)
+{
+    if (fs == NULL) return;
+    free(fs->folds);
+    free(fs->spans);
+    free(fs);
+}
@@ -0,0 +1,133 @@
+/**
+ * @file fold.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for folds; ranges of lines a
+ * window shows as a single line while they are closed
+ */
+
+#ifndef FOLD_H
+#define FOLD_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+struct window;
+struct foldset;
+
+/**
+ * @brief Create a closed fold in the current window
+ *
+ * A fold that only partly overlaps folds of the window is grown to hold
+ * them; folds are nested or apart.
+ *
+ * @param top Index of the first line; the lines may be given in any order
+ * @param bot Index of the last line
+ */
+void fold_create(linenr_T top, linenr_T bot);
+
+/**
+ * @brief Create closed folds from the indent of the lines in a range
+ *
+ * Every run of lines indented by more than a line before it becomes a fold,
+ * one level for each tab stop of indent. Blank lines belong to the runs
+ * around them.
+ *
+ * @param top Index of the first line
+ * @param bot Index of the last line
+ * @return Number of folds created
+ */
+long fold_indent(linenr_T top, linenr_T bot);
+
+/**
+ * @brief Execute a fold command typed after 'z'
+ *
+ * zF folds count lines. zo, zO, zc, zC, za, zA and zv open or close the
+ * folds holding the cursor line; zR and zM open or close every fold; zd, zD
+ * and zE delete folds; zj and zk move to the start of the next fold or the
+ * end of the previous one.
+ *
+ * @param key Key typed after 'z'
+ * @param count Count typed before 'z'; 1 if none
+ */
+void fold_command(int key, long count);
+
+/**
+ * @brief Find the closed fold holding a line of the buffer a window shows
+ *
+ * @param wp Pointer to window
+ * @param lnum Index of the line
+ * @param top Set to the first line of the outermost closed fold; may be NULL
+ * @param bot Set to the last line of the fold; may be NULL
+ * @return Nesting level of the fold; 0 if the line is not in a closed fold
+ */
+int fold_closed(const struct window *wp, linenr_T lnum, linenr_T *top,
+                linenr_T *bot);
+
+/**
+ * @brief Get a line of the current buffer some lines shown further down
+ *
+ * A closed fold counts as one line; its first line is returned for it. The
+ * cost does not depend on the number of lines folds hide.
+ *
+ * @param wp Pointer to window showing the current buffer
+ * @param lnum Index of the line to start from
+ * @param count Number of shown lines to move; negative to move up
+ * @return Index of the line; stays within the first and last line
+ */
+linenr_T fold_move(const struct window *wp, linenr_T lnum, long count);
+
+/**
+ * @brief Get the number of lines shown for a range of the current buffer
+ *
+ * @param wp Pointer to window showing the current buffer
+ * @param lnum Index of the first line
+ * @param lnume Index after the last line
+ */
+linenr_T fold_count_shown(const struct window *wp, linenr_T lnum,
+                          linenr_T lnume);
+
+/**
+ * @brief Include the closed folds at both ends of a range of lines
+ *
+ * @param top Index of the first line; moved to the start of its fold
+ * @param bot Index of the last line; moved to the end of its fold
+ */
+void fold_extend_range(linenr_T *top, linenr_T *bot);
+
+/* @brief Move the cursor to the first line of the closed fold holding it */
+void fold_adjust_cursor();
+
+/* @brief Open the closed folds holding the cursor line */
+void fold_open_cursor();
+
+/**
+ * @brief Move the folds of a window with the lines of the current buffer
+ *
+ * Lines added in a fold grow it; a fold whose lines are all removed is
+ * deleted.
+ *
+ * @param fs Folds of a window; NULL or folds of another buffer are ignored
+ * @param lnum First changed line
+ * @param lnume Line after the last changed line
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void fold_changed_lines(struct foldset *fs, linenr_T lnum, linenr_T lnume,
+                        long xtra);
+
+/**
+ * @brief Copy the folds of a window for a new one
+ *
+ * @param fs Folds of a window; may be NULL
+ * @return Copy; NULL if fs is NULL
+ */
+struct foldset *fold_copy(const struct foldset *fs);
+
+/**
+ * @brief Free the folds of a window
+ *
+ * @param fs Folds; NULL is ignored
+ */
+void fold_free(struct foldset *fs);
+
+#endif /* FOLD_H */
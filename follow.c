@@ -0,0 +1,386 @@
+/**
+ * @file follow.c
+ * @author re-nanashi
+ * @brief Following a growing file; appended text becomes rows as it comes
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "follow.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "edit.h"
+#include "file_io.h"
+#include "screen.h"
+#include "swap.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Text read per idle call; the rest is read by the next ones
+#define FOLLOW_READ_MAX (4 << 20)
+// Changes to the file that may have appended text or cut it
+#define FOLLOW_FILE_EVENTS \
+    (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
+// Changes to the directory that may give the name to a new file
+#define FOLLOW_DIR_EVENTS (IN_CREATE | IN_MOVED_TO)
+// Time text is waited for on a pipe per idle call unless a key is typed
+#define FOLLOW_PIPE_WAIT_MS 50
+
+/* @brief Follower of the file of a buffer */
+typedef struct follow {
+    /* name of the followed file; NULL for a pipe */
+    char *path;
+    /* file read; the old one until a new file takes its name */
+    int fd;
+    dev_t dev;
+    ino_t ino;
+    /* bytes of the file read so far */
+    off_t pos;
+    /* inotify instance watching the file and its directory */
+    int ifd;
+    int wd_file;
+    /* true if the last idle call left text unread */
+    bool behind;
+    /* rows read and the line being read past the last line break */
+    row_reader_T rr;
+    /* true if the last row shows the line being read */
+    bool tail_shown;
+    /* text the last row was given when it was shown */
+    char *tail;
+    size_t tail_len;
+    /* true if the text comes through a pipe; it ends when the pipe does */
+    bool pipe;
+} follow_T;
+
+// Watch the file that has the followed name now
+static void
+follow_watch_file(follow_T *fp)
+{
+    if (fp->wd_file != -1) inotify_rm_watch(fp->ifd, fp->wd_file);
+    fp->wd_file = inotify_add_watch(fp->ifd, fp->path, FOLLOW_FILE_EVENTS);
+}
+
+// Keep the text given to the last row showing the line being read
+static void
+follow_set_tail(follow_T *fp, char *text, size_t len)
+{
+    free(fp->tail);
+    fp->tail = text;
+    fp->tail_len = len;
+    fp->tail_shown = text != NULL;
+}
+
+// True if the last row still shows the line being read as it was given
+static bool
+follow_tail_kept(follow_T *fp)
+{
+    if (!fp->tail_shown || econfig.line_count == 0) return false;
+    editor_row_T *row = row_get(econfig.line_count - 1);
+    size_t len = rbuf_len(row);
+    if (len != fp->tail_len) return false;
+    char *text = malloc(len + 1);
+    rbuf_copy(row, 0, len, text);
+    bool same = memcmp(text, fp->tail, len) == 0;
+    free(text);
+    return same;
+}
+
+// Move the rows read to the end of the buffer; they replace the line shown
+// while it was being read unless it was edited since. Lines added here are
+// text of the file, not changes to it; the buffer is not marked modified and
+// nothing is journaled.
+static void
+follow_append(follow_T *fp)
+{
+    row_reader_T *rr = &fp->rr;
+    linenr_T old_count = econfig.line_count;
+    linenr_T at = old_count;
+    if (follow_tail_kept(fp)) row_free(&econfig.rows[--at]);
+
+    linenr_T n = rr->count + (rr->partial ? 1 : 0);
+    econfig.rows = realloc(econfig.rows, sizeof(editor_row_T) * (at + n));
+    memcpy(&econfig.rows[at], rr->rows, sizeof(editor_row_T) * rr->count);
+    rr->count = 0;
+
+    // The line being read is shown as it is so far
+    char *text = NULL;
+    size_t len = 0;
+    if (rr->partial) {
+        editor_row_T *row = &econfig.rows[at + n - 1];
+        len = rbuf_len(&rr->line);
+        text = malloc(len + 1);
+        rbuf_copy(&rr->line, 0, len, text);
+        rbuf_init(row);
+        row->render = NULL;
+        rbuf_insertn(row, text, len);
+        row_update(row);
+    }
+    follow_set_tail(fp, text, len);
+
+    econfig.line_count = at + n;
+    win_changed_lines(at, old_count, (long)econfig.line_count - old_count);
+}
+
+// Read the text appended to the file since the last read
+static bool
+follow_read(follow_T *fp)
+{
+    static char buf[65536];
+    size_t total = 0;
+    ssize_t n = 0;
+    while (total < FOLLOW_READ_MAX
+           && (n = pread(fp->fd, buf, sizeof(buf), fp->pos)) != 0)
+    {
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        file_reader_feed(&fp->rr, buf, n);
+        fp->pos += n;
+        total += n;
+    }
+    fp->behind = total >= FOLLOW_READ_MAX;
+    if (total) follow_append(fp);
+    return total > 0;
+}
+
+// Read the file again from its start; it was cut short or replaced. A
+// modified buffer is left alone and no longer follows the file.
+static void
+follow_reload(follow_T *fp, const char *why)
+{
+    if (econfig.dirty) {
+        statusbar_set_message("\"%s\" %s; buffer modified, not following",
+                              fp->path, why);
+        follow_stop(fp);
+        econfig.follow = NULL;
+        return;
+    }
+
+    linenr_T old_count = econfig.line_count;
+    for (linenr_T i = 0; i < old_count; i++)
+        row_free(&econfig.rows[i]);
+    econfig.line_count = 0;
+    win_changed_lines(0, old_count, -(long)old_count);
+
+    if (fp->rr.partial) rbuf_destroy(&fp->rr.line);
+    free(fp->rr.rows);
+    file_reader_init(&fp->rr);
+    follow_set_tail(fp, NULL, 0);
+    fp->pos = 0;
+    follow_read(fp);
+
+    // The buffer is the file again
+    econfig.dirty = 0;
+    swap_checkpoint();
+    econfig.cx = 0;
+    econfig.row_offset = 0;
+    if (econfig.cy >= econfig.line_count)
+        econfig.cy = econfig.line_count ? econfig.line_count - 1 : 0;
+    statusbar_set_message("\"%s\" %s; %lu lines", fp->path, why,
+                          econfig.line_count);
+}
+
+static long long
+follow_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Read the text that came through the pipe; more is waited for a moment
+// unless a key is typed. The pipe is closed when the writer is done.
+// behind is set if text was still coming when the time was up.
+static bool
+follow_read_pipe(follow_T *fp)
+{
+    static char buf[65536];
+    struct pollfd pfd[2] = { { fp->fd, POLLIN, 0 },
+                             { STDIN_FILENO, POLLIN, 0 } };
+    long long start = follow_now_ms();
+    size_t total = 0;
+    bool ended = false;
+    fp->behind = true;
+    while (total < FOLLOW_READ_MAX) {
+        int wait = FOLLOW_PIPE_WAIT_MS - (int)(follow_now_ms() - start);
+        if (wait < 0) break;
+        if (poll(pfd, 2, wait) <= 0 || (pfd[1].revents & POLLIN)) {
+            fp->behind = false;
+            break;
+        }
+
+        ssize_t n = read(fp->fd, buf, sizeof(buf));
+        if (n == -1 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) {
+            ended = true;
+            break;
+        }
+        file_reader_feed(&fp->rr, buf, n);
+        total += n;
+    }
+    if (total) follow_append(fp);
+
+    if (ended) {
+        follow_stop(fp);
+        econfig.follow = NULL;
+        statusbar_set_message("%lu lines read", econfig.line_count);
+    }
+    return total > 0 || ended;
+}
+
+// Look for text appended to the file and for the file being cut or replaced
+static bool
+follow_check_file(follow_T *fp)
+{
+    // Only the arrival of events matters; they are not looked at
+    char events[4096];
+    bool changed = fp->behind;
+    while (read(fp->ifd, events, sizeof(events)) > 0)
+        changed = true;
+    if (!changed) return false;
+
+    // Text written before the file was cut or replaced is read first
+    bool grew = follow_read(fp);
+    struct stat st;
+    if (fstat(fp->fd, &st) == 0 && st.st_size < fp->pos) {
+        follow_reload(fp, "truncated");
+        return true;
+    }
+    if (stat(fp->path, &st) == 0
+        && (st.st_dev != fp->dev || st.st_ino != fp->ino))
+    {
+        int fd = open(fp->path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            close(fp->fd);
+            fp->fd = fd;
+            fp->dev = st.st_dev;
+            fp->ino = st.st_ino;
+            follow_watch_file(fp);
+            follow_reload(fp, "rotated");
+            return true;
+        }
+    }
+    return grew;
+}
+
+bool
+follow_start()
+{
+    if (econfig.follow) return true;
+    if (econfig.filename == NULL) {
+        statusbar_set_message("No file name");
+        return false;
+    }
+    file_load_finish();
+
+    struct stat st;
+    int fd = open(econfig.filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        if (fd != -1) close(fd);
+        statusbar_set_message("Can't follow %s", econfig.filename);
+        return false;
+    }
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd == -1) {
+        close(fd);
+        statusbar_set_message("Can't follow %s: %s", econfig.filename,
+                              strerror(errno));
+        return false;
+    }
+
+    follow_T *fp = calloc(1, sizeof(follow_T));
+    fp->path = strdup(econfig.filename);
+    fp->fd = fd;
+    fp->dev = st.st_dev;
+    fp->ino = st.st_ino;
+    fp->pos = st.st_size;
+    fp->ifd = ifd;
+    fp->wd_file = -1;
+    follow_watch_file(fp);
+    char *dir = strdup(fp->path);
+    inotify_add_watch(ifd, dirname(dir), FOLLOW_DIR_EVENTS);
+    free(dir);
+    file_reader_init(&fp->rr);
+
+    // An incomplete last line goes on being read
+    char last;
+    if (econfig.line_count && st.st_size
+        && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n')
+    {
+        editor_row_T *row = row_get(econfig.line_count - 1);
+        size_t len = rbuf_len(row);
+        char *text = malloc(len + 1);
+        rbuf_copy(row, 0, len, text);
+        file_reader_feed(&fp->rr, text, len);
+        follow_set_tail(fp, text, len);
+    }
+
+    econfig.follow = fp;
+    econfig.cy = econfig.line_count ? econfig.line_count - 1 : 0;
+    econfig.cx = 0;
+    statusbar_set_message("Following \"%s\"", fp->path);
+    return true;
+}
+
+void
+follow_pipe(int fd)
+{
+    follow_T *fp = calloc(1, sizeof(follow_T));
+    fp->fd = fd;
+    fp->ifd = -1;
+    fp->wd_file = -1;
+    fp->pipe = true;
+    file_reader_init(&fp->rr);
+    econfig.follow = fp;
+    statusbar_set_message("Reading standard input");
+}
+
+void
+follow_stop(follow_T *fp)
+{
+    if (fp == NULL) return;
+    close(fp->fd);
+    if (fp->ifd != -1) close(fp->ifd);
+    if (fp->rr.partial) rbuf_destroy(&fp->rr.line);
+    free(fp->rr.rows);
+    free(fp->tail);
+    free(fp->path);
+    free(fp);
+}
+
+void
+follow_idle()
+{
+    follow_T *fp = econfig.follow;
+    if (fp == NULL) return;
+
+    // Text flowing through a pipe is read until it stops or a key is typed;
+    // the screen shows it as it comes
+    do {
+        bool at_end = econfig.cy + 1 >= econfig.line_count;
+        linenr_T old_count = econfig.line_count;
+        if (!(fp->pipe ? follow_read_pipe(fp) : follow_check_file(fp)))
+            return;
+
+        // A cursor on the last line follows the new lines
+        if (at_end && econfig.line_count > old_count) {
+            econfig.cy = econfig.line_count - 1;
+            econfig.cx = 0;
+        }
+        screen_refresh();
+    } while ((fp = econfig.follow) != NULL && fp->pipe && fp->behind);
+}
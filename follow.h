@@ -0,0 +1,50 @@
+/**
+ * @file follow.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for following a growing file
+ */
+
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/**
+ * @brief Follow the file of the current buffer like tail -f; econfig.follow
+ *
+ * Text appended to the file is added as rows while no key is typed. A file
+ * cut short or replaced by a new one with its name is read again from its
+ * start. The cursor moves to the last line.
+ *
+ * @return False if the file cannot be followed
+ */
+bool follow_start();
+
+/**
+ * @brief Read text coming through a pipe into the current buffer as it comes
+ *
+ * Sets econfig.follow; it is stopped when the writer closes the pipe. The
+ * buffer is not marked modified.
+ *
+ * @param fd Descriptor of the pipe; closed when it ends
+ */
+void follow_pipe(int fd);
+
+/**
+ * @brief Stop following a file
+ *
+ * @param fp Follower of a buffer; NULL is ignored
+ */
+void follow_stop(struct follow *fp);
+
+/**
+ * @brief Add the text appended to the followed file of the current buffer
+ *
+ * Called while no key is typed. Nothing is read until the file or its
+ * directory changes. A cursor on the last line stays on the last line.
+ */
+void follow_idle();
+
+#endif /* FOLLOW_H */
@@ -17,40 +17,200 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
+#include <poll.h>
 
 #include "screen.h"
 #include "logger.h"
 #include "config.h"
+#include "cold.h"
 #include "edit.h"
 #include "file_io.h"
+#include "fold.h"
+#include "follow.h"
 #include "normal.h"
+#include "register.h"
+#include "swap.h"
+#include "win.h"
 
 /* @brief Internal macros */
 #define ZEX_QUIT_TIMES 2
 
-int
-input_read_key()
+/* @brief Keys read before the terminal; filled when a register is executed */
+static char *typebuf;
+/* @brief Number of bytes in typebuf and index of the next one to read */
+static size_t typebuf_len, typebuf_off;
+/* @brief Allocated size of typebuf */
+static size_t typebuf_cap;
+/* @brief Bytes read from typebuf since the terminal was last checked */
+static size_t typebuf_since_check;
+
+/* @brief Register keys are recorded to; 0 when not recording */
+static int rec_regname;
+/* @brief Recorded keys as bytes read from the terminal */
+static char *recbuf;
+/* @brief Number of recorded bytes and allocated size of recbuf */
+static size_t rec_len, rec_cap;
+
+// Check the terminal for a key without waiting
+static int
+input_term_pending()
+{
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+// Append bytes to the end of the typeahead
+static void
+input_typebuf_append(const char *s, size_t len)
+{
+    if (typebuf_len + len > typebuf_cap) {
+        while (typebuf_len + len > typebuf_cap)
+            typebuf_cap = typebuf_cap ? typebuf_cap * 2 : 256;
+        typebuf = realloc(typebuf, typebuf_cap);
+    }
+    memcpy(typebuf + typebuf_len, s, len);
+    typebuf_len += len;
+}
+
+// Check for Ctrl-C typed while keys are being executed; it throws away the
+// rest of them. Other keys are kept to run after the executed ones.
+static void
+input_check_interrupt()
 {
-    int nread;
     char c;
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
+    while (input_term_pending() && read(STDIN_FILENO, &c, 1) == 1) {
+        if (c == CTRL_KEY('c')) {
+            typebuf_len = typebuf_off = 0;
+            statusbar_set_message("Interrupted");
+            return;
+        }
+        input_typebuf_append(&c, 1);
+    }
+}
+
+// Read a byte of input; the typeahead comes before the terminal. Without wait
+// a terminal read may time out and 0 is returned.
+static int
+input_getc(char *c, bool wait)
+{
+    // The commands before the key are done with the rows
+    swap_capture();
+
+    if (typebuf_off < typebuf_len) {
+        // Executing keys can loop; keep an eye on the terminal for Ctrl-C
+        if (++typebuf_since_check >= 4096) {
+            typebuf_since_check = 0;
+            input_check_interrupt();
+            if (typebuf_off == typebuf_len) return input_getc(c, wait);
+        }
+        *c = typebuf[typebuf_off++];
+        return 1;
+    }
+
+    int nread;
+    while ((nread = read(STDIN_FILENO, c, 1)) != 1) {
         if (nread == -1 && errno != EAGAIN) die("read");
+        if (!wait) return 0;
+        swap_idle();
+        file_load_idle();
+        cold_idle();
+        follow_idle();
+        screen_idle();
     }
 
+    // Only typed keys are recorded; not the ones being executed
+    if (rec_regname) {
+        if (rec_len == rec_cap) {
+            rec_cap = rec_cap ? rec_cap * 2 : 64;
+            recbuf = realloc(recbuf, rec_cap);
+        }
+        recbuf[rec_len++] = *c;
+    }
+    return 1;
+}
+
+void
+input_stuff(const char *s, size_t len)
+{
+    // Reuse the room before the unread keys when there is enough
+    if (typebuf_off >= len) {
+        typebuf_off -= len;
+        memcpy(typebuf + typebuf_off, s, len);
+        return;
+    }
+
+    size_t unread = typebuf_len - typebuf_off;
+    if (unread + len > typebuf_cap) {
+        while (unread + len > typebuf_cap)
+            typebuf_cap = typebuf_cap ? typebuf_cap * 2 : 256;
+        typebuf = realloc(typebuf, typebuf_cap);
+    }
+    memmove(typebuf + len, typebuf + typebuf_off, unread);
+    memcpy(typebuf, s, len);
+    typebuf_off = 0;
+    typebuf_len = unread + len;
+}
+
+int
+input_typeahead()
+{
+    return typebuf_off < typebuf_len;
+}
+
+void
+input_record_start(int regname)
+{
+    rec_regname = regname;
+    rec_len = 0;
+}
+
+void
+input_record_stop()
+{
+    // The key that stopped the recording is not part of it
+    if (rec_len) rec_len--;
+    reg_set_text(rec_regname, recbuf, rec_len);
+    rec_regname = 0;
+}
+
+int
+input_recording()
+{
+    return rec_regname;
+}
+
+int
+input_read_key()
+{
+    char c;
+    bool typed = !input_typeahead();
+    input_getc(&c, true);
+
     // Handle not so ordinary keys; handle keys that emits escape codes
     // Refer to VT100
     if (c == '\x1b') {
         char seq[3];
 
+        // An executed Escape is never followed by typed keys
+        if (!typed && !input_typeahead()) return '\x1b';
+
         // Immediately read two more bytes into seq buffer if both reads
-        // timeout; user just pressed Escape
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
+        // timeout; user just pressed Escape. A key that starts no sequence
+        // is read again as its own key.
+        if (!input_getc(&seq[0], false)) return '\x1b';
+        if (seq[0] != '[' && seq[0] != 'O') {
+            input_stuff(seq, 1);
+            return '\x1b';
+        }
+        if (!input_getc(&seq[1], false)) {
+            input_stuff(seq, 1);
+            return '\x1b';
+        }
 
         if (seq[0] == '[') {
             if (seq[1] >= '0' && seq[1] <= '9') {
                 // if there is no '~' in the sequence, return Escape
-                if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
+                if (!input_getc(&seq[2], false)) return '\x1b';
                 if (seq[2] == '~') {
                     switch (seq[1]) {
                         case '1':
@@ -88,13 +248,15 @@ input_read_key()
                 }
             }
         }
-        else if (seq[0] == '0') {
+        else if (seq[0] == 'O') {
             switch (seq[1]) {
                 case 'H':
                     return HOME_KEY;
                 case 'F':
                     return END_KEY;
             }
+            // Escape then "O" and another key
+            input_stuff(seq, 2);
         }
 
         return '\x1b';
@@ -105,6 +267,12 @@ input_read_key()
     }
 }
 
+int
+input_pending()
+{
+    return input_typeahead() || input_term_pending();
+}
+
 char *
 get_user_input_prompt(char *prompt)
 {
@@ -146,29 +314,66 @@ get_user_input_prompt(char *prompt)
 
 void
 input_move_cursor(int key)
+{
+    input_move_cursor_by(key, 1);
+}
+
+void
+input_move_cursor_by(int key, long count)
 {
     // Check if there is text in the current row
     editor_row_T *row =
         (econfig.cy >= econfig.line_count) ? NULL : &econfig.rows[econfig.cy];
 
+    // Compute the target position directly; the count is never turned into
+    // separate one step motions
     switch (key) {
         case ARROW_LEFT:
-            if (row && econfig.cx != 0) econfig.cx--;
+            if (row)
+                econfig.cx =
+                    (colnr_T)count < econfig.cx ? econfig.cx - count : 0;
             break;
-        case ARROW_RIGHT: {
-            colnr_T rsize = row->size - row->gap;
-            if (row && econfig.cx < rsize - 1) econfig.cx++;
-        } break;
+        case ARROW_RIGHT:
+            if (row) {
+                colnr_T rsize = row->size - row->gap;
+                if (rsize && econfig.cx + count >= rsize)
+                    econfig.cx = rsize - 1;
+                else if (rsize)
+                    econfig.cx += count;
+            }
+            break;
+        // Lines are counted as shown; a closed fold is one line
         case ARROW_UP:
-            if (row && econfig.cy < econfig.line_count && econfig.cy != 0)
-                econfig.cy--;
+            if (row) econfig.cy = fold_move(win_current(), econfig.cy, -count);
             break;
         case ARROW_DOWN:
-            if (row && econfig.cy < econfig.line_count - 1) econfig.cy++;
+            if (row) econfig.cy = fold_move(win_current(), econfig.cy, count);
             break;
+        case PAGE_UP:
+        case PAGE_DOWN: {
+            // Put the cursor at the edge of the screen then move it by count
+            // screens in one step
+            win_T *wp = win_current();
+            long page = econfig.screenrows * count;
+            if (key == PAGE_UP)
+                econfig.cy = fold_move(wp, econfig.row_offset, -page);
+            else if (econfig.line_count)
+                econfig.cy = fold_move(wp, econfig.row_offset,
+                                       econfig.screenrows - 1 + page);
+        } break;
     }
 
-    row = (econfig.cy >= econfig.line_count) ? NULL : &econfig.rows[econfig.cy];
+    input_clamp_cursor();
+}
+
+void
+input_clamp_cursor()
+{
+    if (econfig.line_count && econfig.cy >= econfig.line_count)
+        econfig.cy = econfig.line_count - 1;
+
+    editor_row_T *row =
+        (econfig.cy >= econfig.line_count) ? NULL : &econfig.rows[econfig.cy];
     colnr_T rowlen = row ? (row->size - row->gap) : 0;
     if (econfig.cx >= rowlen) {
         // If row length is zero, put cx at the start of line (cx = 0)
@@ -190,22 +395,7 @@ ins_process_key(int key)
             }
             break;
         case PAGE_UP:
-        case PAGE_DOWN: {
-            if (key == PAGE_UP) {
-                econfig.cy = econfig.row_offset;
-            }
-            else if (key == PAGE_DOWN) {
-                econfig.cy = econfig.row_offset + econfig.screenrows - 1;
-                if (econfig.cy > econfig.line_count)
-                    econfig.cy = econfig.line_count - 1;
-            }
-
-            int times = econfig.screenrows;
-            while (times--) {
-                input_move_cursor(key == PAGE_UP ? ARROW_UP : ARROW_DOWN);
-            }
-        } break;
-
+        case PAGE_DOWN:
         case ARROW_UP:
         case ARROW_DOWN:
         case ARROW_RIGHT:
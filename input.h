@@ -7,6 +7,8 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+#include <stddef.h>
+
 /* @brief Internal macros */
 #define CTRL_KEY(k) ((k) & 0x1f) // ctrl + key input
 
@@ -24,9 +26,51 @@ enum EditorKeys {
     PAGE_DOWN
 };
 
-/* @brief Reads keyboard input */
+/* @brief Reads keyboard input; keys in the typeahead come first */
 int input_read_key();
 
+/**
+ * @brief Check for keyboard input that is ready to be read
+ *
+ * @return 1 if a key can be read without waiting, 0 otherwise
+ */
+int input_pending();
+
+/**
+ * @brief Insert keys before the unread typeahead to be read as typed keys
+ *
+ * Used to execute the keys of a register. Ctrl-C typed while they are read
+ * throws away the rest.
+ *
+ * @param s Keys as the bytes the terminal sends for them
+ * @param len Number of bytes
+ */
+void input_stuff(const char *s, size_t len);
+
+/**
+ * @brief Check for unread keys in the typeahead
+ *
+ * @return 1 if keys of a register are being executed, 0 otherwise
+ */
+int input_typeahead();
+
+/**
+ * @brief Start recording typed keys to a register
+ *
+ * @param regname Register name
+ */
+void input_record_start(int regname);
+
+/* @brief Stop recording and store the recorded keys without the last one */
+void input_record_stop();
+
+/**
+ * @brief Get the register keys are being recorded to
+ *
+ * @return Register name or 0 when not recording
+ */
+int input_recording();
+
 /**
  * @brief Prompt that returns input
  *
@@ -41,6 +85,19 @@ char *get_user_input_prompt(char *prompt);
  */
 void input_move_cursor(int key);
 
+/**
+ * @brief Move the cursor by count steps of a movement key in one step
+ *
+ * The target position is computed directly and clamped once.
+ *
+ * @param key Movement key; arrow keys, PAGE_UP or PAGE_DOWN
+ * @param count Number of steps
+ */
+void input_move_cursor_by(int key, long count);
+
+/* @brief Keep the cursor on the last character of its row */
+void input_clamp_cursor();
+
 /**
  * @brief Handle keyboard input when in insert mode
  *
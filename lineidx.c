@@ -0,0 +1,301 @@
+/**
+ * @file lineidx.c
+ * @author re-nanashi
+ * @brief Line offsets of big files kept in a cache so reading them again
+ * skips the search for line breaks
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "lineidx.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* @brief Internal macros */
+#define LINEIDX_MAGIC "ZEXIDX1\n"
+// Files smaller than this are scanned quickly enough to not be cached
+#define LINEIDX_MIN_SIZE ((off_t)4 << 20)
+// Bytes hashed at the start and before the end of the indexed lines
+#define LINEIDX_HASH_LEN 4096
+
+/* @brief Start of a cache file; the path of the file and the offsets follow.
+ * Every field is 8 bytes so the offsets stay aligned in the mapping */
+typedef struct lineidx_header {
+    char magic[8];
+    uint64_t dev;
+    uint64_t ino;
+    /* size and modification time of the file when the cache was written */
+    uint64_t size;
+    uint64_t mtime_sec;
+    uint64_t mtime_nsec;
+    /* number of complete lines; count + 1 offsets follow */
+    uint64_t count;
+    /* hashes of the first and the last bytes of the indexed lines */
+    uint64_t head_hash;
+    uint64_t tail_hash;
+    /* length of the path; padded to 8 bytes */
+    uint64_t path_len;
+} lineidx_header_T;
+
+// FNV-1a
+static uint64_t
+lineidx_hash(const char *s, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Offset of the first line offset in a cache file
+static size_t
+lineidx_data_off(size_t path_len)
+{
+    return sizeof(lineidx_header_T) + ((path_len + 7) & ~(size_t)7);
+}
+
+// Name of the cache file of a file; the hash of its absolute path in
+// $XDG_CACHE_HOME/zex or ~/.cache/zex. The directory is created if needed.
+static char *
+lineidx_cache_path(const char *filename, char **abspath)
+{
+    char *abs = realpath(filename, NULL);
+    if (abs == NULL) return NULL;
+
+    char dir[PATH_MAX];
+    const char *cache = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (cache && *cache)
+        snprintf(dir, sizeof(dir), "%s", cache);
+    else if (home && *home)
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else {
+        free(abs);
+        return NULL;
+    }
+    mkdir(dir, 0700);
+    strncat(dir, "/zex", sizeof(dir) - strlen(dir) - 1);
+    mkdir(dir, 0700);
+
+    char *path = malloc(strlen(dir) + 32);
+    sprintf(path, "%s/%016llx.idx", dir,
+            (unsigned long long)lineidx_hash(abs, strlen(abs)));
+    *abspath = abs;
+    return path;
+}
+
+// Fill a header describing the indexed lines of a file
+static void
+lineidx_fill_header(lineidx_header_T *h,
+                    const lineidx_T *idx,
+                    const struct stat *st,
+                    const char *data,
+                    size_t path_len)
+{
+    size_t covered = lineidx_offset(idx, idx->count);
+    size_t n = covered < LINEIDX_HASH_LEN ? covered : LINEIDX_HASH_LEN;
+
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, LINEIDX_MAGIC, sizeof(h->magic));
+    h->dev = st->st_dev;
+    h->ino = st->st_ino;
+    h->size = st->st_size;
+    h->mtime_sec = st->st_mtim.tv_sec;
+    h->mtime_nsec = st->st_mtim.tv_nsec;
+    h->count = idx->count;
+    h->head_hash = lineidx_hash(data, n);
+    h->tail_hash = lineidx_hash(data + covered - n, n);
+    h->path_len = path_len;
+}
+
+uint64_t
+lineidx_offset(const lineidx_T *idx, linenr_T i)
+{
+    if (i <= idx->base_count) return idx->base ? idx->base[i] : 0;
+    return idx->tail[i - idx->base_count - 1];
+}
+
+bool
+lineidx_load(lineidx_T *idx,
+             const char *filename,
+             const struct stat *st,
+             const char *data)
+{
+    memset(idx, 0, sizeof(*idx));
+    if (st->st_size < LINEIDX_MIN_SIZE) return false;
+
+    char *abs;
+    char *path = lineidx_cache_path(filename, &abs);
+    if (path == NULL) return false;
+
+    int fd = open(path, O_RDONLY);
+    struct stat cst;
+    void *map = MAP_FAILED;
+    if (fd != -1 && fstat(fd, &cst) == 0
+        && cst.st_size >= (off_t)sizeof(lineidx_header_T))
+        map = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (fd != -1) close(fd);
+    free(path);
+    if (map == MAP_FAILED) {
+        free(abs);
+        return false;
+    }
+
+    // The cache must be of this file and hold every offset it claims
+    const lineidx_header_T *h = map;
+    size_t map_len = cst.st_size;
+    size_t abs_len = strlen(abs);
+    size_t data_off = lineidx_data_off(abs_len);
+    bool valid = memcmp(h->magic, LINEIDX_MAGIC, sizeof(h->magic)) == 0
+                 && h->dev == (uint64_t)st->st_dev
+                 && h->ino == (uint64_t)st->st_ino
+                 && h->path_len == abs_len && map_len > data_off
+                 && memcmp((const char *)map + sizeof(*h), abs, abs_len) == 0
+                 && h->count < (map_len - data_off) / sizeof(uint64_t);
+    free(abs);
+
+    const uint64_t *off = (const uint64_t *)((const char *)map + data_off);
+    if (valid) {
+        // An unchanged file keeps its size and time; a file that grew keeps
+        // the text of the indexed lines
+        uint64_t covered = off[h->count];
+        size_t n = covered < LINEIDX_HASH_LEN ? covered : LINEIDX_HASH_LEN;
+        if (h->size == (uint64_t)st->st_size)
+            valid = h->mtime_sec == (uint64_t)st->st_mtim.tv_sec
+                    && h->mtime_nsec == (uint64_t)st->st_mtim.tv_nsec;
+        else
+            valid = h->size < (uint64_t)st->st_size;
+        valid = valid && off[0] == 0 && covered <= (uint64_t)st->st_size
+                && h->head_hash == lineidx_hash(data, n)
+                && h->tail_hash == lineidx_hash(data + covered - n, n);
+    }
+    if (!valid) {
+        munmap(map, map_len);
+        return false;
+    }
+
+    idx->base = off;
+    idx->base_count = idx->count = h->count;
+    idx->map = map;
+    idx->map_len = map_len;
+    return true;
+}
+
+void
+lineidx_scan(lineidx_T *idx, const char *data, size_t size)
+{
+    size_t pos = lineidx_offset(idx, idx->count);
+    while (pos < size) {
+        const char *nl = memchr(data + pos, '\n', size - pos);
+        if (nl == NULL) break;
+        pos = nl - data + 1;
+
+        size_t n = idx->count - idx->base_count;
+        if (n == idx->tail_cap) {
+            idx->tail_cap = idx->tail_cap ? idx->tail_cap * 2 : 1024;
+            idx->tail = realloc(idx->tail, sizeof(uint64_t) * idx->tail_cap);
+        }
+        idx->tail[n] = pos;
+        idx->count++;
+    }
+}
+
+// Write all of a buffer at an offset
+static bool
+lineidx_pwrite(int fd, const void *buf, size_t len, off_t off)
+{
+    const char *p = buf;
+    while (len) {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+        off += n;
+    }
+    return true;
+}
+
+void
+lineidx_save(const lineidx_T *idx,
+             const char *filename,
+             const struct stat *st,
+             const char *data)
+{
+    if (st->st_size < LINEIDX_MIN_SIZE || idx->count == idx->base_count)
+        return;
+
+    char *abs;
+    char *path = lineidx_cache_path(filename, &abs);
+    if (path == NULL) return;
+
+    size_t abs_len = strlen(abs);
+    size_t data_off = lineidx_data_off(abs_len);
+    lineidx_header_T h;
+    lineidx_fill_header(&h, idx, st, data, abs_len);
+    size_t ntail = idx->count - idx->base_count;
+
+    // Lines found after the cached ones are appended; the header is updated
+    // last so the cache stays valid for the lines before them if that fails
+    if (idx->base) {
+        int fd = open(path, O_WRONLY);
+        if (fd != -1) {
+            off_t at = data_off + (idx->base_count + 1) * sizeof(uint64_t);
+            if (lineidx_pwrite(fd, idx->tail, ntail * sizeof(uint64_t), at))
+                lineidx_pwrite(fd, &h, sizeof(h), 0);
+            close(fd);
+        }
+    }
+    // A new cache is written aside then renamed over the old one
+    else {
+        char *tmp = malloc(strlen(path) + 32);
+        sprintf(tmp, "%s.%ld", path, (long)getpid());
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd != -1) {
+            char *head = calloc(1, data_off + sizeof(uint64_t));
+            memcpy(head, &h, sizeof(h));
+            memcpy(head + sizeof(h), abs, abs_len);
+            bool ok =
+                lineidx_pwrite(fd, head, data_off + sizeof(uint64_t), 0)
+                && lineidx_pwrite(fd, idx->tail, ntail * sizeof(uint64_t),
+                                  data_off + sizeof(uint64_t));
+            free(head);
+            close(fd);
+            if (!ok || rename(tmp, path) == -1) unlink(tmp);
+        }
+        free(tmp);
+    }
+    free(path);
+    free(abs);
+}
+
+void
+lineidx_forget(const char *filename)
+{
+    char *abs;
+    char *path = lineidx_cache_path(filename, &abs);
+    if (path == NULL) return;
+
+    unlink(path);
+    free(path);
+    free(abs);
+}
+
+void
+lineidx_free(lineidx_T *idx)
+{
+    if (idx->map) munmap(idx->map, idx->map_len);
+    free(idx->tail);
+    memset(idx, 0, sizeof(*idx));
+}
@@ -0,0 +1,101 @@
+/**
+ * @file lineidx.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for the line index cache
+ */
+
+#ifndef LINEIDX_H
+#define LINEIDX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "config.h"
+
+/* @brief Offsets of the lines of a file; complete lines end with '\n' */
+typedef struct lineidx {
+    /* base_count + 1 offsets read from the cache; NULL if there are none */
+    const uint64_t *base;
+    /* number of lines in base */
+    linenr_T base_count;
+    /* offsets found by scanning after the base; offset of line
+     * base_count + 1 first */
+    uint64_t *tail;
+    /* allocated number of offsets in tail */
+    size_t tail_cap;
+    /* number of complete lines */
+    linenr_T count;
+    /* mapping of the cache file */
+    void *map;
+    /* length of the mapping */
+    size_t map_len;
+} lineidx_T;
+
+/**
+ * @brief Get the offset of the first byte of a line
+ *
+ * @param idx Pointer to line index
+ * @param i Index of the line; count gives the offset after the last '\n'
+ */
+uint64_t lineidx_offset(const lineidx_T *idx, linenr_T i);
+
+/**
+ * @brief Map the cached index of a file
+ *
+ * The cache is keyed by the path, device and inode of the file. It is used
+ * if the file is unchanged or only grew: its size and modification time
+ * match, or the text at the start and before the end of the indexed lines
+ * is still the same.
+ *
+ * @param idx Pointer to line index; empty if there is no usable cache
+ * @param filename Name of the file
+ * @param st Status of the file
+ * @param data Text of the file
+ * @return True if lines were read from the cache
+ */
+bool lineidx_load(lineidx_T *idx,
+                  const char *filename,
+                  const struct stat *st,
+                  const char *data);
+
+/**
+ * @brief Add the lines after the indexed ones
+ *
+ * @param idx Pointer to line index
+ * @param data Text of the file
+ * @param size Size of the text
+ */
+void lineidx_scan(lineidx_T *idx, const char *data, size_t size);
+
+/**
+ * @brief Store the index of a big file for the next time it is read
+ *
+ * Lines added after the cached ones are appended to the cache file.
+ *
+ * @param idx Pointer to line index
+ * @param filename Name of the file
+ * @param st Status of the file
+ * @param data Text of the file
+ */
+void lineidx_save(const lineidx_T *idx,
+                  const char *filename,
+                  const struct stat *st,
+                  const char *data);
+
+/**
+ * @brief Remove the cached index of a file; it was rewritten
+ *
+ * @param filename Name of the file
+ */
+void lineidx_forget(const char *filename);
+
+/**
+ * @brief Release the offsets and the cache mapping of an index
+ *
+ * @param idx Pointer to line index
+ */
+void lineidx_free(lineidx_T *idx);
+
+#endif /* LINEIDX_H */
@@ -5,14 +5,19 @@
  */
 
 #include <pthread.h>
+#include <string.h>
 
 #include "config.h"
+#include "buflist.h"
 #include "input.h"
 #include "screen.h"
 #include "file_io.h"
+#include "follow.h"
 #include "logger.h"
 #include "terminal.h"
 #include "state.h"
+#include "swap.h"
+#include "win.h"
 
 /* @brief Declare Zex editor configurations */
 editor_config_T econfig;
@@ -29,10 +34,16 @@ init_editor()
     econfig.line_count = 0;
     econfig.rows = NULL;
     econfig.mode = MODE_NORMAL;
+    econfig.visual_type = 0;
+    econfig.visual_eol = 0;
     econfig.dirty = 0;
     econfig.filename = NULL;
+    econfig.swap = NULL;
+    econfig.follow = NULL;
+    econfig.cmdline[0] = '\0';
     econfig.statusmsg[0] = '\0';
     econfig.statusmsg_time = 0;
+    econfig.sync_output = term_query_sync_output();
 
     if (term_get_window_sz(&econfig.screenrows, &econfig.screencols) == -1)
         die("get_window_sz");
@@ -41,13 +52,48 @@ init_editor()
 int
 main(int argc, char *argv[])
 {
+    // -r recovers the changes journaled for the first file; -f follows it
+    // as it grows
+    bool recover = false, follow = false;
+    int first = 1;
+    for (; first < argc && argv[first][0] == '-' && argv[first][1]; first++) {
+        if (strcmp(argv[first], "-r") == 0)
+            recover = true;
+        else if (strcmp(argv[first], "-f") == 0)
+            follow = true;
+        else
+            break;
+    }
+
+    // A first file "-" is the text piped to the editor; keys are read from
+    // the terminal
+    int pipe_fd = -1;
+    if (first < argc && strcmp(argv[first], "-") == 0) {
+        pipe_fd = term_stdin_from_tty();
+        first++;
+    }
+
     term_enable_raw_mode();
     init_editor();
 
-    // If a file to edit is passed
-    if (argc >= 2) {
-        file_open(argv[1]);
-    }
+    // Set initial status message; reading the first file replaces it
+    statusbar_set_message("HELP: Ctrl-Q = quit");
+
+    // Every file passed is listed; only the first is read now
+    if (pipe_fd != -1) buflist_add(NULL);
+    for (int i = first; i < argc; i++)
+        buflist_add(argv[i]);
+    if (argc <= first && pipe_fd == -1) buflist_add(NULL);
+    buflist_enter(0);
+    win_init();
+    if (pipe_fd != -1) follow_pipe(pipe_fd);
+
+    if (recover
+        && (econfig.filename == NULL || swap_recover(econfig.filename) == -1))
+        statusbar_set_message("No swap file found for %s",
+                              econfig.filename ? econfig.filename
+                                               : "[No Name]");
+    if (follow) follow_start();
 
     // Create new thread for handling terminal resolution changes
     pthread_t thread;
@@ -62,9 +108,6 @@ main(int argc, char *argv[])
         return 1;
     }
 
-    // Set initial status message
-    statusbar_set_message("HELP: Ctrl-Q = quit");
-
     // Enter MODE_NORMAL as default state
     state_enter(nv_mode, NULL);
 
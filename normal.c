@@ -15,186 +15,332 @@
 #include "input.h"
 #include "screen.h"
 #include "edit.h"
+#include "file_io.h"
+#include "fold.h"
 #include "state.h"
-
-#define DIFF_CHAR_TYPE(c1, c2)                                                 \
-    ((isalnum(c1) && !isalnum(c2)) || (ispunct(c1) && !ispunct(c2)))
+#include "ops.h"
+#include "buffer.h"
+#include "bracket.h"
+#include "byteidx.h"
+#include "cold.h"
+#include "swap.h"
+#include "win.h"
 
 enum Directions { FORWARD = 1, BACKWARD = -1 };
 
+/* @brief Classes of characters for word motions; blanks are 0, keyword
+ * characters 2 and other characters 1. Bytes of UTF-8 sequences are keyword
+ * characters so accented words hold together. */
+static unsigned char nv_word_classes[256];
+/* @brief Classes for WORD motions; every non-blank is 1 */
+static unsigned char nv_bigword_classes[256];
+
+/* @brief Position of a word motion and the text of its line. The text is
+ * read in place: the characters before front from text, the others from
+ * back, past the gap. col may be len, the end of the line. */
+typedef struct wordpos {
+    linenr_T lnum;
+    colnr_T col;
+    colnr_T len;
+    colnr_T front;
+    const unsigned char *text;
+    const unsigned char *back;
+    const unsigned char *cls;
+} wordpos_T;
+
 editor_row_T *
 get_current_row()
 {
     return (econfig.cy >= econfig.line_count) ? NULL
-                                              : &econfig.rows[econfig.cy];
+                                              : row_get(econfig.cy);
 }
 
-void
-jump_to_next_non_blank_char(editor_row_T *row, colnr_T *cx)
+// Character of a row at cx; '\0' past its end. The text is read through the
+// gap so that long rows without a render buffer move the same way
+static int
+nv_char_at(const editor_row_T *row, colnr_T cx)
 {
-    while (!isblank(row->render[*cx]) && *cx < row->size)
-        (*cx)++;
+    return cx < rbuf_len(row) ? rbuf_char_at(row, cx) : '\0';
 }
 
 void
-jump_to_next_blank_char(editor_row_T *row, colnr_T *cx)
+skip_blank_chars(editor_row_T *row, colnr_T *cx)
 {
-    while (isblank(row->render[*cx]) && *cx < row->size)
+    while (isblank(nv_char_at(row, *cx)))
         (*cx)++;
 }
 
-void
-skip_successive_alnum_or_punct_chars(editor_row_T *row, colnr_T *cx)
+static void
+nv_init_word_classes()
+{
+    if (nv_word_classes['a']) return;
+    for (int c = 0; c < 256; c++) {
+        if (c == ' ' || c == '\t') continue;
+        nv_bigword_classes[c] = 1;
+        nv_word_classes[c] = isalnum(c) || c == '_' || c >= 0x80 ? 2 : 1;
+    }
+}
+
+// Point a word motion at a line; packed rows are read without unpacking
+static void
+nv_word_line(wordpos_T *wp, linenr_T lnum)
 {
-    if (isalnum(row->render[*cx])) {
-        while (isalnum(row->render[*cx]))
-            (*cx)++;
+    const editor_row_T *row = &econfig.rows[lnum];
+    wp->lnum = lnum;
+    wp->len = rbuf_len(row);
+    if (row->cold) {
+        size_t len;
+        wp->text = (const unsigned char *)cold_text(row, &len);
+        wp->front = wp->len;
+        wp->back = wp->text;
     }
-    else if (ispunct(row->render[*cx])) {
-        while (ispunct(row->render[*cx]))
-            (*cx)++;
+    else {
+        wp->text = (const unsigned char *)row->chars;
+        wp->front = row->front;
+        wp->back = wp->text + row->gap;
     }
 }
 
-void
-skip_blank_chars(editor_row_T *row, colnr_T *cx)
+static bool
+nv_word_next_line(wordpos_T *wp)
 {
-    while (isblank(row->render[*cx]))
-        (*cx)++;
+    if (wp->lnum + 1 >= econfig.line_count) return false;
+    nv_word_line(wp, wp->lnum + 1);
+    wp->col = 0;
+    return true;
 }
 
-void
-jump_to_end_of_current_word(editor_row_T *row, colnr_T *cx)
+// Move to the end of the line before; false at the first line
+static bool
+nv_word_prev_line(wordpos_T *wp)
 {
-    if (!isblank(row->render[*cx]) && isblank(row->render[*cx + 1])) {
-        (*cx)++;
-        skip_blank_chars(row, cx);
-        while (!isblank(row->render[*cx])
-               && (isalnum(row->render[*cx]) || ispunct(row->render[*cx])))
-            (*cx)++;
-        (*cx)--;
-    }
-    else if (isblank(row->render[*cx]) && *cx < row->size) {
-        skip_blank_chars(row, cx);
-    }
-    else if (*cx >= row->size - 1 && *cx > 0) {
-        (*cx)++;
-    }
-    else {
-        while (!isblank(row->render[*cx])
-               && (isalnum(row->render[*cx]) || ispunct(row->render[*cx])))
-            (*cx)++;
-        (*cx)--;
-    }
+    if (wp->lnum == 0) return false;
+    nv_word_line(wp, wp->lnum - 1);
+    wp->col = wp->len;
+    return true;
 }
 
-void
-jump_to_next_word(editor_row_T *row, colnr_T *cx)
+// Class of the character at the position; the end of a line is a blank
+static int
+nv_word_class(const wordpos_T *wp)
 {
-    if ((isalnum(row->render[*cx]) && !isalnum(row->render[*cx + 1]))
-        || (ispunct(row->render[*cx]) && !ispunct(row->render[*cx + 1])))
-    {
-        (*cx)++;
+    if (wp->col >= wp->len) return 0;
+    return wp->cls[wp->col < wp->front ? wp->text[wp->col]
+                                       : wp->back[wp->col]];
+}
+
+// Move over the characters of a class up to the first other one or the end
+// of the line; each segment of the gap buffer is scanned on its own
+static void
+nv_word_run_fwd(wordpos_T *wp, int cls)
+{
+    colnr_T col = wp->col;
+    while (col < wp->front && wp->cls[wp->text[col]] == cls)
+        col++;
+    if (col >= wp->front) {
+        while (col < wp->len && wp->cls[wp->back[col]] == cls)
+            col++;
     }
+    wp->col = col;
+}
 
-    skip_successive_alnum_or_punct_chars(row, cx);
-    skip_blank_chars(row, cx);
-    skip_successive_alnum_or_punct_chars(row, cx);
-    (*cx)--;
+// Move back to the first of the characters of a class ending at the position
+static void
+nv_word_run_bck(wordpos_T *wp, int cls)
+{
+    colnr_T col = wp->col;
+    while (col > wp->front && wp->cls[wp->back[col - 1]] == cls)
+        col--;
+    if (col <= wp->front) {
+        while (col > 0 && wp->cls[wp->text[col - 1]] == cls)
+            col--;
+    }
+    wp->col = col;
 }
 
-void
-handle_end_of_line(editor_row_T *row, colnr_T *cx)
+// "w": move to the start of the next word; an empty line is a word. Stops
+// at the end of the last line when there is none, and at the end of the
+// line with eol set, for the last word an operator moves over.
+static bool
+nv_fwd_word(wordpos_T *wp, bool eol)
 {
-    if (econfig.cy == econfig.line_count - 1 && (*cx) == row->size) {
-        (*cx)--;
+    int sclass = nv_word_class(wp);
+    if (sclass != 0)
+        nv_word_run_fwd(wp, sclass);
+    else if (wp->col < wp->len)
+        wp->col++;
+    else if (!nv_word_next_line(wp))
+        return false;
+    else if (eol)
+        return true;
+
+    // Blanks and line ends are skipped a run at a time
+    for (;;) {
+        if (wp->len == 0) return true;
+        nv_word_run_fwd(wp, 0);
+        if (wp->col < wp->len || eol) return true;
+        if (!nv_word_next_line(wp)) return true;
     }
 }
 
-void
-move_to_next_line_if_needed(editor_row_T *row, colnr_T *cx)
+// "e": move to the end of the word, or of the next one when already there
+static bool
+nv_end_word(wordpos_T *wp)
 {
-    if (*cx == row->size || (row->size == 0 && *cx == 0)) {
-        row = (econfig.cy == econfig.line_count - 1)
-                  ? NULL
-                  : &econfig.rows[++econfig.cy];
-        if (row) {
-            (*cx) = 0;
-            skip_blank_chars(row, cx);
+    int sclass = nv_word_class(wp);
+    if (wp->col < wp->len)
+        wp->col++;
+    else if (!nv_word_next_line(wp))
+        return false;
+
+    int cls = nv_word_class(wp);
+    if (cls == 0 || cls != sclass) {
+        for (;;) {
+            nv_word_run_fwd(wp, 0);
+            if (wp->col < wp->len) break;
+            if (!nv_word_next_line(wp)) return false;
         }
+        cls = nv_word_class(wp);
     }
+    nv_word_run_fwd(wp, cls);
+    wp->col--;
+    return true;
 }
 
-void
-jump_to_end_of_first_word(editor_row_T *row, colnr_T *cx)
+// "b": move to the start of the word, or of the previous one when already
+// there; an empty line is a word
+static bool
+nv_bck_word(wordpos_T *wp)
 {
-    if (isalnum(row->render[*cx])) {
-        while (isalnum(row->render[*cx]))
-            (*cx)++;
-        (*cx)--;
-    }
-    else if (ispunct(row->render[*cx])) {
-        while (ispunct(row->render[*cx]))
-            (*cx)++;
-        (*cx)--;
+    if (wp->col > 0)
+        wp->col--;
+    else if (!nv_word_prev_line(wp))
+        return false;
+
+    while (nv_word_class(wp) == 0) {
+        if (wp->len == 0) return true;
+        nv_word_run_bck(wp, 0);
+        if (wp->col > 0) {
+            wp->col--;
+            break;
+        }
+        if (!nv_word_prev_line(wp)) return true;
     }
+    nv_word_run_bck(wp, nv_word_class(wp));
+    return true;
 }
 
-void
-fwd_word(bool flag)
+// "ge": move to the end of the previous word; an empty line is a word
+static bool
+nv_bckend_word(wordpos_T *wp)
 {
-    editor_row_T *row = get_current_row();
-    colnr_T *cx = &econfig.cx;
-
-    if (flag == true) {
-        jump_to_next_non_blank_char(row, cx);
-        jump_to_next_blank_char(row, cx);
+    int sclass = nv_word_class(wp);
+    if (wp->col > 0)
+        wp->col--;
+    else if (!nv_word_prev_line(wp))
+        return false;
+
+    if (sclass != 0 && nv_word_class(wp) == sclass) {
+        nv_word_run_bck(wp, sclass);
+        if (wp->col > 0)
+            wp->col--;
+        else if (!nv_word_prev_line(wp))
+            return true;
     }
-    else {
-        skip_successive_alnum_or_punct_chars(row, cx);
-        skip_blank_chars(row, cx);
+    for (;;) {
+        if (nv_word_class(wp) != 0 || wp->len == 0) return true;
+        nv_word_run_bck(wp, 0);
+        if (wp->col > 0) {
+            wp->col--;
+            return true;
+        }
+        if (!nv_word_prev_line(wp)) return true;
     }
-
-    handle_end_of_line(row, cx);
-    move_to_next_line_if_needed(row, cx);
 }
 
-void
-end_word(bool flag)
+// Move the cursor count words with "w", "e", "b" or "ge" (motion 'g'). An
+// operator may end past the last character of the file; the cursor stays on
+// the text otherwise. False if the cursor could not move.
+static bool
+nv_word_motion(int motion, bool big, long count)
 {
-    editor_row_T *row = get_current_row();
-    colnr_T *cx = &econfig.cx;
-
-    if (flag == true) {
-        jump_to_end_of_current_word(row, cx);
-    }
-    else {
-        jump_to_next_word(row, cx);
+    if (econfig.cy >= econfig.line_count) return false;
+    nv_init_word_classes();
+
+    wordpos_T wp;
+    wp.cls = big ? nv_bigword_classes : nv_word_classes;
+    nv_word_line(&wp, econfig.cy);
+    wp.col = econfig.cx < wp.len ? econfig.cx : wp.len;
+    for (; count > 0; count--) {
+        bool eol = count == 1 && econfig.mode == MODE_OP_PENDING;
+        bool moved = motion == 'w'   ? nv_fwd_word(&wp, eol)
+                     : motion == 'e' ? nv_end_word(&wp)
+                     : motion == 'b' ? nv_bck_word(&wp)
+                                     : nv_bckend_word(&wp);
+        if (!moved) break;
     }
+    bool moved = wp.lnum != econfig.cy || wp.col != econfig.cx;
 
-    handle_end_of_line(row, cx);
-    move_to_next_line_if_needed(row, cx);
-    jump_to_end_of_first_word(row, cx);
+    econfig.cy = wp.lnum;
+    econfig.cx = wp.col;
+    if (wp.col >= wp.len && wp.len && econfig.mode != MODE_OP_PENDING)
+        econfig.cx = wp.len - 1;
+    return moved;
 }
 
 void
 nv_wordcmd(const cmdarg_T *ca)
 {
-    bool word_end = false;
-    bool flag = ca->arg; // flag for shift mod; if true then shift is pressed
+    // arg is set for the shifted keys moving by WORDs; an operator is
+    // cancelled when the cursor cannot move
+    if (!nv_word_motion(tolower(ca->cmdchar), ca->arg, ca->count1)
+        && ca->oap)
+        ca->oap->op_type = 0;
+}
 
-    // Jump cursor to the either first char or last char of the next word
-    // Set true if cursor will jump to the end of a word
-    if (ca->cmdchar == 'e' || ca->cmdchar == 'E') {
-        word_end = true;
-    }
-    // if e/E go to end of word else if w/W go to start of word
-    if (word_end) {
-        end_word(flag);
+// Move count paragraphs; a paragraph ends at an empty line. Rows are told
+// apart by their length so their text is never looked at.
+static void
+nv_paragraph(const cmdarg_T *ca, int dir)
+{
+    if (econfig.line_count == 0) return;
+
+    win_T *wp = win_current();
+    linenr_T lnum = econfig.cy, top, bot;
+    for (long count = ca->count1; count > 0; count--) {
+        bool did_skip = false;
+        for (bool first = true;; first = false) {
+            bool empty = rbuf_len(&econfig.rows[lnum]) == 0;
+            if (!first && did_skip && empty) break;
+            did_skip |= !empty;
+
+            // A closed fold is passed as one line
+            if (fold_closed(wp, lnum, &top, &bot))
+                lnum = dir == FORWARD ? bot : top;
+            if (dir == FORWARD ? lnum + 1 >= econfig.line_count : lnum == 0) {
+                // Fail when there are more paragraphs to move over; an
+                // operator is cancelled
+                if (count > 1) {
+                    if (ca->oap) ca->oap->op_type = 0;
+                    return;
+                }
+                break;
+            }
+            if (dir == FORWARD)
+                lnum++;
+            else
+                lnum--;
+        }
     }
-    else {
-        // w/W
-        fwd_word(flag);
+
+    // The last line ends the last paragraph at its last character, which
+    // an operator includes
+    econfig.cy = lnum;
+    econfig.cx = 0;
+    colnr_T len = rbuf_len(&econfig.rows[lnum]);
+    if (lnum + 1 == econfig.line_count && len) {
+        econfig.cx = len - 1;
+        if (ca->oap) ca->oap->inclusive = true;
     }
 }
 
@@ -216,9 +362,12 @@ replace_char_at_cur(shift_status_T sstatus)
                     // Get current row where cursor is at
                     editor_row_T *row = (econfig.cy >= econfig.line_count)
                                             ? NULL
-                                            : &econfig.rows[econfig.cy];
+                                            : row_get(econfig.cy);
 
-                    if (econfig.cx < row->size) row->render[econfig.cx++] = c;
+                    if (row && econfig.cx < rbuf_len(row)) {
+                        row_delete_char(row, econfig.cx);
+                        row_insert_char(row, econfig.cx++, c);
+                    }
                 }
             }
             // Remove mode status
@@ -231,67 +380,155 @@ replace_char_at_cur(shift_status_T sstatus)
                 // Get current row where cursor is at
                 editor_row_T *row = (econfig.cy >= econfig.line_count)
                                         ? NULL
-                                        : &econfig.rows[econfig.cy];
-                row->render[econfig.cx] = c;
+                                        : row_get(econfig.cy);
+                if (row && econfig.cx < rbuf_len(row)) {
+                    row_delete_char(row, econfig.cx);
+                    row_insert_char(row, econfig.cx, c);
+                }
             }
         } break;
     }
 }
 
-void
-jump_to_char(int c, shift_status_T sstatus)
+// Screen lines of the cursor line; a closed fold is one line
+static linenr_T
+nv_row_lines(editor_row_T *row, int cols)
 {
-    editor_row_T *row =
-        (econfig.cy >= econfig.line_count) ? NULL : &econfig.rows[econfig.cy];
-    colnr_T *cx = &econfig.cx, prev_pos = econfig.cx;
-    bool goto_char = false;
-    if (c == 'f' || c == 'F') goto_char = true;
+    if (fold_closed(win_current(), econfig.cy, NULL, NULL)) return 1;
+    return screen_row_lines(row, cols);
+}
 
-    // Inform user of key pressed
-    statusbar_set_message("%c", c);
-    screen_refresh();
+// Move the cursor count screen lines down, up if count is negative; the
+// screen column is kept. Moves by rows when rows do not wrap.
+static void
+nv_screen_lines(long count)
+{
+    if (!econfig.wrap || econfig.cy >= econfig.line_count) {
+        input_move_cursor_by(count > 0 ? ARROW_DOWN : ARROW_UP,
+                             count > 0 ? count : -count);
+        return;
+    }
 
-    int k = input_read_key();
-    if (k > 0x1f && k < 0x7f) {
-        // Offset cursor x pos by 1 to search next instance of char incase
-        // the char to find is the same char as the one the under cursor
-        if (row)
-            sstatus == SHIFT_NOT_PRESSED ? (*cx)++ : (*cx)--;
-        else {
-            statusbar_set_message(""); // remove status
-            return;
+    int cols = econfig.screencols;
+    win_T *wp = win_current();
+    fold_adjust_cursor();
+    editor_row_T *row = row_get(econfig.cy);
+    colnr_T rx = row_convert_cx_to_rx(row, econfig.cx);
+    colnr_T col = rx % cols;
+    linenr_T line = rx / cols, next;
+    if (line >= nv_row_lines(row, cols)) line = nv_row_lines(row, cols) - 1;
+    for (; count > 0; count--) {
+        if (line + 1 < nv_row_lines(row, cols))
+            line++;
+        else if ((next = fold_move(wp, econfig.cy, 1)) != econfig.cy) {
+            econfig.cy = next;
+            row = row_get(econfig.cy);
+            line = 0;
         }
-
-        // Find next instance of char in the string
-        switch (sstatus) {
-            case SHIFT:
-                while (row->render[*cx] != k && *cx != 0)
-                    (*cx)--;
-                break;
-            case SHIFT_NOT_PRESSED:
-                while (row->render[*cx] != k && *cx < row->size - 1)
-                    (*cx)++;
-                break;
+        else
+            break;
+    }
+    for (; count < 0; count++) {
+        if (line > 0)
+            line--;
+        else if ((next = fold_move(wp, econfig.cy, -1)) != econfig.cy) {
+            econfig.cy = next;
+            row = row_get(econfig.cy);
+            line = nv_row_lines(row, cols) - 1;
         }
+        else
+            break;
+    }
+    econfig.cx = row_convert_rx_to_cx(row, line * cols + col);
+    input_clamp_cursor();
+}
 
-        if (row->render[*cx] == k) {
-            if (!goto_char) sstatus != SHIFT ? (*cx)-- : (*cx)++;
-        }
-        else {
-            (*cx) = prev_pos;
-        }
+// Move the cursor to the count-th instance of a character typed next, or
+// next to it for "t" and "T"; false if the row has not that many
+static bool
+jump_to_char(int c, shift_status_T sstatus, long count)
+{
+    bool goto_char = c == 'f' || c == 'F';
+    int dir = sstatus == SHIFT ? BACKWARD : FORWARD;
 
-        // Remove status after
-        statusbar_set_message("");
+    // Inform user of key pressed
+    statusbar_set_message("%c", c);
+    screen_refresh();
+
+    // Rows may be added while the key is waited for; the row is got after
+    int k = input_read_key();
+    statusbar_set_message(""); // remove status
+    if (k <= 0x1f || k >= 0x7f || econfig.cy >= econfig.line_count)
+        return false;
+    editor_row_T *row = row_get(econfig.cy);
+
+    // The search starts next to the cursor so the char under it is skipped
+    colnr_T col = econfig.cx, len = rbuf_len(row);
+    for (; count > 0; count--) {
+        do {
+            if (dir == FORWARD ? col + 1 >= len : col == 0) return false;
+            col += dir;
+        } while (nv_char_at(row, col) != k);
     }
+    econfig.cx = goto_char ? col : col - dir;
+    return true;
+}
+
+/* @brief Keys that move the cursor and can follow an operator */
+static const struct nv_motion {
+    int key;
+    int flags;
+} nv_motions[] = {
+    { 'h', 0 },
+    { 'l', 0 },
+    { ARROW_LEFT, 0 },
+    { ARROW_RIGHT, 0 },
+    { '0', 0 },
+    { HOME_KEY, 0 },
+    { 'w', 0 },
+    { 'W', 0 },
+    { 'e', MOTION_INCLUSIVE },
+    { 'E', MOTION_INCLUSIVE },
+    { 'b', 0 },
+    { 'B', 0 },
+    { '}', 0 },
+    { '{', 0 },
+    { '%', MOTION_INCLUSIVE },
+    { '$', MOTION_INCLUSIVE },
+    { END_KEY, MOTION_INCLUSIVE },
+    { 'f', MOTION_INCLUSIVE },
+    { 't', MOTION_INCLUSIVE },
+    { 'F', 0 },
+    { 'T', 0 },
+    { 'j', MOTION_LINEWISE },
+    { 'k', MOTION_LINEWISE },
+    { ARROW_UP, MOTION_LINEWISE },
+    { ARROW_DOWN, MOTION_LINEWISE },
+    { 'G', MOTION_LINEWISE },
+    { 'g', MOTION_LINEWISE },
+    { PAGE_UP, MOTION_LINEWISE },
+    { PAGE_DOWN, MOTION_LINEWISE },
+    { CTRL_KEY('f'), MOTION_LINEWISE },
+    { CTRL_KEY('b'), MOTION_LINEWISE },
+};
+
+int
+nv_motion_flags(int key)
+{
+    for (size_t i = 0; i < sizeof(nv_motions) / sizeof(nv_motions[0]); i++)
+        if (nv_motions[i].key == key) return nv_motions[i].flags;
+    return -1;
 }
 
 void
-nv_process_key(int c)
+nv_process_key(cmdarg_T *ca)
 {
+    int c = ca->cmdchar;
+    editor_row_T *row = get_current_row();
+
     switch (c) {
         // Movement keys
-        // Basic Movement
+        // Basic Movement; the count is applied in one step
         case 'k':
         case 'j':
         case 'h':
@@ -301,32 +538,134 @@ nv_process_key(int c)
             if (c == 'j') key = ARROW_DOWN;
             if (c == 'h') key = ARROW_LEFT;
             if (c == 'l') key = ARROW_RIGHT;
-            input_move_cursor(key);
+            input_move_cursor_by(key, ca->count1);
         } break;
 
+        case ARROW_UP:
+        case ARROW_DOWN:
+        case ARROW_LEFT:
+        case ARROW_RIGHT:
+        case PAGE_UP:
+        case PAGE_DOWN:
+            input_move_cursor_by(c, ca->count1);
+            break;
+
+        // Scroll by screens
+        case CTRL_KEY('f'):
+            input_move_cursor_by(PAGE_DOWN, ca->count1);
+            break;
+        case CTRL_KEY('b'):
+            input_move_cursor_by(PAGE_UP, ca->count1);
+            break;
+
         // Move cursor to the start of the line
         case '0':
+        case HOME_KEY:
             econfig.cx = 0;
             break;
 
-        // Jump by start of words (including punctuation)
-        case 'w':
-            nv_wordcmd(SHIFT_NOT_PRESSED);
+        // Move cursor to the end of the line; a count moves count - 1 lines
+        // down first
+        case '$':
+        case END_KEY:
+            if (ca->count1 > 1) input_move_cursor_by(ARROW_DOWN, ca->count1 - 1);
+            row = get_current_row();
+            if (row && row->size - row->gap)
+                econfig.cx = row->size - row->gap - 1;
             break;
 
+        // Jump to line count; defaults to the last line for G and the first
+        // line for gg
+        case 'G':
+        case 'g': {
+            int k = c == 'g' ? input_read_key() : 'G';
+            if (k == 'j' || k == 'k') {
+                nv_screen_lines(k == 'j' ? ca->count1 : -ca->count1);
+                break;
+            }
+            // Jump back by end of words; the end is included by operators
+            if (k == 'e' || k == 'E') {
+                if (ca->oap) {
+                    ca->oap->motion_type = MCHAR;
+                    ca->oap->inclusive = true;
+                }
+                if (!nv_word_motion('g', k == 'E', ca->count1) && ca->oap)
+                    ca->oap->op_type = 0;
+                break;
+            }
+            // Jump to byte count; the first byte without one. Bytes past
+            // the part of the file read so far wait for the rest.
+            if (k == 'o') {
+                file_load_finish();
+                byteidx_goto(ca->count1 - 1);
+                break;
+            }
+            if (c == 'g' && k != 'g') break;
+
+            // The last line is only known once the whole file is read
+            bool last = c == 'G' && ca->count0 == 0;
+            if (last || (linenr_T)ca->count0 > econfig.line_count)
+                file_load_finish();
+            linenr_T line = ca->count0 ? (linenr_T)ca->count0
+                            : last     ? econfig.line_count
+                                       : 1;
+            if (line > econfig.line_count) line = econfig.line_count;
+            econfig.cy = line ? line - 1 : 0;
+            input_clamp_cursor();
+        } break;
+
+        // Jump to the bracket matching the first one at or after the cursor;
+        // with a count to the first non-blank of the line holding count
+        // percent of the bytes of the buffer
+        case '%': {
+            if (row == NULL) break;
+            if (ca->count0 == 0) {
+                pos_T pos = { econfig.cy, econfig.cx };
+                if (bracket_find(pos.lnum, &pos.col)
+                    && bracket_match(&pos, 0, econfig.line_count))
+                {
+                    econfig.cy = pos.lnum;
+                    econfig.cx = pos.col;
+                }
+                else if (ca->oap) {
+                    ca->oap->op_type = 0;
+                }
+                break;
+            }
+            if (ca->count0 > 100) break;
+            if (ca->oap) ca->oap->motion_type = MLINE;
+            file_load_finish();
+            colnr_T col;
+            uint64_t total = byteidx_offset(econfig.line_count);
+            econfig.cy = byteidx_find(total * ca->count0 / 100, &col);
+            econfig.cx = 0;
+            skip_blank_chars(row_get(econfig.cy), &econfig.cx);
+            input_clamp_cursor();
+        } break;
+
+        // Jump by start of words (including punctuation)
+        case 'w':
         // Jump by words
         case 'W':
-            nv_wordcmd(SHIFT);
-            break;
-
         // Jump by end of words (including punctuation)
         case 'e':
-            cursor_jump_forward_end_word(SHIFT_NOT_PRESSED);
-            break;
-
         // Jump by end of words
         case 'E':
-            cursor_jump_forward_end_word(SHIFT);
+        // Jump back by start of words (including punctuation)
+        case 'b':
+        // Jump back by start of words
+        case 'B':
+            if (row == NULL) break;
+            ca->arg = isupper(c);
+            nv_wordcmd(ca);
+            break;
+
+        // Jump by paragraphs
+        case '}':
+            nv_paragraph(ca, FORWARD);
+            break;
+        case '{':
+            nv_paragraph(ca, BACKWARD);
             break;
 
         // Replace character under cursor
@@ -337,26 +676,30 @@ nv_process_key(int c)
             replace_char_at_cur(SHIFT);
             break;
 
-        // Jump to character
+        // Jump to character; an operator is cancelled when it is not found
         // before char
         case 't':
-            jump_to_char(c, SHIFT_NOT_PRESSED);
-            break;
-
         case 'T':
-            jump_to_char(c, SHIFT);
-            break;
-
         // at char
         case 'f':
-            jump_to_char(c, SHIFT_NOT_PRESSED);
+        case 'F':
+            if (!jump_to_char(c, isupper(c) ? SHIFT : SHIFT_NOT_PRESSED,
+                              ca->count1)
+                && ca->oap)
+            {
+                ca->oap->op_type = 0;
+            }
             break;
 
-        case 'F':
-            jump_to_char(c, SHIFT);
+        // Put register text after or before the cursor
+        case 'p':
+        case 'P':
+            op_put(ca->oap ? ca->oap->regname : 0,
+                   c == 'p' ? PUT_FORWARD : PUT_BACKWARD, ca->count1);
             break;
 
         case CTRL_KEY('q'):
+            swap_remove_all();
             write(STDOUT_FILENO, "\x1b[2J",
                   4); // clears the screen; check VT100
             write(STDOUT_FILENO, "\x1b[H", 3); // reposition cursor to top
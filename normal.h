@@ -3,13 +3,24 @@
 
 #include <stdbool.h>
 
-typedef enum ShiftStatus { SHIFT, SHIFT_NOT_PRESSED } shift_status_T;
+#include "state.h"
+
+/* @brief Motion flags */
+#define MOTION_LINEWISE  0x01
+#define MOTION_INCLUSIVE 0x02
 
-void fwd_word(bool flag);
-void end_word(bool flag);
+typedef enum ShiftStatus { SHIFT, SHIFT_NOT_PRESSED } shift_status_T;
 
 void replace_char_at_cur(shift_status_T shift_status);
 
-void nv_process_key(int key);
+/**
+ * @brief Get how a motion key selects text for an operator
+ *
+ * @param key Motion key
+ * @return MOTION_LINEWISE and MOTION_INCLUSIVE flags; -1 if not a motion
+ */
+int nv_motion_flags(int key);
+
+void nv_process_key(cmdarg_T *ca);
 
 #endif
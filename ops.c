@@ -0,0 +1,488 @@
+/**
+ * @file ops.c
+ * @author re-nanashi
+ * @brief Operators working on a range of text: yank, delete, change, shift and
+ * put
+ */
+
+#include "ops.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "buffer.h"
+#include "edit.h"
+#include "fold.h"
+#include "input.h"
+#include "register.h"
+#include "screen.h"
+
+// Order start and end then make the end of characterwise text exclusive
+static void
+op_normalize(oparg_T *oap)
+{
+    if (oap->end.lnum < oap->start.lnum
+        || (oap->end.lnum == oap->start.lnum && oap->end.col < oap->start.col))
+    {
+        pos_T tmp = oap->start;
+        oap->start = oap->end;
+        oap->end = tmp;
+    }
+
+    // A block keeps its corners; only the columns are ordered
+    if (oap->motion_type == MBLOCK && oap->end.col < oap->start.col) {
+        colnr_T tmp = oap->start.col;
+        oap->start.col = oap->end.col;
+        oap->end.col = tmp;
+    }
+
+    if (oap->end.lnum >= econfig.line_count)
+        oap->end.lnum = econfig.line_count ? econfig.line_count - 1 : 0;
+
+    // Whole lines take the closed folds at their ends whole
+    if (oap->motion_type == MLINE)
+        fold_extend_range(&oap->start.lnum, &oap->end.lnum);
+
+    if (oap->motion_type == MCHAR && oap->inclusive) {
+        oap->end.col++;
+        oap->inclusive = false;
+    }
+}
+
+// Characters [*from, *to) of a row that are drawn within the block columns
+static void
+op_block_range(const oparg_T *oap, editor_row_T *row, colnr_T *from,
+               colnr_T *to)
+{
+    colnr_T len = rbuf_len(row);
+    *from = row_convert_rx_to_cx(row, oap->start.col);
+    *to = oap->end.col == MAXCOL ? len
+                                 : row_convert_rx_to_cx(row, oap->end.col);
+    if (*to < len) (*to)++;
+    if (*from > *to) *from = *to;
+}
+
+void
+op_visual_range(oparg_T *oap)
+{
+    linenr_T last = econfig.line_count ? econfig.line_count - 1 : 0;
+    oap->start = econfig.visual_start;
+    if (oap->start.lnum > last) oap->start.lnum = last;
+    oap->end.lnum = econfig.cy;
+    oap->end.col = econfig.cx;
+    oap->inclusive = true;
+
+    if (econfig.visual_type == 'V') {
+        oap->motion_type = MLINE;
+    }
+    else if (econfig.visual_type == 'v') {
+        oap->motion_type = MCHAR;
+    }
+    else {
+        // The block spans the screen columns of the characters at both
+        // corners; a tab is taken whole
+        oap->motion_type = MBLOCK;
+        pos_T *corner[2] = { &oap->start, &oap->end };
+        colnr_T left = MAXCOL, right = 0;
+        for (int i = 0; i < 2; i++) {
+            if (econfig.line_count == 0) {
+                left = right = 0;
+                break;
+            }
+            editor_row_T *row = row_get(corner[i]->lnum);
+            colnr_T col = corner[i]->col;
+            colnr_T l = row_convert_cx_to_rx(row, col);
+            colnr_T r = col < rbuf_len(row)
+                            ? (colnr_T)row_convert_cx_to_rx(row, col + 1) - 1
+                            : l;
+            if (l < left) left = l;
+            if (r > right) right = r;
+        }
+        oap->start.col = left;
+        oap->end.col = econfig.visual_eol ? MAXCOL : right;
+    }
+
+    op_normalize(oap);
+}
+
+bool
+op_yank(oparg_T *oap, bool deleting)
+{
+    if (econfig.line_count == 0) return false;
+    op_normalize(oap);
+
+    linenr_T n = oap->end.lnum - oap->start.lnum + 1;
+    yankreg_T *reg = reg_start_yank(oap->regname, deleting, oap->motion_type,
+                                    n);
+    if (reg == NULL) {
+        statusbar_set_message("Invalid register name");
+        return false;
+    }
+
+    // Every line shares the text buffer of its row; nothing is copied
+    for (linenr_T lnum = oap->start.lnum; lnum <= oap->end.lnum; lnum++) {
+        editor_row_T *row = row_get(lnum);
+        colnr_T len = rbuf_len(row);
+        colnr_T from = 0, to = len;
+
+        if (oap->motion_type == MCHAR) {
+            if (lnum == oap->start.lnum) from = oap->start.col;
+            if (lnum == oap->end.lnum) to = oap->end.col;
+            if (to > len) to = len;
+            if (from > to) from = to;
+        }
+        else if (oap->motion_type == MBLOCK) {
+            op_block_range(oap, row, &from, &to);
+        }
+
+        reg_add_line(reg, row, from, to - from);
+    }
+
+    if (!deleting && n > 2) statusbar_set_message("%lu lines yanked", n);
+
+    return true;
+}
+
+// Delete the operated text and put the cursor at its start
+static bool
+op_delete_text(oparg_T *oap)
+{
+    if (!op_yank(oap, true)) return false;
+
+    pos_T start = oap->start, end = oap->end;
+    if (oap->motion_type == MLINE) {
+        row_delete_range(start.lnum, end.lnum - start.lnum + 1);
+        start.col = 0;
+    }
+    else if (oap->motion_type == MBLOCK) {
+        // One gap buffer operation per row; the cursor goes to the top left
+        for (linenr_T lnum = end.lnum + 1; lnum-- > start.lnum;) {
+            editor_row_T *row = row_get(lnum);
+            colnr_T from, to;
+            op_block_range(oap, row, &from, &to);
+            row_delete_chars(row, from, to - from);
+            if (lnum == start.lnum) start.col = from;
+        }
+    }
+    else if (start.lnum == end.lnum) {
+        row_delete_chars(row_get(start.lnum), start.col,
+                         end.col - start.col);
+    }
+    else {
+        // Join the text before the start with the text after the end
+        editor_row_T *last = row_get(end.lnum);
+        size_t len = rbuf_len(last);
+        size_t tail = end.col < len ? len - end.col : 0;
+        char *buf = malloc(tail + 1);
+        rbuf_copy(last, end.col, tail, buf);
+
+        editor_row_T *first = row_get(start.lnum);
+        row_delete_chars(first, start.col, SIZE_MAX);
+        row_insert_str(first, start.col, buf, tail);
+        free(buf);
+
+        row_delete_range(start.lnum + 1, end.lnum - start.lnum);
+    }
+
+    econfig.cy = start.lnum;
+    econfig.cx = start.col;
+    return true;
+}
+
+void
+op_delete(oparg_T *oap)
+{
+    linenr_T n = oap->end.lnum > oap->start.lnum
+                     ? oap->end.lnum - oap->start.lnum + 1
+                     : oap->start.lnum - oap->end.lnum + 1;
+
+    if (op_delete_text(oap) && oap->motion_type == MLINE && n > 2)
+        statusbar_set_message("%lu fewer lines", n);
+    input_clamp_cursor();
+}
+
+void
+op_change(oparg_T *oap)
+{
+    if (!op_delete_text(oap)) return;
+
+    // Changed lines are replaced by a single empty line to insert to
+    if (oap->motion_type == MLINE) row_new(oap->start.lnum, "");
+}
+
+// Index of the first non-blank character of a row
+static colnr_T
+op_first_nonblank(editor_row_T *row)
+{
+    colnr_T len = rbuf_len(row);
+    colnr_T col = 0;
+    while (col < len && isspace(rbuf_char_at(row, col)))
+        col++;
+    return col;
+}
+
+void
+op_shift(oparg_T *oap, int amount)
+{
+    if (econfig.line_count == 0 || amount == 0) return;
+    op_normalize(oap);
+
+    int levels = amount > 0 ? amount : -amount;
+    char *tabs = malloc(levels);
+    memset(tabs, '\t', levels);
+
+    for (linenr_T lnum = oap->start.lnum; lnum <= oap->end.lnum; lnum++) {
+        editor_row_T *row = row_get(lnum);
+        colnr_T len = rbuf_len(row);
+        if (len == 0) continue; // empty lines are not indented
+
+        if (amount > 0) {
+            row_insert_str(row, 0, tabs, levels);
+            continue;
+        }
+
+        // Each level removes a tab or up to a tab stop of spaces
+        colnr_T n = 0;
+        for (int k = 0; k < levels && n < len; k++) {
+            if (rbuf_char_at(row, n) == '\t') {
+                n++;
+                continue;
+            }
+            int spaces = 0;
+            while (spaces < ZEX_TAB_STOP && n < len
+                   && rbuf_char_at(row, n) == ' ')
+            {
+                n++;
+                spaces++;
+            }
+            if (spaces == 0) break;
+        }
+        row_delete_chars(row, 0, n);
+    }
+    free(tabs);
+
+    econfig.cy = oap->start.lnum;
+    econfig.cx = op_first_nonblank(row_get(econfig.cy));
+
+    linenr_T n = oap->end.lnum - oap->start.lnum + 1;
+    if (n > 2)
+        statusbar_set_message("%lu lines %ced %d time%s", n,
+                              amount > 0 ? '>' : '<', levels,
+                              levels == 1 ? "" : "s");
+}
+
+// Index of the character in a row before which text goes into a block at
+// screen column vcol; MAXCOL if an insert skips the row
+static colnr_T
+op_block_col(editor_row_T *row, colnr_T vcol, bool append)
+{
+    if (vcol == MAXCOL) return rbuf_len(row);
+    colnr_T width = row_width(row);
+    if (width >= vcol) return row_convert_rx_to_cx(row, vcol);
+
+    // Lines that end before the block are skipped by an insert and padded
+    // with spaces up to the block by an append
+    if (!append) return MAXCOL;
+    colnr_T n = vcol - width;
+    char *pad = malloc(n);
+    memset(pad, ' ', n);
+    row_insert_str(row, rbuf_len(row), pad, n);
+    free(pad);
+    return rbuf_len(row);
+}
+
+// Screen column of a block that text is inserted at
+static colnr_T
+op_block_vcol(const oparg_T *oap, bool append)
+{
+    if (!append) return oap->start.col;
+    return oap->end.col == MAXCOL ? MAXCOL : oap->end.col + 1;
+}
+
+colnr_T
+op_block_start(const oparg_T *oap, bool append)
+{
+    editor_row_T *row = row_get(oap->start.lnum);
+    colnr_T col = op_block_col(row, op_block_vcol(oap, append), append);
+    return col == MAXCOL ? rbuf_len(row) : col;
+}
+
+void
+op_block_insert(const oparg_T *oap, bool append, const char *s, size_t len)
+{
+    if (len == 0) return;
+
+    colnr_T vcol = op_block_vcol(oap, append);
+    for (linenr_T lnum = oap->start.lnum;
+         lnum <= oap->end.lnum && lnum < econfig.line_count; lnum++)
+    {
+        editor_row_T *row = row_get(lnum);
+        colnr_T at = op_block_col(row, vcol, append);
+        if (at != MAXCOL) row_insert_str(row, at, s, len);
+    }
+}
+
+// Fill a row with the text of a register line; shares the text buffer when
+// the line is a whole row
+static void
+op_put_line(editor_row_T *dst, reg_line_T *line)
+{
+    if (reg_line_is_whole(line)) {
+        rbuf_share(dst, &line->row);
+    }
+    else {
+        char *buf = malloc(line->len + 1);
+        reg_line_copy(line, buf);
+        rbuf_init(dst);
+        dst->render = NULL;
+        rbuf_insertn(dst, buf, line->len);
+        free(buf);
+    }
+    row_update(dst);
+}
+
+// Put whole lines as a single insertion of rows
+static void
+op_put_lines(yankreg_T *reg, int dir, long count)
+{
+    linenr_T at = 0;
+    if (econfig.line_count) at = dir == PUT_FORWARD ? econfig.cy + 1 : econfig.cy;
+
+    editor_row_T *rows = row_open_range(at, reg->count * count);
+    for (long k = 0; k < count; k++)
+        for (linenr_T i = 0; i < reg->count; i++)
+            op_put_line(&rows[k * reg->count + i], &reg->lines[i]);
+
+    econfig.cy = at;
+    econfig.cx = 0;
+}
+
+// Put characters into the cursor row; lines after the first one become new
+// rows and the text after the cursor moves to the end of the last one
+static void
+op_put_chars(yankreg_T *reg, int dir, long count)
+{
+    if (econfig.line_count == 0) row_new(0, "");
+
+    editor_row_T *row = row_get(econfig.cy);
+    colnr_T len = rbuf_len(row);
+    colnr_T col = econfig.cx;
+    if (dir == PUT_FORWARD && len) col++;
+    if (col > len) col = len;
+
+    // Single line; insert the text count times at once
+    if (reg->count == 1) {
+        reg_line_T *line = &reg->lines[0];
+        size_t n = line->len * count;
+        char *buf = malloc(n + 1);
+        for (long k = 0; k < count; k++)
+            reg_line_copy(line, buf + k * line->len);
+        row_insert_str(row, col, buf, n);
+        free(buf);
+
+        econfig.cx = n ? col + n - 1 : col;
+        return;
+    }
+
+    // Cut the text after the cursor
+    size_t tail = len - col;
+    char *tailbuf = malloc(tail + 1);
+    rbuf_copy(row, col, tail, tailbuf);
+    row_delete_chars(row, col, SIZE_MAX);
+
+    // The first line of each repetition joins the last line of the previous
+    // one; the other lines become new rows opened all at once
+    linenr_T nrows = (reg->count - 1) * count;
+    editor_row_T *rows = row_open_range(econfig.cy + 1, nrows);
+    editor_row_T *last = row_get(econfig.cy);
+    linenr_T next = 0;
+    for (long k = 0; k < count; k++) {
+        for (linenr_T i = 0; i < reg->count; i++) {
+            reg_line_T *line = &reg->lines[i];
+            if (i == 0) {
+                char *buf = malloc(line->len + 1);
+                reg_line_copy(line, buf);
+                row_insert_str(last, rbuf_len(last), buf, line->len);
+                free(buf);
+            }
+            else {
+                last = &rows[next++];
+                op_put_line(last, line);
+            }
+        }
+    }
+    row_insert_str(last, rbuf_len(last), tailbuf, tail);
+    free(tailbuf);
+
+    econfig.cx = col;
+}
+
+// Put each line of a block into the rows below the cursor at the same screen
+// column; rows are added at the end of the file when needed
+static void
+op_put_block(yankreg_T *reg, int dir, long count)
+{
+    if (econfig.line_count == 0) row_new(0, "");
+
+    editor_row_T *row = row_get(econfig.cy);
+    colnr_T len = rbuf_len(row);
+    colnr_T col = econfig.cx < len ? econfig.cx : len;
+    if (dir == PUT_FORWARD && len) col++;
+    colnr_T vcol = row_convert_cx_to_rx(row, col);
+
+    // Repetitions are padded to the width of the block
+    colnr_T width = 0;
+    for (linenr_T i = 0; i < reg->count; i++)
+        if (reg->lines[i].len > width) width = reg->lines[i].len;
+
+    while (econfig.cy + reg->count > econfig.line_count)
+        row_new(econfig.line_count, "");
+
+    char *buf = malloc(width * count + vcol + 1);
+    for (linenr_T i = 0; i < reg->count; i++) {
+        reg_line_T *line = &reg->lines[i];
+        row = row_get(econfig.cy + i);
+
+        // Pad lines that end before the column
+        size_t n = 0;
+        colnr_T width = row_width(row);
+        if (width < vcol) {
+            n = vcol - width;
+            memset(buf, ' ', n);
+        }
+        for (long k = 0; k < count; k++) {
+            reg_line_copy(line, buf + n);
+            n += line->len;
+            if (k < count - 1) {
+                memset(buf + n, ' ', width - line->len);
+                n += width - line->len;
+            }
+        }
+        row_insert_str(row, row_convert_rx_to_cx(row, vcol), buf, n);
+    }
+    free(buf);
+
+    econfig.cx = row_convert_rx_to_cx(row_get(econfig.cy), vcol);
+}
+
+void
+op_put(int regname, int dir, long count)
+{
+    yankreg_T *reg = reg_get(regname);
+    if (reg == NULL || reg->count == 0) {
+        statusbar_set_message("Nothing in register %c",
+                              regname ? regname : '"');
+        return;
+    }
+
+    if (reg->type == MLINE)
+        op_put_lines(reg, dir, count);
+    else if (reg->type == MBLOCK)
+        op_put_block(reg, dir, count);
+    else
+        op_put_chars(reg, dir, count);
+    input_clamp_cursor();
+}
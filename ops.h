@@ -0,0 +1,104 @@
+/**
+ * @file ops.h
+ * @author re-nanashi
+ * @brief Header file containing operators working on a range of text
+ */
+
+#ifndef OPS_H
+#define OPS_H
+
+#include <stdbool.h>
+
+#include "state.h"
+
+/* @brief Directions to put register text */
+enum PutDirection { PUT_BACKWARD = -1, PUT_FORWARD = 1 };
+
+/**
+ * @brief Fill operator arguments with the text selected in visual mode
+ *
+ * The range is ordered and its end made exclusive for characterwise text.
+ *
+ * @param oap Pointer to operator arguments
+ */
+void op_visual_range(oparg_T *oap);
+
+/**
+ * @brief Yank the operated text to the register of the operator
+ *
+ * Rows share their text buffer with the register; no text is copied.
+ *
+ * @param oap Pointer to operator arguments
+ * @param deleting True if the text is about to be deleted
+ * @return False if the register name is invalid
+ */
+bool op_yank(oparg_T *oap, bool deleting);
+
+/**
+ * @brief Yank then delete the operated text
+ *
+ * Whole lines are deleted with a single move of the proceeding rows.
+ *
+ * @param oap Pointer to operator arguments
+ */
+void op_delete(oparg_T *oap);
+
+/**
+ * @brief Delete the operated text and leave an empty line for linewise text
+ *
+ * The caller starts insert mode afterwards.
+ *
+ * @param oap Pointer to operator arguments
+ */
+void op_change(oparg_T *oap);
+
+/**
+ * @brief Shift the operated lines by a number of tab stops
+ *
+ * Indenting inserts tabs; unindenting removes a tab or up to a tab stop of
+ * spaces for each level. Empty lines are left alone.
+ *
+ * @param oap Pointer to operator arguments
+ * @param amount Number of levels; positive to indent, negative to unindent
+ */
+void op_shift(oparg_T *oap, int amount);
+
+/**
+ * @brief Get the column of the first line of a block to insert text at
+ *
+ * An append pads the line with spaces when it ends before the block.
+ *
+ * @param oap Pointer to operator arguments of the block
+ * @param append True to insert after the block instead of before it
+ * @return Index of the character to insert before
+ */
+colnr_T op_block_start(const oparg_T *oap, bool append);
+
+/**
+ * @brief Insert text into every line of a block
+ *
+ * Used to repeat the text typed into the first line of a block on the other
+ * lines. An insert skips lines that end before the block; an append pads them
+ * with spaces.
+ *
+ * @param oap Pointer to operator arguments of the block lines
+ * @param append True to insert after the block instead of before it
+ * @param s Text to insert
+ * @param len Length of text
+ */
+void op_block_insert(const oparg_T *oap, bool append, const char *s,
+                     size_t len);
+
+/**
+ * @brief Put the text of a register count times
+ *
+ * Whole lines are put as a single insertion of rows sharing the text buffers
+ * of the register.
+ *
+ * @param regname Register name; 0 for the unnamed register
+ * @param dir PUT_FORWARD to put after the cursor, PUT_BACKWARD before it
+ * @param count Number of times to put the text
+ */
+void op_put(int regname, int dir, long count);
+
+#endif /* OPS_H */
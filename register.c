@@ -0,0 +1,163 @@
+/**
+ * @file register.c
+ * @author re-nanashi
+ * @brief Yank registers sharing text buffers with rows
+ */
+
+#include "register.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+
+/* @brief Internal macros */
+// '0'-'9' then 'a'-'z'
+#define NUM_REGISTERS (10 + 26)
+
+/* @brief All registers */
+static yankreg_T registers[NUM_REGISTERS];
+/* @brief Last written register; read when no name is given */
+static yankreg_T *reg_unnamed = &registers[0];
+
+// Index of a register name or -1 if invalid
+static int
+reg_index(int regname)
+{
+    if (regname >= '0' && regname <= '9') return regname - '0';
+    if (regname >= 'a' && regname <= 'z') return 10 + regname - 'a';
+    if (regname >= 'A' && regname <= 'Z') return 10 + regname - 'A';
+    return -1;
+}
+
+bool
+reg_valid(int regname)
+{
+    return regname == '"' || reg_index(regname) != -1;
+}
+
+yankreg_T *
+reg_get(int regname)
+{
+    if (regname == 0 || regname == '"') return reg_unnamed;
+
+    int i = reg_index(regname);
+    return i == -1 ? NULL : &registers[i];
+}
+
+yankreg_T *
+reg_start_yank(int regname, bool deleting, int type, linenr_T n)
+{
+    if (regname == 0 || regname == '"') regname = deleting ? '1' : '0';
+
+    int i = reg_index(regname);
+    if (i == -1) return NULL;
+    yankreg_T *reg = &registers[i];
+
+    // Uppercase name appends; the register becomes linewise if either part is
+    if (isupper(regname) && reg->count) {
+        if (type == MLINE) reg->type = MLINE;
+    }
+    else {
+        reg_free(reg);
+        reg->type = type;
+    }
+
+    // Make room for all the lines at once
+    reg->lines = realloc(reg->lines, sizeof(reg_line_T) * (reg->count + n));
+
+    reg_unnamed = reg;
+    return reg;
+}
+
+void
+reg_add_line(yankreg_T *reg, editor_row_T *row, colnr_T start, colnr_T len)
+{
+    reg_line_T *line = &reg->lines[reg->count++];
+
+    // Share the text buffer; copied only when either side modifies it
+    rbuf_share(&line->row, row);
+    line->start = start;
+    line->len = len;
+}
+
+bool
+reg_line_is_whole(const reg_line_T *line)
+{
+    return line->start == 0 && line->len == rbuf_len(&line->row);
+}
+
+void
+reg_line_copy(const reg_line_T *line, char *dest)
+{
+    rbuf_copy(&line->row, line->start, line->len, dest);
+}
+
+char *
+reg_get_text(int regname, size_t *len)
+{
+    yankreg_T *reg = reg_get(regname);
+    if (reg == NULL || reg->count == 0) return NULL;
+
+    // Lines are joined by line breaks; whole lines end with one too
+    size_t n = 0;
+    for (linenr_T i = 0; i < reg->count; i++)
+        n += reg->lines[i].len + 1;
+
+    char *text = malloc(n + 1);
+    n = 0;
+    for (linenr_T i = 0; i < reg->count; i++) {
+        reg_line_copy(&reg->lines[i], text + n);
+        n += reg->lines[i].len;
+        if (i < reg->count - 1 || reg->type == MLINE) text[n++] = '\n';
+    }
+    text[n] = '\0';
+
+    *len = n;
+    return text;
+}
+
+bool
+reg_set_text(int regname, const char *s, size_t len)
+{
+    int i = reg_index(regname);
+    if (i == -1) return false;
+    yankreg_T *reg = &registers[i];
+
+    // Uppercase name appends to the last line of the register
+    char *text = NULL;
+    size_t n = 0;
+    if (isupper(regname) && reg->count) {
+        text = reg_get_text(regname, &n);
+        if (reg->type == MLINE) n--;
+    }
+    text = realloc(text, n + len + 1);
+    memcpy(text + n, s, len);
+    n += len;
+
+    editor_row_T row;
+    rbuf_init(&row);
+    row.render = NULL;
+    rbuf_insertn(&row, text, n);
+    free(text);
+
+    reg_free(reg);
+    reg->type = MCHAR;
+    reg->lines = malloc(sizeof(reg_line_T));
+    reg_add_line(reg, &row, 0, n);
+    rbuf_destroy(&row);
+
+    return true;
+}
+
+void
+reg_free(yankreg_T *reg)
+{
+    for (linenr_T i = 0; i < reg->count; i++)
+        rbuf_destroy(&reg->lines[i].row);
+
+    free(reg->lines);
+    reg->lines = NULL;
+    reg->count = 0;
+}
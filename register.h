@@ -0,0 +1,119 @@
+/**
+ * @file register.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for yank registers
+ */
+
+#ifndef REGISTER_H
+#define REGISTER_H
+
+#include <stdbool.h>
+
+#include "config.h"
+
+/* @brief A line of register text */
+typedef struct reg_line {
+    /* row sharing the text buffer of the row it was yanked from */
+    editor_row_T row;
+    /* index of the first character of the row that belongs to the line */
+    colnr_T start;
+    /* number of characters of the row that belong to the line */
+    colnr_T len;
+} reg_line_T;
+
+/* @brief Register contents */
+typedef struct yankreg {
+    /* lines of text */
+    reg_line_T *lines;
+    /* number of lines */
+    linenr_T count;
+    /* MCHAR for characters, MLINE for whole lines or MBLOCK for a block */
+    int type;
+} yankreg_T;
+
+/**
+ * @brief Check if a register name can be used
+ *
+ * Valid names are '"' (unnamed), '0'-'9', 'a'-'z' and 'A'-'Z' to append to
+ * 'a'-'z'.
+ *
+ * @param regname Register name
+ */
+bool reg_valid(int regname);
+
+/**
+ * @brief Get the register to read from
+ *
+ * @param regname Register name; 0 or '"' for the last written register
+ * @return Pointer to register or NULL if invalid
+ */
+yankreg_T *reg_get(int regname);
+
+/**
+ * @brief Start writing to a register
+ *
+ * Clears the register unless the name is uppercase, then makes it the
+ * unnamed register. Without a name, yanks go to "0 and deletes go to "1.
+ *
+ * @param regname Register name; 0 if none was given
+ * @param deleting True if the text is being deleted
+ * @param type MCHAR, MLINE or MBLOCK
+ * @param n Number of lines that will be added
+ * @return Pointer to register or NULL if invalid
+ */
+yankreg_T *reg_start_yank(int regname, bool deleting, int type, linenr_T n);
+
+/**
+ * @brief Add a line to the register without copying its text
+ *
+ * @param reg Pointer to register
+ * @param row Pointer to row; its text buffer becomes shared
+ * @param start Index of the first character
+ * @param len Number of characters
+ */
+void reg_add_line(yankreg_T *reg, editor_row_T *row, colnr_T start, colnr_T len);
+
+/**
+ * @brief Check if a register line covers the whole row it was yanked from
+ *
+ * @param line Pointer to register line
+ */
+bool reg_line_is_whole(const reg_line_T *line);
+
+/**
+ * @brief Copy the text of a register line
+ *
+ * @param line Pointer to register line
+ * @param dest Destination of at least line->len characters; not terminated
+ */
+void reg_line_copy(const reg_line_T *line, char *dest);
+
+/**
+ * @brief Get the text of a register as a string
+ *
+ * @param regname Register name; 0 or '"' for the last written register
+ * @param len Return: length of the text
+ * @return Newly allocated text or NULL if the register is empty
+ */
+char *reg_get_text(int regname, size_t *len);
+
+/**
+ * @brief Set the text of a register without making it the unnamed register
+ *
+ * Used to store recorded keys. An uppercase name appends to the register.
+ *
+ * @param regname Register name
+ * @param s Text
+ * @param len Length of text
+ * @return False if the register name is invalid
+ */
+bool reg_set_text(int regname, const char *s, size_t len);
+
+/**
+ * @brief Free the lines of a register
+ *
+ * @param reg Pointer to register
+ */
+void reg_free(yankreg_T *reg);
+
+#endif /* REGISTER_H */
@@ -6,28 +6,71 @@
 
 #include "screen.h"
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdbool.h>
+#include <pthread.h>
 
 #include "config.h"
 #include "terminal.h"
 #include "logger.h"
 #include "edit.h"
 #include "state.h"
+#include "buffer.h"
+#include "input.h"
+#include "ops.h"
+#include "buflist.h"
+#include "bracket.h"
+#include "byteidx.h"
+#include "cold.h"
+#include "fold.h"
+#include "win.h"
+
+/* @brief Internal macros */
+// Longest run of cells worth rewriting instead of a cursor motion sequence
+#define MOTION_OVERWRITE_MAX 8
+
+/* @brief Frame currently shown by the terminal */
+static screen_frame_T screen_shown;
+/* @brief Row offset of the text shown by the terminal and the screen lines
+ * of its top row not shown when rows wrap */
+static linenr_T screen_shown_row_offset, screen_shown_skip;
+/* @brief Screen lines of the top row of the current window not shown; its
+ * cursor is on a row taller than the window */
+static linenr_T screen_skip;
+/* @brief Position of the cursor within the text of the current window */
+static int screen_text_row, screen_text_col;
+/* @brief Cursor position the last frame left on the terminal */
+static int screen_cursor_row = -1, screen_cursor_col = -1;
+/* @brief Terminal output accounting */
+static screen_stats_T screen_stats;
+/* @brief Guards the shown frame and the resize flag */
+static pthread_mutex_t screen_lock = PTHREAD_MUTEX_INITIALIZER;
+/* @brief Set by the resize thread; the main thread draws the screen again
+ * for the new size */
+static bool screen_resized;
 
 void
 write_to_abuf(append_buf_T *ab, const char *s, int len)
 {
-    // Reallocate new size of append buffer
-    char *new = realloc(ab->b, ab->len + len);
-    if (new == NULL) return;
+    // Reallocate new size of append buffer; grow by doubling so that frames
+    // written a few bytes at a time don't reallocate on every write
+    if (ab->len + len > ab->cap) {
+        int cap = ab->cap ? ab->cap : 1024;
+        while (cap < ab->len + len)
+            cap *= 2;
+        char *new = realloc(ab->b, cap);
+        if (new == NULL) return;
+        ab->b = new;
+        ab->cap = cap;
+    }
 
-    // Assign new append buffer
-    memcpy(&new[ab->len], s, len);
-    ab->b = new;
+    // Append to the buffer
+    memcpy(&ab->b[ab->len], s, len);
     ab->len += len;
 }
 
@@ -37,6 +80,377 @@ free_abuf(append_buf_T *ab)
     free(ab->b);
 }
 
+// Append the SGR parameter of a single attribute to the parameter list
+static int
+sgr_add_param(char *buf, int len, int param)
+{
+    return len + sprintf(buf + len, len ? ";%d" : "%d", param);
+}
+
+// Build the SGR parameters that switch the terminal from attributes `from`
+// to `to` without resetting the attributes that are shared by both
+static int
+sgr_delta_params(char *buf, screen_attr_T from, screen_attr_T to)
+{
+    static const struct {
+        screen_attr_T flag;
+        int on, off;
+    } flags[] = { { ATTR_BOLD, 1, 22 },
+                  { ATTR_UNDERLINE, 4, 24 },
+                  { ATTR_REVERSE, 7, 27 } };
+
+    int len = 0;
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        if ((from & flags[i].flag) == (to & flags[i].flag)) continue;
+        len = sgr_add_param(buf, len,
+                            to & flags[i].flag ? flags[i].on : flags[i].off);
+    }
+
+    if (ATTR_FG_OF(from) != ATTR_FG_OF(to))
+        len = sgr_add_param(buf, len,
+                            ATTR_FG_OF(to) ? 29 + (int)ATTR_FG_OF(to) : 39);
+    if (ATTR_BG_OF(from) != ATTR_BG_OF(to))
+        len = sgr_add_param(buf, len,
+                            ATTR_BG_OF(to) ? 39 + (int)ATTR_BG_OF(to) : 49);
+
+    return len;
+}
+
+void
+abuf_set_attr(append_buf_T *ab, screen_attr_T attr)
+{
+    if (ab->attr == attr) return;
+
+    // Either switch only the differing attributes or reset everything (empty
+    // parameter) then set the new attributes; whichever is shorter
+    char delta[64], reset[64];
+    int dlen = sgr_delta_params(delta, ab->attr, attr);
+    int rlen = sgr_delta_params(reset, ATTR_NORMAL, attr);
+    const char *params = delta;
+    if (rlen + (rlen ? 1 : 0) < dlen) {
+        // ";" after the reset is the separator for the new attributes
+        memmove(reset + 1, reset, rlen + 1);
+        reset[0] = ';';
+        params = rlen ? reset : "";
+    }
+
+    char buf[80];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%sm", params);
+    write_to_abuf(ab, buf, len);
+    ab->attr = attr;
+}
+
+// Erase to end of current row; the terminal fills the erased cells with the
+// current background so only background affecting attributes are cleared
+static void
+abuf_erase_eol(append_buf_T *ab)
+{
+    if (ATTR_BG_OF(ab->attr) || (ab->attr & ATTR_REVERSE))
+        abuf_set_attr(ab, ab->attr & ~(ATTR_REVERSE | ATTR_BG_MASK));
+    write_to_abuf(ab, "\x1b[K", 3);
+}
+
+void
+frame_init(screen_frame_T *f, int rows, int cols)
+{
+    f->rows = rows;
+    f->cols = cols;
+    f->cells = malloc(sizeof(screen_cell_T) * rows * cols);
+
+    // Blank cells are spaces with no attributes
+    for (int i = 0; i < rows * cols; i++) {
+        f->cells[i].ch = ' ';
+        f->cells[i].attr = ATTR_NORMAL;
+    }
+}
+
+void
+frame_free(screen_frame_T *f)
+{
+    free(f->cells);
+    f->cells = NULL;
+}
+
+int
+frame_draw_str(screen_frame_T *f,
+               int row,
+               int col,
+               const char *s,
+               int len,
+               screen_attr_T attr)
+{
+    if (row < 0 || row >= f->rows) return col;
+
+    screen_cell_T *cell = &f->cells[row * f->cols];
+    for (int i = 0; i < len && col < f->cols; i++, col++) {
+        cell[col].ch = s[i];
+        cell[col].attr = attr;
+    }
+
+    return col;
+}
+
+// Cost in bytes of moving the cursor horizontally within a row by writing
+// the characters the cells should show anyway; -1 if not possible because
+// the cells need different attributes than the current ones
+static int
+overwrite_cost(const append_buf_T *ab,
+               const screen_frame_T *f,
+               int row,
+               int from,
+               int to)
+{
+    if (to - from > MOTION_OVERWRITE_MAX) return -1;
+
+    const screen_cell_T *cell = &f->cells[row * f->cols];
+    for (int c = from; c < to; c++)
+        if (cell[c].attr != ab->attr) return -1;
+    return to - from;
+}
+
+// Write horizontal relative motion from col `from` to col `to` to buf
+static int
+motion_horizontal(char *buf, int from, int to)
+{
+    if (to == from) return 0;
+    if (to > from) {
+        int n = to - from;
+        return n == 1 ? sprintf(buf, "\x1b[C") : sprintf(buf, "\x1b[%dC", n);
+    }
+
+    // Backspace moves the cursor one col to the left
+    int n = from - to;
+    if (n <= 3) return sprintf(buf, "%.*s", n, "\b\b\b");
+    return sprintf(buf, "\x1b[%dD", n);
+}
+
+// Write vertical relative motion from row `from` to row `to` to buf
+static int
+motion_vertical(char *buf, int from, int to)
+{
+    if (to == from) return 0;
+    if (to > from) {
+        // Line feed moves the cursor one row down; raw mode disables OPOST so
+        // it doesn't return the carriage
+        int n = to - from;
+        if (n <= 3) return sprintf(buf, "%.*s", n, "\n\n\n");
+        return sprintf(buf, "\x1b[%dB", n);
+    }
+
+    int n = from - to;
+    return n == 1 ? sprintf(buf, "\x1b[A") : sprintf(buf, "\x1b[%dA", n);
+}
+
+void
+abuf_move_cursor(append_buf_T *ab, const screen_frame_T *f, int row, int col)
+{
+    if (ab->row == row && ab->col == col) return;
+
+    // Absolute position (CUP); always possible
+    char best[64], buf[64];
+    int bestlen;
+    if (row == 0 && col == 0)
+        bestlen = sprintf(best, "\x1b[H");
+    else if (col == 0)
+        bestlen = sprintf(best, "\x1b[%dH", row + 1);
+    else
+        bestlen = sprintf(best, "\x1b[%d;%dH", row + 1, col + 1);
+
+    int overwrite_from = -1;
+    if (ab->row >= 0) {
+        int vlen = motion_vertical(buf, ab->row, row);
+
+        // Relative motion from the current col (CUU/CUD/CUF/CUB) or by
+        // writing over the cells in between
+        if (ab->col >= 0) {
+            int ow = col > ab->col ? overwrite_cost(ab, f, row, ab->col, col)
+                                   : -1;
+            int hlen = motion_horizontal(buf + vlen, ab->col, col);
+            if (ow >= 0 && ow < hlen) hlen = ow;
+            if (vlen + hlen < bestlen) {
+                bestlen = vlen + hlen;
+                overwrite_from = hlen == ow ? ab->col : -1;
+                memcpy(best, buf, bestlen);
+            }
+        }
+
+        // Carriage return then relative motion from the first col
+        buf[vlen] = '\r';
+        int ow = overwrite_cost(ab, f, row, 0, col);
+        int hlen = motion_horizontal(buf + vlen + 1, 0, col);
+        if (ow >= 0 && ow < hlen) hlen = ow;
+        if (vlen + 1 + hlen < bestlen) {
+            bestlen = vlen + 1 + hlen;
+            overwrite_from = hlen == ow && col > 0 ? 0 : -1;
+            memcpy(best, buf, bestlen);
+        }
+    }
+
+    if (overwrite_from >= 0) {
+        // Motion string holds only the vertical part; the text follows
+        int keep = bestlen - (col - overwrite_from);
+        write_to_abuf(ab, best, keep);
+        for (int c = overwrite_from; c < col; c++)
+            write_to_abuf(ab, &f->cells[row * f->cols + c].ch, 1);
+    }
+    else {
+        write_to_abuf(ab, best, bestlen);
+    }
+
+    ab->row = row;
+    ab->col = col;
+}
+
+// Write cells [from, to) of a row then record them as shown
+static void
+abuf_write_cells(append_buf_T *ab,
+                 screen_frame_T *shown,
+                 const screen_frame_T *f,
+                 int row,
+                 int from,
+                 int to)
+{
+    const screen_cell_T *cell = &f->cells[row * f->cols];
+    abuf_move_cursor(ab, f, row, from);
+    for (int c = from; c < to; c++) {
+        abuf_set_attr(ab, cell[c].attr);
+        write_to_abuf(ab, &cell[c].ch, 1);
+    }
+    memcpy(&shown->cells[row * f->cols + from], &cell[from],
+           sizeof(screen_cell_T) * (to - from));
+
+    // The cursor stays at the last col after writing to it; its position is
+    // not reliable until moved again (pending wrap)
+    ab->col = to < f->cols ? to : -1;
+}
+
+// Number of cells of a row before its trailing blanks
+static int
+frame_row_end(const screen_frame_T *f, int row)
+{
+    const screen_cell_T *cell = &f->cells[row * f->cols];
+    int end = f->cols;
+    while (end > 0 && cell[end - 1].ch == ' '
+           && cell[end - 1].attr == ATTR_NORMAL)
+        end--;
+    return end;
+}
+
+static bool
+cell_equal(const screen_cell_T *a, const screen_cell_T *b)
+{
+    return a->ch == b->ch && a->attr == b->attr;
+}
+
+void
+frame_update_to_abuf(append_buf_T *ab,
+                     screen_frame_T *shown,
+                     const screen_frame_T *f)
+{
+    for (int r = 0; r < f->rows; r++) {
+        const screen_cell_T *cell = &f->cells[r * f->cols];
+        const screen_cell_T *old = &shown->cells[r * f->cols];
+
+        // Trailing blanks are erased instead of written
+        int end = frame_row_end(f, r);
+        int old_end = frame_row_end(shown, r);
+
+        // Write every span of changed cells; the cursor planner writes over
+        // unchanged cells in between when that is cheaper than moving
+        int c = 0;
+        while (c < end) {
+            if (cell_equal(&cell[c], &old[c])) {
+                c++;
+                continue;
+            }
+
+            int span = c;
+            while (span < end && !cell_equal(&cell[span], &old[span]))
+                span++;
+            abuf_write_cells(ab, shown, f, r, c, span);
+            c = span;
+        }
+
+        if (old_end > end) {
+            abuf_move_cursor(ab, f, r, end);
+            abuf_erase_eol(ab);
+            for (c = end; c < f->cols; c++)
+                shown->cells[r * f->cols + c] = cell[c];
+        }
+    }
+
+    // Leave the terminal with no attributes for the next frame
+    abuf_set_attr(ab, ATTR_NORMAL);
+}
+
+linenr_T
+screen_row_lines(const editor_row_T *row, int cols)
+{
+    colnr_T width = row_width(row);
+    return width ? (width + cols - 1) / cols : 1;
+}
+
+// Line shown after a line of the current buffer in a window; a closed fold
+// is skipped whole
+static linenr_T
+screen_next_line(const win_T *wp, linenr_T lnum)
+{
+    linenr_T bot;
+    return fold_closed(wp, lnum, NULL, &bot) ? bot + 1 : lnum + 1;
+}
+
+// Screen lines a line of the current buffer takes in a window when rows
+// wrap; a closed fold takes one
+static linenr_T
+screen_shown_lines(const win_T *wp, linenr_T lnum, int cols)
+{
+    if (fold_closed(wp, lnum, NULL, NULL)) return 1;
+    return screen_row_lines(row_get(lnum), cols);
+}
+
+// Scroll the current window so that the screen line of the cursor is shown;
+// only the lines shown between the top of the window and the cursor are
+// measured
+static void
+screen_scroll_wrapped(linenr_T cur, bool folded)
+{
+    win_T *wp = win_current();
+    int rows = econfig.screenrows, cols = econfig.screencols;
+    econfig.col_offset = 0;
+
+    // The cursor past the end of a row whose width is a multiple of the
+    // window width stays on its last cell
+    linenr_T line = folded ? 0 : econfig.rx / cols;
+    int col = folded ? 0 : econfig.rx % cols;
+    if (cur < econfig.line_count) {
+        linenr_T lines = screen_shown_lines(wp, cur, cols);
+        if (line >= lines) {
+            line = lines - 1;
+            col = cols - 1;
+        }
+    }
+
+    // Every shown line takes a screen line at least
+    if (cur < econfig.row_offset) econfig.row_offset = cur;
+    fold_closed(wp, econfig.row_offset, &econfig.row_offset, NULL);
+    if (fold_count_shown(wp, econfig.row_offset, cur) >= (linenr_T)rows)
+        econfig.row_offset = fold_move(wp, cur, -(rows - 1));
+
+    linenr_T above = 0;
+    for (linenr_T l = econfig.row_offset; l < cur; l = screen_next_line(wp, l))
+        above += screen_shown_lines(wp, l, cols);
+    while (econfig.row_offset < cur && above + line >= (linenr_T)rows) {
+        above -= screen_shown_lines(wp, econfig.row_offset, cols);
+        econfig.row_offset = screen_next_line(wp, econfig.row_offset);
+    }
+
+    // A row taller than the window shows the screen lines up to the cursor
+    screen_skip = above + line >= (linenr_T)rows ? line - rows + 1 : 0;
+    screen_text_row = above + line - screen_skip;
+    screen_text_col = col;
+}
+
 void
 screen_scroll_handler()
 {
@@ -49,9 +463,19 @@ screen_scroll_handler()
         // When string goes past the screencols we will convert mouse pos(state)
         // to the position of the the rendered character that was offsetted
         econfig.rx =
-            row_convert_cx_to_rx(&econfig.rows[econfig.cy], econfig.cx);
+            row_convert_cx_to_rx(row_get(econfig.cy), econfig.cx);
     }
 
+    // A cursor in a closed fold is shown on the line of the fold
+    win_T *wp = win_current();
+    linenr_T cur = econfig.cy;
+    bool folded = fold_closed(wp, cur, &cur, NULL);
+    if (econfig.wrap) {
+        screen_scroll_wrapped(cur, folded);
+        return;
+    }
+    screen_skip = 0;
+
     if (econfig.rx < econfig.col_offset) {
         econfig.col_offset = econfig.rx;
     }
@@ -60,18 +484,27 @@ screen_scroll_handler()
         econfig.col_offset = econfig.rx - econfig.screencols + 1;
     }
 
-    // Vertical scrolling
-    if (econfig.cy < econfig.row_offset) {
-        econfig.row_offset = econfig.cy;
+    // Vertical scrolling; by shown lines, a closed fold is one
+    if (cur < econfig.row_offset) {
+        econfig.row_offset = cur;
     }
+    fold_closed(wp, econfig.row_offset, &econfig.row_offset, NULL);
 
-    if (econfig.cy >= econfig.row_offset + econfig.screenrows) {
-        econfig.row_offset = econfig.cy - econfig.screenrows + 1;
+    if (fold_count_shown(wp, econfig.row_offset, cur)
+        >= (linenr_T)econfig.screenrows)
+    {
+        econfig.row_offset = fold_move(wp, cur, -(econfig.screenrows - 1));
     }
+
+    screen_text_row = fold_count_shown(wp, econfig.row_offset, cur);
+    screen_text_col = folded ? 0 : econfig.rx - econfig.col_offset;
 }
 
 void
-screen_draw_welcome_message(struct append_buf *ab, const char *format, ...)
+screen_draw_welcome_message(screen_frame_T *f,
+                            int row,
+                            const char *format,
+                            ...)
 {
     // Copy string to temporary buffer
     va_list args;
@@ -83,103 +516,373 @@ screen_draw_welcome_message(struct append_buf *ab, const char *format, ...)
     va_end(args);
 
     // Apply padding
-    if (buflen > econfig.screencols) buflen = econfig.screencols;
-    int padding = (econfig.screencols - buflen) / 2;
+    if (buflen > f->cols) buflen = f->cols;
+    int padding = (f->cols - buflen) / 2;
 
-    if (padding) {
-        write_to_abuf(ab, "~", 1);
-        padding--;
+    if (padding) frame_draw_str(f, row, 0, "~", 1, ATTR_FG(COLOR_BLUE));
+
+    // Draw temp buffer to the frame
+    frame_draw_str(f, row, padding, buf, buflen, ATTR_NORMAL);
+}
+
+// Highlight the selected part of a text row; the selected screen columns are
+// computed from the visual range then shifted by the screen column shown
+// first on the row
+static void
+screen_draw_selection(screen_frame_T *f, int row, linenr_T lnum,
+                      colnr_T left, const oparg_T *va)
+{
+    if (lnum < va->start.lnum || lnum > va->end.lnum) return;
+
+    editor_row_T *erow = row_get(lnum);
+    colnr_T from = 0, to = row_width(erow);
+    if (va->motion_type == MCHAR) {
+        if (lnum == va->start.lnum)
+            from = row_convert_cx_to_rx(erow, va->start.col);
+        if (lnum == va->end.lnum)
+            to = row_convert_cx_to_rx(erow, va->end.col);
+        else
+            to++; // the line break is selected too
+    }
+    else if (va->motion_type == MBLOCK) {
+        from = va->start.col;
+        if (va->end.col != MAXCOL) to = va->end.col + 1;
     }
-    while (padding--)
-        write_to_abuf(ab, " ", 1);
+    // An empty selected line still shows one cell
+    if (to <= from && va->motion_type != MBLOCK) to = from + 1;
 
-    // Write temp buffer to append buffer
-    write_to_abuf(ab, buf, buflen);
+    screen_cell_T *cell = &f->cells[row * f->cols];
+    for (colnr_T col = from; col < to; col++) {
+        if (col < left) continue;
+        if (col - left >= (colnr_T)f->cols) break;
+        cell[col - left].attr |= ATTR_REVERSE;
+    }
 }
 
-void
-screen_draw_rows(struct append_buf *ab)
+// Show the bracket under the cursor and the one matching it in a window of
+// the current buffer; only the shown lines are searched
+static void
+screen_draw_match(screen_frame_T *f, const win_T *wp)
 {
-    int i;
-    int welcome_message_row = econfig.screenrows / 3;
+    pos_T match = { econfig.cy, econfig.cx };
+    if (!bracket_match(&match, econfig.row_offset, wp->cache_bot)) return;
 
-    for (i = 0; i < econfig.screenrows; i++) {
-        size_t filerow = i + econfig.row_offset;
+    pos_T ends[2] = { { econfig.cy, econfig.cx }, match };
+    size_t filerow = econfig.row_offset;
+    linenr_T part = screen_skip, fold_bot;
+    for (int i = 0; i < f->rows && filerow < econfig.line_count; i++) {
+        if (fold_closed(wp, filerow, NULL, &fold_bot)) {
+            filerow = fold_bot + 1;
+            continue;
+        }
+
+        editor_row_T *erow = row_get(filerow);
+        colnr_T left = econfig.wrap ? part * f->cols : econfig.col_offset;
+        for (int e = 0; e < 2; e++) {
+            if (ends[e].lnum != filerow) continue;
+            colnr_T col = row_convert_cx_to_rx(erow, ends[e].col);
+            if (col < left || col - left >= (colnr_T)f->cols) continue;
+            screen_cell_T *cell = &f->cells[i * f->cols + col - left];
+            cell->attr = (cell->attr & ~ATTR_BG_MASK) | ATTR_BG(COLOR_CYAN);
+        }
 
+        if (econfig.wrap && ++part < screen_row_lines(erow, f->cols))
+            continue;
+        part = 0;
+        filerow++;
+    }
+}
+
+// Draw the line of a closed fold; a dash for each level, the number of lines
+// it holds and the text of its first line, filled up with dashes
+static void
+screen_draw_fold(screen_frame_T *f, int row, const editor_row_T *erow,
+                 int level, linenr_T lines)
+{
+    char head[64];
+    int len = snprintf(head, sizeof(head), "+-%.*s%3lu line%s: ",
+                       level < 20 ? level : 20, "--------------------",
+                       lines, lines == 1 ? "" : "s");
+    int col = frame_draw_str(f, row, 0, head, len, ATTR_FG(COLOR_CYAN));
+
+    // The indent of the text is left out; a tab is a space
+    colnr_T len_text = rbuf_len(erow), start = 0;
+    while (start < len_text && isblank(rbuf_char_at(erow, start)))
+        start++;
+    char *text = malloc(f->cols);
+    size_t n = rbuf_copy(erow, start, f->cols, text);
+    for (size_t i = 0; i < n; i++)
+        if (text[i] == '\t') text[i] = ' ';
+    col = frame_draw_str(f, row, col, text, n, ATTR_FG(COLOR_CYAN));
+    free(text);
+    while (col < f->cols)
+        col = frame_draw_str(f, row, col, "-", 1, ATTR_FG(COLOR_CYAN));
+}
+
+// Copy a frame onto part of a bigger one
+static void
+frame_blit(screen_frame_T *f, const screen_frame_T *part, int row, int col)
+{
+    for (int r = 0; r < part->rows && row + r < f->rows; r++) {
+        int n = part->cols;
+        if (col + n > f->cols) n = f->cols - col;
+        if (n <= 0) break;
+        memcpy(&f->cells[(row + r) * f->cols + col],
+               &part->cells[r * part->cols], sizeof(screen_cell_T) * n);
+    }
+}
+
+// Draw the text area of a window to a frame of its size. The drawn cells are
+// kept by the window and copied again until an edit touches the lines it
+// shows or the view changes
+static void
+screen_draw_window(screen_frame_T *t, win_T *wp)
+{
+    bool current = wp == win_current();
+    int buf = wp->buf;
+    linenr_T top = current ? econfig.row_offset : wp->row_offset;
+    colnr_T left = current ? econfig.col_offset : wp->col_offset;
+    linenr_T skip = current ? screen_skip : 0;
+    long cache_skip = econfig.wrap ? (long)skip : -1;
+
+    size_t cells = sizeof(screen_cell_T) * t->rows * t->cols;
+    if (wp->cache_valid && wp->cache_buf == buf && wp->cache_top == top
+        && wp->cache_left == left && wp->cache_skip == cache_skip
+        && wp->cache_height == t->rows && wp->cache_width == t->cols)
+    {
+        memcpy(t->cells, wp->cache, cells);
+        return;
+    }
+
+    // Every window of the current buffer shows the rows of the editor
+    const editor_row_T *rows = econfig.rows;
+    linenr_T line_count = econfig.line_count;
+    if (buf != buflist_current()) {
+        const filebuf_T *fb = buflist_get(buf);
+        rows = fb->rows;
+        line_count = fb->line_count;
+    }
+    bool current_buf = buf == buflist_current();
+
+    int welcome_message_row = t->rows / 3;
+    bool eof = false;
+    char *cols = NULL;
+    size_t filerow = top;
+    linenr_T part = skip, fold_bot;
+    for (int i = 0; i < t->rows; i++) {
         // Length of text file does not exceed editor height
-        if (filerow >= econfig.line_count) {
-            if (econfig.line_count == 0 && i == welcome_message_row) {
-                screen_draw_welcome_message(ab, "ZEX editor v%s", ZEX_VERSION);
+        if (filerow >= line_count) {
+            eof = true;
+            if (line_count == 0 && win_count() == 1
+                && i == welcome_message_row)
+            {
+                screen_draw_welcome_message(t, i, "ZEX editor v%s",
+                                            ZEX_VERSION);
             }
-            else if (econfig.line_count == 0 && i == welcome_message_row + 2) {
+            else if (line_count == 0 && win_count() == 1
+                     && i == welcome_message_row + 2)
+            {
                 screen_draw_welcome_message(
-                    ab, "ZEX is open source and freely distributable");
+                    t, i, "ZEX is open source and freely distributable");
             }
             else {
-                write_to_abuf(ab, "~", 1);
+                frame_draw_str(t, i, 0, "~", 1, ATTR_FG(COLOR_BLUE));
             }
+            continue;
         }
-        // Draw text from file to editor
-        else {
-            int len = econfig.rows[filerow].rsize - econfig.col_offset;
-            if (len < 0) len = 0;
-            if (len > econfig.screencols) len = econfig.screencols;
-            write_to_abuf(ab, &econfig.rows[filerow].render[econfig.col_offset],
-                          len);
+
+        // Shown rows of the current buffer are unpacked; the other buffers
+        // were left with the rows of their windows unpacked
+        if (current_buf) cold_thaw(&econfig.rows[filerow]);
+
+        // A closed fold is one line
+        int level = fold_closed(wp, filerow, NULL, &fold_bot);
+        if (level) {
+            screen_draw_fold(t, i, &rows[filerow], level,
+                             fold_bot - filerow + 1);
+            filerow = fold_bot + 1;
+            continue;
         }
 
-        write_to_abuf(ab, "\x1b[K", 3); // erase to end of current row
-        write_to_abuf(ab, "\r\n", 2);
+        // A wrapped row takes screen lines until all of it is shown
+        if (econfig.wrap) {
+            if (cols == NULL) cols = malloc(t->cols);
+            colnr_T n = row_render_cols(&rows[filerow], part * t->cols,
+                                        t->cols, cols);
+            frame_draw_str(t, i, 0, cols, n, ATTR_NORMAL);
+            if (++part < screen_row_lines(&rows[filerow], t->cols)) continue;
+            part = 0;
+        }
+        // Only the columns shown of a long row are expanded
+        else if (row_is_long(&rows[filerow])) {
+            if (cols == NULL) cols = malloc(t->cols);
+            colnr_T n = row_render_cols(&rows[filerow], left, t->cols, cols);
+            frame_draw_str(t, i, 0, cols, n, ATTR_NORMAL);
+        }
+        // Draw text from file to editor
+        else if (rows[filerow].rsize > left) {
+            frame_draw_str(t, i, 0, &rows[filerow].render[left],
+                           rows[filerow].rsize - left, ATTR_NORMAL);
+        }
+        filerow++;
     }
+    free(cols);
+
+    wp->cache = realloc(wp->cache, cells);
+    memcpy(wp->cache, t->cells, cells);
+    wp->cache_buf = buf;
+    wp->cache_top = top;
+    wp->cache_left = left;
+    wp->cache_skip = cache_skip;
+    wp->cache_bot = part ? filerow + 1 : filerow;
+    wp->cache_eof = eof;
+    wp->cache_height = t->rows;
+    wp->cache_width = t->cols;
+    wp->cache_valid = true;
 }
 
 void
-screen_draw_status_bar(struct append_buf *ab)
+screen_draw_rows(screen_frame_T *f)
 {
-    // Draw bar by inverting color (see Select Graphic Rendition)
-    write_to_abuf(ab, "\x1b[7m", 4); // m command
-
-    // Get the current mode
-    const char *curmode = get_mode(econfig.mode);
-
-    char status[80], rstatus[80];
-    int len =
-        snprintf(status, sizeof(status), " %.20s - %.20s - %d lines %s",
-                 curmode, econfig.filename ? econfig.filename : "[No Name]",
-                 (int)econfig.line_count, econfig.dirty ? "(modified)" : "");
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%lu:%lu",
-                        econfig.line_count > 0 ? econfig.cy + 1 : econfig.cy,
-                        econfig.cx + 1);
-
-    // Draw status text to editor
-    if (len > econfig.screencols) len = econfig.screencols;
-    write_to_abuf(ab, status, len);
-    while (len < econfig.screencols) {
-        if (econfig.screencols - len == rlen) {
-            write_to_abuf(ab, rstatus, rlen);
-            break;
+    oparg_T va = { 0 };
+    if (econfig.visual_type) op_visual_range(&va);
+
+    for (int w = 0; w < win_count(); w++) {
+        win_T *wp = win_get(w);
+        if (wp->height <= 0 || wp->width <= 0) continue;
+
+        screen_frame_T t;
+        frame_init(&t, wp->height, wp->width);
+        screen_draw_window(&t, wp);
+
+        // The selection is drawn over the cached text
+        if (econfig.visual_type && wp == win_current()) {
+            size_t filerow = econfig.row_offset;
+            linenr_T part = screen_skip, fold_bot;
+            for (int i = 0; i < t.rows; i++) {
+                if (filerow >= econfig.line_count) break;
+
+                // A closed fold in the selection is highlighted whole
+                if (fold_closed(wp, filerow, NULL, &fold_bot)) {
+                    if (fold_bot >= va.start.lnum && filerow <= va.end.lnum) {
+                        for (int c = 0; c < t.cols; c++)
+                            t.cells[i * t.cols + c].attr |= ATTR_REVERSE;
+                    }
+                    filerow = fold_bot + 1;
+                    continue;
+                }
+                if (!econfig.wrap) {
+                    screen_draw_selection(&t, i, filerow++,
+                                          econfig.col_offset, &va);
+                    continue;
+                }
+                screen_draw_selection(&t, i, filerow, part * t.cols, &va);
+                if (++part < screen_row_lines(&econfig.rows[filerow], t.cols))
+                    continue;
+                part = 0;
+                filerow++;
+            }
         }
-        else {
-            write_to_abuf(ab, " ", 1); // write space until rstatus len
-            len++;
+        if (wp == win_current()) screen_draw_match(&t, wp);
+        frame_blit(f, &t, wp->row, wp->col);
+        frame_free(&t);
+
+        // Separate the window from the one on its right
+        if (wp->col + wp->width < f->cols) {
+            for (int i = 0; i <= wp->height; i++)
+                frame_draw_str(f, wp->row + i, wp->col + wp->width, "|", 1,
+                               ATTR_REVERSE);
         }
     }
+}
 
-    write_to_abuf(ab, "\x1b[m", 3); // reset to normal formatting
-    write_to_abuf(ab, "\r\n", 2);
+// Draw the status bar of a window to a frame of its width
+static void
+screen_draw_window_status(screen_frame_T *t, win_T *wp)
+{
+    // The current window shows the editor state and the mode
+    bool current = wp == win_current();
+    const filebuf_T *buf = buflist_get(wp->buf);
+    colnr_T cx = current ? econfig.cx : wp->cx;
+    linenr_T cy = current ? econfig.cy : wp->cy;
+
+    char mode[32], status[80], rstatus[80];
+    int mlen = 0;
+    if (current)
+        mlen = snprintf(mode, sizeof(mode), " %.20s ", get_mode(econfig.mode));
+    int len = snprintf(status, sizeof(status), " %.20s - %d lines %s",
+                       buf->filename ? buf->filename : "[No Name]",
+                       (int)buf->line_count,
+                       buf->dirty ? "(modified)" : "");
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%lu:%lu ",
+                        buf->line_count > 0 ? cy + 1 : cy, cx + 1);
+
+    // Windows on the current buffer show the byte under the cursor and how
+    // far through the text it is
+    if (wp->buf == buflist_current() && econfig.line_count > 0) {
+        uint64_t total = byteidx_offset(econfig.line_count);
+        uint64_t off = byteidx_offset(cy) + cx;
+        rlen += snprintf(rstatus + rlen, sizeof(rstatus) - rlen,
+                         " %lluB %d%% ", (unsigned long long)off + 1,
+                         (int)(off * 100 / total));
+    }
+
+    // Fill the whole bar then draw the status text over it
+    int col;
+    for (col = 0; col < t->cols; col++)
+        frame_draw_str(t, 0, col, " ", 1, ATTR_REVERSE);
+
+    col = frame_draw_str(t, 0, 0, mode, mlen, ATTR_REVERSE | ATTR_BOLD);
+    col = frame_draw_str(t, 0, col, status, len, ATTR_REVERSE);
+    if (t->cols - col >= rlen)
+        frame_draw_str(t, 0, t->cols - rlen, rstatus, rlen, ATTR_REVERSE);
 }
 
 void
-screen_draw_cmd_line(struct append_buf *ab)
+screen_draw_status_bar(screen_frame_T *f)
 {
-    // Erase to end of current row
-    write_to_abuf(ab, "\x1b[K", 3);
+    // Draw bar by inverting color (see Select Graphic Rendition)
+    for (int w = 0; w < win_count(); w++) {
+        win_T *wp = win_get(w);
+        if (wp->width <= 0) continue;
+
+        screen_frame_T t;
+        frame_init(&t, 1, wp->width);
+        screen_draw_window_status(&t, wp);
+        frame_blit(f, &t, wp->row + wp->height, wp->col);
+        frame_free(&t);
+    }
+}
+
+void
+screen_draw_cmd_line(screen_frame_T *f)
+{
+    // The command line is the last row of the screen
+    int row = f->rows - 1;
+
+    // Command line being typed; its end stays in view
+    if (econfig.mode == MODE_COMMAND) {
+        int len = strlen(econfig.cmdline);
+        int start = len + 2 > f->cols ? len + 2 - f->cols : 0;
+        int col = frame_draw_str(f, row, 0, ":", 1, ATTR_NORMAL);
+        frame_draw_str(f, row, col, econfig.cmdline + start, len - start,
+                       ATTR_NORMAL);
+        return;
+    }
 
     int cmdlen = strlen(econfig.statusmsg);
-    if (cmdlen > econfig.screencols) cmdlen = econfig.screencols;
+    if (cmdlen > f->cols) cmdlen = f->cols;
     // Draw message to command line
-    if (cmdlen && time(NULL) - econfig.statusmsg_time < 5)
-        write_to_abuf(ab, econfig.statusmsg, cmdlen);
+    if (cmdlen && time(NULL) - econfig.statusmsg_time < 5) {
+        frame_draw_str(f, row, 0, econfig.statusmsg, cmdlen, ATTR_NORMAL);
+    }
+    // Otherwise show the register keys are being recorded to
+    else if (input_recording()) {
+        char rec[16];
+        int len = snprintf(rec, sizeof(rec), "recording @%c",
+                           input_recording());
+        frame_draw_str(f, row, 0, rec, len, ATTR_NORMAL);
+    }
 }
 
 void
@@ -194,64 +897,264 @@ statusbar_set_message(const char *format, ...)
     econfig.statusmsg_time = time(NULL);
 }
 
+// Number of rows in [0, nrows) of f that the shown frame displays `shift`
+// rows further down
+static int
+frame_count_shifted_rows(const screen_frame_T *shown,
+                         const screen_frame_T *f,
+                         int nrows,
+                         int shift)
+{
+    int matches = 0;
+    for (int r = 0; r < nrows; r++) {
+        int src = r + shift;
+        if (src < 0 || src >= nrows) continue;
+
+        const screen_cell_T *old = &shown->cells[src * f->cols];
+        const screen_cell_T *cell = &f->cells[r * f->cols];
+        int c = 0;
+        while (c < f->cols && cell_equal(&old[c], &cell[c]))
+            c++;
+        if (c == f->cols) matches++;
+    }
+    return matches;
+}
+
+void
+frame_scroll_to_abuf(append_buf_T *ab,
+                     screen_frame_T *shown,
+                     const screen_frame_T *f,
+                     int nrows,
+                     int shift)
+{
+    int n = shift < 0 ? -shift : shift;
+    if (shift == 0 || n >= nrows) return;
+
+    // Scroll only if it leaves more rows in place than repainting
+    if (frame_count_shifted_rows(shown, f, nrows, shift)
+        <= frame_count_shifted_rows(shown, f, nrows, 0))
+        return;
+
+    // Limit the scrolling region to the text rows (DECSTBM), scroll up (SU)
+    // or down (SD) then reset the region; the terminal blanks the exposed
+    // rows with the current background
+    char buf[48];
+    abuf_set_attr(ab, ATTR_NORMAL);
+    int len = snprintf(buf, sizeof(buf), "\x1b[1;%dr\x1b[%d%c\x1b[r", nrows, n,
+                       shift > 0 ? 'S' : 'T');
+    write_to_abuf(ab, buf, len);
+
+    // Resetting the region homes the cursor
+    ab->row = ab->col = 0;
+
+    // Shift the shown frame the same way the terminal did
+    size_t rowsz = sizeof(screen_cell_T) * shown->cols;
+    screen_cell_T *text = shown->cells;
+    if (shift > 0)
+        memmove(text, text + n * shown->cols, rowsz * (nrows - n));
+    else
+        memmove(text + n * shown->cols, text, rowsz * (nrows - n));
+
+    int blank_from = shift > 0 ? nrows - n : 0;
+    for (int i = 0; i < n * shown->cols; i++) {
+        text[blank_from * shown->cols + i].ch = ' ';
+        text[blank_from * shown->cols + i].attr = ATTR_NORMAL;
+    }
+}
+
+const screen_stats_T *
+screen_get_stats()
+{
+    return &screen_stats;
+}
+
+void
+screen_invalidate()
+{
+    pthread_mutex_lock(&screen_lock);
+    frame_free(&screen_shown);
+    pthread_mutex_unlock(&screen_lock);
+}
+
+void
+screen_show_lines(char *const *lines, int n)
+{
+    append_buf_T ab = ABUF_INIT;
+    char pos[32];
+    int rows, cols;
+    if (term_get_window_sz(&rows, &cols) == -1) die("get_window_sz");
+    int len = snprintf(pos, sizeof(pos), "\x1b[%d;1H\x1b[K", rows + 2);
+    write_to_abuf(&ab, pos, len);
+
+    // Every line after the first scrolls the screen up by one
+    for (int i = 0; i < n; i++) {
+        if (i) write_to_abuf(&ab, "\r\n", 2);
+        len = strlen(lines[i]);
+        write_to_abuf(&ab, lines[i],
+                      len > cols ? cols : len);
+    }
+    const char *prompt = "\r\nPress ENTER or type command to continue";
+    write_to_abuf(&ab, prompt, strlen(prompt));
+    term_write(ab.b, ab.len);
+    free_abuf(&ab);
+
+    input_read_key();
+    screen_invalidate();
+}
+
+// Screen lines the text moved up since the shown frame; only the lines
+// shown between the old and the new top are measured
+static int
+screen_scroll_shift()
+{
+    win_T *wp = win_current();
+    int rows = econfig.screenrows;
+    linenr_T from = screen_shown_row_offset, to = econfig.row_offset;
+    linenr_T lo = to < from ? to : from, hi = to < from ? from : to;
+    if (hi > econfig.line_count) hi = econfig.line_count;
+    linenr_T shown = fold_count_shown(wp, lo, hi);
+    if (shown >= (linenr_T)rows) return to < from ? -rows : rows;
+    if (!econfig.wrap) return to < from ? -(int)shown : (int)shown;
+
+    long n = 0;
+    for (linenr_T l = lo; l < hi; l = screen_next_line(wp, l))
+        n += screen_shown_lines(wp, l, econfig.screencols);
+    if (to < from) return -(int)(n - screen_skip + screen_shown_skip);
+    return (int)(n - screen_shown_skip + screen_skip);
+}
+
 void
 screen_refresh()
 {
+    // Keys executed from a register are applied without drawing; the screen
+    // is drawn once when they run out
+    if (input_typeahead()) return;
+
+    pthread_mutex_lock(&screen_lock);
+
+    // Get new terminal size; the windows and their status bars take all of
+    // it but the command line
+    int rows, cols;
+    if (term_get_window_sz(&rows, &cols) == -1) die("get_window_sz");
+    win_layout(rows + 1, cols);
+
     // Apply offsetting when scrolling
     screen_scroll_handler();
 
-    // Get new terminal size
-    if (term_get_window_sz(&econfig.screenrows, &econfig.screencols) == -1)
-        die("get_window_sz");
+    // Compose the frame; windows, status bars and command line
+    screen_frame_T frame;
+    frame_init(&frame, rows + 2, cols);
+
+    screen_draw_rows(&frame);
+    screen_draw_status_bar(&frame);
+    screen_draw_cmd_line(&frame);
 
-    // Initialize buffer
+    // Initialize buffer; continue from where the last frame left the cursor
     append_buf_T ab = ABUF_INIT;
+    ab.row = screen_cursor_row;
+    ab.col = screen_cursor_col;
 
+    // Begin synchronized update so the terminal shows the frame at once
+    int sync_len = econfig.sync_output ? 8 : 0;
+    if (sync_len) write_to_abuf(&ab, "\x1b[?2026h", sync_len);
     write_to_abuf(&ab, "\x1b[?25l", 6); // hide cursor when repainting
-    write_to_abuf(&ab, "\x1b[H", 3); // reposition cursor to top
 
-    // Draw screen elements
-    screen_draw_rows(&ab);
-    screen_draw_status_bar(&ab);
-    screen_draw_cmd_line(&ab);
+    // Nothing is known about the terminal contents on first draw or after the
+    // dimensions change; clear it and repaint everything
+    if (screen_shown.cells == NULL || screen_shown.rows != frame.rows
+        || screen_shown.cols != frame.cols)
+    {
+        frame_free(&screen_shown);
+        frame_init(&screen_shown, frame.rows, frame.cols);
+        write_to_abuf(&ab, "\x1b[2J", 4);
+        ab.row = ab.col = -1;
+    }
+    else if (win_count() == 1) {
+        // Let the terminal move the text rows that are still visible after
+        // vertical scrolling; only the exposed rows are drawn
+        frame_scroll_to_abuf(&ab, &screen_shown, &frame, econfig.screenrows,
+                             screen_scroll_shift());
+    }
+    screen_shown_row_offset = econfig.row_offset;
+    screen_shown_skip = screen_skip;
+
+    // Write only the cells that differ from what the terminal shows; drop the
+    // cursor hiding if there is nothing to repaint
+    frame_update_to_abuf(&ab, &screen_shown, &frame);
+    bool repainted = ab.len > sync_len + 6;
+    if (!repainted) ab.len = 0;
+
+    // Reposition cursor with offset values; it is at the end of the command
+    // line while one is typed
+    if (econfig.mode == MODE_COMMAND) {
+        int col = strlen(econfig.cmdline) + 1;
+        abuf_move_cursor(&ab, &frame, frame.rows - 1,
+                         col < frame.cols ? col : frame.cols - 1);
+    }
+    else {
+        win_T *wp = win_current();
+        abuf_move_cursor(&ab, &frame, wp->row + screen_text_row,
+                         wp->col + screen_text_col);
+    }
+    screen_cursor_row = ab.row;
+    screen_cursor_col = ab.col;
+    frame_free(&frame);
+
+    if (repainted) {
+        write_to_abuf(&ab, "\x1b[?25h", 6); // show cursor; VT510
+        // End synchronized update
+        if (sync_len) write_to_abuf(&ab, "\x1b[?2026l", sync_len);
+    }
 
-    char buf[32];
-    // Reposition cursor with offset values
-    snprintf(buf, sizeof(buf), "\x1b[%lu;%luH",
-             (econfig.cy - econfig.row_offset) + 1,
-             (econfig.rx - econfig.col_offset) + 1);
-    write_to_abuf(&ab, buf, strlen(buf));
+    // Draw buffer to terminal with a single write
+    term_write(ab.b, ab.len);
 
-    write_to_abuf(&ab, "\x1b[?25h", 6); // show cursor; VT510
+    // Account for the output
+    screen_stats.frame_bytes = ab.len;
+    screen_stats.total_bytes += ab.len;
+    screen_stats.frames++;
 
-    // Draw buffer to terminal
-    write(STDOUT_FILENO, ab.b, ab.len);
     free_abuf(&ab);
+    pthread_mutex_unlock(&screen_lock);
+}
+
+void
+screen_idle()
+{
+    pthread_mutex_lock(&screen_lock);
+    bool resized = screen_resized;
+    screen_resized = false;
+    pthread_mutex_unlock(&screen_lock);
+
+    if (resized) screen_refresh();
 }
 
 void *
 thread_screen_refresh()
 {
-    int prev_num_rows = econfig.screenrows, prev_num_cols = econfig.screencols;
+    int prev_num_rows = -1, prev_num_cols = -1;
+    if (term_get_window_sz(&prev_num_rows, &prev_num_cols) == -1)
+        die("get_window_sz");
 
     struct timespec sleep_time;
     sleep_time.tv_sec = 0;
     sleep_time.tv_nsec = 10000000;
 
     while (1) {
-        int result =
-            term_get_window_sz(&econfig.screenrows, &econfig.screencols);
-        if (result == -1) die("get_window_sz");
+        // The refresh lays the windows out for the new size
+        int rows, cols;
+        if (term_get_window_sz(&rows, &cols) == -1) die("get_window_sz");
 
-        if (prev_num_rows != econfig.screenrows
-            || prev_num_cols != econfig.screencols)
-        {
+        if (prev_num_rows != rows || prev_num_cols != cols) {
             // Assign new values
-            prev_num_rows = econfig.screenrows;
-            prev_num_cols = econfig.screencols;
+            prev_num_rows = rows;
+            prev_num_cols = cols;
 
-            // Refresh screen using new values
-            screen_refresh();
+            // A refresh unpacks rows and counts caches, which only the main
+            // thread may touch; it draws the screen when it is idle
+            pthread_mutex_lock(&screen_lock);
+            screen_resized = true;
+            pthread_mutex_unlock(&screen_lock);
         }
 
         nanosleep(&sleep_time, NULL);
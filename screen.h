@@ -7,22 +7,90 @@
 #ifndef SCREEN_H
 #define SCREEN_H
 
+#include <stddef.h>
+
+#include "config.h"
+
 /* @brief Internal macros */
 #define ZEX_VERSION "0.0.1"
 
+/* @brief Display attributes of a screen cell (see Select Graphic Rendition) */
+typedef unsigned int screen_attr_T;
+
+/* @brief Attribute flags; colors are stored off by one so 0 means default */
+#define ATTR_NORMAL    0x00
+#define ATTR_BOLD      0x01
+#define ATTR_UNDERLINE 0x02
+#define ATTR_REVERSE   0x04
+#define ATTR_FG(c)     ((screen_attr_T)((c) + 1) << 8)
+#define ATTR_BG(c)     ((screen_attr_T)((c) + 1) << 16)
+#define ATTR_FG_MASK   0x00ff00
+#define ATTR_BG_MASK   0xff0000
+#define ATTR_FG_OF(a)  (((a)&ATTR_FG_MASK) >> 8)
+#define ATTR_BG_OF(a)  (((a)&ATTR_BG_MASK) >> 16)
+
+/* @brief Terminal colors; SGR 30-37 for foreground and 40-47 for background */
+enum ScreenColors {
+    COLOR_BLACK,
+    COLOR_RED,
+    COLOR_GREEN,
+    COLOR_YELLOW,
+    COLOR_BLUE,
+    COLOR_MAGENTA,
+    COLOR_CYAN,
+    COLOR_WHITE
+};
+
 /* @brief Append buffer */
 typedef struct append_buf {
     /* char string */
-    char *b; /* length of the string */
+    char *b;
+    /* length of the string */
     int len;
+    /* allocated size of the string */
+    int cap;
+    /* attributes currently active on the terminal */
+    screen_attr_T attr;
+    /* cursor row on the terminal; -1 if unknown */
+    int row;
+    /* cursor col on the terminal; -1 if unknown */
+    int col;
 } append_buf_T;
 
 /* @brief Default value/initialization for append buffer */
 #define ABUF_INIT                                                              \
     {                                                                          \
-        NULL, 0                                                                \
+        NULL, 0, 0, ATTR_NORMAL, -1, -1                                        \
     }
 
+/* @brief A character cell of the screen */
+typedef struct screen_cell {
+    /* character drawn to the cell */
+    char ch;
+    /* display attributes of the cell */
+    screen_attr_T attr;
+} screen_cell_T;
+
+/* @brief Grid of cells composing a frame of the editor display */
+typedef struct screen_frame {
+    /* number of rows of the grid */
+    int rows;
+    /* number of cols of the grid */
+    int cols;
+    /* rows * cols cells */
+    screen_cell_T *cells;
+} screen_frame_T;
+
+/* @brief Terminal output accounting */
+typedef struct screen_stats {
+    /* bytes written by the last frame */
+    size_t frame_bytes;
+    /* bytes written since startup */
+    unsigned long long total_bytes;
+    /* number of frames written */
+    unsigned long frames;
+} screen_stats_T;
+
 /**
  * @brief Get the current position of the cursor on the terminal
  *
@@ -39,38 +107,143 @@ void write_to_abuf(append_buf_T *ab, const char *str, int len);
  */
 void free_abuf(append_buf_T *ab);
 
-/* @brief Handle x and y scroll */
-void screen_scroll_handler();
-
 /**
- * @brief Get the current position of the cursor on the terminal
+ * @brief Switch the terminal attributes to attr
+ *
+ * Only the SGR parameters that differ from the attributes currently active on
+ * the terminal are written. A full reset is used only when it is shorter.
  *
  * @param ab Pointer to append buffer
- * @param format String format
- * @param ... arguments
+ * @param attr Attributes to switch to
  */
-void screen_draw_welcome_mes(struct append_buf *ab, const char *format, ...);
+void abuf_set_attr(append_buf_T *ab, screen_attr_T attr);
 
 /**
- * @brief Draw all rows/line to append buffer
+ * @brief Allocate a frame of blank cells
+ *
+ * @param f Pointer to frame
+ * @param rows Number of rows
+ * @param cols Number of cols
+ */
+void frame_init(screen_frame_T *f, int rows, int cols);
+
+/**
+ * @brief Free the cells of a frame
+ *
+ * @param f Pointer to frame
+ */
+void frame_free(screen_frame_T *f);
+
+/**
+ * @brief Draw string to a row of the frame; clipped to the frame width
+ *
+ * @param f Pointer to frame
+ * @param row Row to draw to
+ * @param col Col of the first character
+ * @param s Char string
+ * @param len Char string length
+ * @param attr Display attributes of the string
+ * @return Col next to the last character drawn
+ */
+int frame_draw_str(screen_frame_T *f,
+                   int row,
+                   int col,
+                   const char *s,
+                   int len,
+                   screen_attr_T attr);
+
+/**
+ * @brief Move the terminal cursor using the cheapest sequence
+ *
+ * Picks the shortest of an absolute position (CUP), relative motions
+ * (CUU/CUD/CUF/CUB, CR, LF, BS) or writing over the cells in between.
  *
  * @param ab Pointer to append buffer
+ * @param f Pointer to frame the terminal already shows up to the cursor
+ * @param row Row to move to
+ * @param col Col to move to
  */
-void screen_draw_rows(struct append_buf *ab);
+void abuf_move_cursor(append_buf_T *ab,
+                      const screen_frame_T *f,
+                      int row,
+                      int col);
 
 /**
- * @brief Draw status text to append buffer
+ * @brief Write the cells of a frame that differ from the shown frame
+ *
+ * Identical attributes of adjacent cells are merged into a single run and
+ * trailing blanks of each row are erased instead of written.
  *
  * @param ab Pointer to append buffer
+ * @param shown Pointer to frame the terminal shows; updated to f
+ * @param f Pointer to frame to show
  */
-void screen_draw_status_bar(struct append_buf *ab);
+void frame_update_to_abuf(append_buf_T *ab,
+                          screen_frame_T *shown,
+                          const screen_frame_T *f);
 
 /**
- * @brief Draw command line to append buffer
+ * @brief Scroll the top rows of the terminal instead of repainting them
+ *
+ * Rows [0, nrows) are scrolled by shift rows using a scrolling region when
+ * that leaves more of them in place than writing f over the shown frame.
  *
  * @param ab Pointer to append buffer
+ * @param shown Pointer to frame the terminal shows; shifted along
+ * @param f Pointer to frame to show
+ * @param nrows Number of rows of the scrolling region
+ * @param shift Rows to scroll; positive scrolls the text up
+ */
+void frame_scroll_to_abuf(append_buf_T *ab,
+                          screen_frame_T *shown,
+                          const screen_frame_T *f,
+                          int nrows,
+                          int shift);
+
+/**
+ * @brief Get the number of screen lines a row takes when rows wrap
+ *
+ * @param row Row holding its text
+ * @param cols Width of the window
  */
-void screen_draw_cmd_line(struct append_buf *ab);
+linenr_T screen_row_lines(const editor_row_T *row, int cols);
+
+/* @brief Handle x and y scroll; rows wrap with the wrap option set */
+void screen_scroll_handler();
+
+/**
+ * @brief Draw centered welcome message to a row of the frame
+ *
+ * @param f Pointer to frame
+ * @param row Row to draw to
+ * @param format String format
+ * @param ... arguments
+ */
+void screen_draw_welcome_message(screen_frame_T *f,
+                                 int row,
+                                 const char *format,
+                                 ...);
+
+/**
+ * @brief Draw all rows/line to frame
+ *
+ * @param f Pointer to frame
+ */
+void screen_draw_rows(screen_frame_T *f);
+
+/**
+ * @brief Draw status text to frame
+ *
+ * @param f Pointer to frame
+ */
+void screen_draw_status_bar(screen_frame_T *f);
+
+/**
+ * @brief Draw command line to frame
+ *
+ * @param f Pointer to frame
+ */
+void screen_draw_cmd_line(screen_frame_T *f);
 
 /**
  * @brief Set status message to be displayed in the command line
@@ -83,14 +256,40 @@ void statusbar_set_message(const char *format, ...);
 /**
  * @brief Refresh terminal screen to draw editor
  *
- * This function draws the editor's display output to the terminal.
+ * This function draws the editor's display output to the terminal. Only the
+ * cells that changed since the previous refresh are written.
  */
 void screen_refresh();
 
+/* @brief Forget the shown frame so the next refresh repaints everything */
+void screen_invalidate();
+
+/**
+ * @brief Show a message of several lines and wait for a key
+ *
+ * The lines scroll the editor up from the command line like the output of
+ * a shell command does; the screen is drawn again after a key is pressed.
+ *
+ * @param lines Lines of the message; cut at the width of the screen
+ * @param n Number of lines
+ */
+void screen_show_lines(char *const *lines, int n);
+
+/* @brief Get the terminal output accounting */
+const screen_stats_T *screen_get_stats();
+
+/**
+ * @brief Draw the screen again if the terminal was resized
+ *
+ * Called by the main thread while it waits for keys.
+ */
+void screen_idle();
+
 /**
- * @brief Refresh screen wrapper to be called on separate thread
+ * @brief Watch the terminal size on a separate thread
  *
- * Will be passed to pthread_create to handle terminal dimension changes
+ * Will be passed to pthread_create to handle terminal dimension changes. A
+ * change is left for screen_idle() as drawing touches the rows.
  */
 void *thread_screen_refresh();
 
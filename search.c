@@ -0,0 +1,115 @@
+/**
+ * @file search.c
+ * @author re-nanashi
+ * @brief Pattern matching on rows
+ */
+
+#define _GNU_SOURCE
+
+#include "search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "cold.h"
+#include "screen.h"
+
+// Characters with a special meaning in a basic regular expression
+#define SEARCH_SPECIAL_CHARS ".[]\\*^$"
+
+bool
+search_compile(spat_T *pat, const char *s, size_t len, bool positions)
+{
+    char *str = malloc(len + 1);
+    memcpy(str, s, len);
+    str[len] = '\0';
+
+    int err = regcomp(&pat->re, str, positions ? 0 : REG_NOSUB);
+    if (err) {
+        char msg[64];
+        regerror(err, &pat->re, msg, sizeof(msg));
+        statusbar_set_message("Invalid pattern: %s", msg);
+        free(str);
+        return false;
+    }
+
+    // Plain text is found faster with memmem than with the regex engine
+    pat->literal = NULL;
+    pat->literal_len = 0;
+    if (strpbrk(str, SEARCH_SPECIAL_CHARS) == NULL) {
+        pat->literal = str;
+        pat->literal_len = len;
+    }
+    else {
+        free(str);
+    }
+
+    return true;
+}
+
+// Text of a row as one run of characters; copied to a scratch buffer only
+// when the gap splits it
+static const char *
+search_row_text(const editor_row_T *row, size_t *len)
+{
+    static char *scratch;
+    static size_t scratch_cap;
+
+    if (row->cold) return cold_text(row, len);
+    *len = rbuf_len(row);
+    if (row->front + row->gap == row->size) return row->chars;
+    if (row->front == 0) return row->chars + row->gap;
+
+    if (*len > scratch_cap) {
+        scratch_cap = *len * 2;
+        scratch = realloc(scratch, scratch_cap);
+    }
+    rbuf_copy(row, 0, *len, scratch);
+    return scratch;
+}
+
+bool
+search_match_row(const spat_T *pat, const editor_row_T *row)
+{
+    size_t len;
+    const char *text = search_row_text(row, &len);
+
+    if (pat->literal)
+        return memmem(text, len, pat->literal, pat->literal_len) != NULL;
+
+    // Match the run in place; REG_STARTEND lifts the need for a terminator
+    regmatch_t m;
+    m.rm_so = 0;
+    m.rm_eo = len;
+    return regexec(&pat->re, text, 1, &m, REG_STARTEND) == 0;
+}
+
+bool
+search_find(const spat_T *pat, const char *text, size_t len, size_t *start,
+            size_t *end)
+{
+    if (pat->literal) {
+        const char *p = memmem(text, len, pat->literal, pat->literal_len);
+        if (p == NULL) return false;
+        *start = p - text;
+        *end = *start + pat->literal_len;
+        return true;
+    }
+
+    regmatch_t m;
+    m.rm_so = 0;
+    m.rm_eo = len;
+    if (regexec(&pat->re, text, 1, &m, REG_STARTEND) != 0) return false;
+    *start = m.rm_so;
+    *end = m.rm_eo;
+    return true;
+}
+
+void
+search_free(spat_T *pat)
+{
+    regfree(&pat->re);
+    free(pat->literal);
+    pat->literal = NULL;
+}
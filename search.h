@@ -0,0 +1,75 @@
+/**
+ * @file search.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for pattern matching on rows
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+/* @brief Compiled search pattern */
+typedef struct spat {
+    /* compiled POSIX basic regular expression */
+    regex_t re;
+    /* pattern without special characters; matched without the regex engine.
+     * NULL if the pattern needs the regex engine */
+    char *literal;
+    /* length of literal */
+    size_t literal_len;
+} spat_T;
+
+/**
+ * @brief Compile a search pattern
+ *
+ * Sets a status bar message if the pattern is invalid.
+ *
+ * @param pat Pointer to pattern to fill
+ * @param s Pattern text
+ * @param len Length of pattern text
+ * @param positions True if search_find is used with the pattern; matching
+ *                  is faster without
+ * @return False if the pattern is invalid
+ */
+bool search_compile(spat_T *pat, const char *s, size_t len, bool positions);
+
+/**
+ * @brief Check if a pattern matches somewhere in a row
+ *
+ * The text is matched where it lies in the gap buffer; it is copied only
+ * when the gap splits it.
+ *
+ * @param pat Pointer to compiled pattern
+ * @param row Pointer to row
+ */
+bool search_match_row(const spat_T *pat, const editor_row_T *row);
+
+/**
+ * @brief Find the first match of a pattern in text
+ *
+ * The pattern must be compiled with positions. Safe to call from several
+ * threads as long as each uses its own compiled pattern.
+ *
+ * @param pat Pointer to compiled pattern
+ * @param text Text to search; need not be null terminated
+ * @param len Length of text
+ * @param start Set to the index of the start of the match
+ * @param end Set to the index after the end of the match
+ * @return False if the pattern does not match
+ */
+bool search_find(const spat_T *pat, const char *text, size_t len,
+                 size_t *start, size_t *end);
+
+/**
+ * @brief Free a compiled pattern
+ *
+ * @param pat Pointer to compiled pattern
+ */
+void search_free(spat_T *pat);
+
+#endif /* SEARCH_H */
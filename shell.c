@@ -0,0 +1,231 @@
+/**
+ * @file shell.c
+ * @author re-nanashi
+ * @brief Running shell commands and filtering lines through them
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "shell.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "edit.h"
+#include "file_io.h"
+#include "input.h"
+#include "screen.h"
+#include "terminal.h"
+
+/* @brief Internal macros */
+// Most buffers handed to a single writev
+#define SHELL_IOV_MAX 1024
+// Size of the buffer the output of a command is read into
+#define SHELL_READ_SIZE 65536
+
+extern char **environ;
+
+// Write rows to a pipe from where the last write stopped; a row is its text
+// on both sides of the gap and a line break. Written rows are freed as the
+// output replaces them. Returns false once every row is written or the pipe
+// cannot take more.
+static bool
+shell_write_rows(int fd, linenr_T *lnum, linenr_T end, size_t *off)
+{
+    static const char nl = '\n';
+    struct iovec iov[SHELL_IOV_MAX];
+    int n = 0;
+
+    for (linenr_T l = *lnum; l < end && n + 3 <= SHELL_IOV_MAX; l++) {
+        editor_row_T *row = row_get(l);
+        const char *seg[3] = { row->chars, row->chars + row->front + row->gap,
+                               &nl };
+        size_t len[3] = { row->front, row->size - row->front - row->gap, 1 };
+
+        // Skip what an earlier partial write took of the first row
+        size_t skip = l == *lnum ? *off : 0;
+        for (int s = 0; s < 3; s++) {
+            if (skip >= len[s]) {
+                skip -= len[s];
+                continue;
+            }
+            iov[n].iov_base = (char *)seg[s] + skip;
+            iov[n].iov_len = len[s] - skip;
+            skip = 0;
+            n++;
+        }
+    }
+    if (n == 0) return false;
+
+    ssize_t written = writev(fd, iov, n);
+    if (written == -1) return errno == EAGAIN || errno == EINTR;
+
+    // Move past the written rows
+    size_t w = written;
+    while (w > 0 && *lnum < end) {
+        size_t rest = rbuf_len(&econfig.rows[*lnum]) + 1 - *off;
+        if (w < rest) {
+            *off += w;
+            break;
+        }
+        w -= rest;
+        row_free(&econfig.rows[*lnum]);
+        econfig.rows[*lnum].rsize = 0;
+        (*lnum)++;
+        *off = 0;
+    }
+    return *lnum < end;
+}
+
+// Make a pipe whose ends are closed in spawned commands unless duplicated
+static int
+shell_pipe(int fds[2])
+{
+    if (pipe(fds) == -1) return -1;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+long
+shell_filter(const char *cmd, linenr_T line1, linenr_T count, linenr_T at,
+             int *status)
+{
+    int in[2] = { -1, -1 }, out[2];
+    if (shell_pipe(out) == -1) return -1;
+    if (count && shell_pipe(in) == -1) {
+        close(out[0]);
+        close(out[1]);
+        return -1;
+    }
+
+    // The command reads the lines, or nothing, and writes both of its
+    // outputs to the pipe
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    if (count)
+        posix_spawn_file_actions_adddup2(&fa, in[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null",
+                                         O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, out[1], STDERR_FILENO);
+
+    char *argv[] = { "sh", "-c", (char *)cmd, NULL };
+    pid_t pid;
+    int err = posix_spawn(&pid, "/bin/sh", &fa, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+
+    if (count) close(in[0]);
+    close(out[1]);
+    if (err) {
+        if (count) close(in[1]);
+        close(out[0]);
+        statusbar_set_message("Cannot run shell: %s", strerror(err));
+        return -1;
+    }
+
+    int infd = count ? in[1] : -1;
+    int outfd = out[0];
+    if (infd != -1) fcntl(infd, F_SETFL, O_NONBLOCK);
+    fcntl(outfd, F_SETFL, O_NONBLOCK);
+
+    // A command that stops reading early must not kill the editor
+    void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+
+    row_reader_T rr;
+    file_reader_init(&rr);
+    char *buf = malloc(SHELL_READ_SIZE);
+    linenr_T lnum = line1;
+    size_t off = 0;
+
+    // Write the lines while reading the output so neither side of the
+    // command blocks on a full pipe
+    while (outfd != -1) {
+        struct pollfd pfd[2];
+        int nfds = 0;
+        pfd[nfds++] = (struct pollfd){ outfd, POLLIN, 0 };
+        if (infd != -1) pfd[nfds++] = (struct pollfd){ infd, POLLOUT, 0 };
+
+        if (poll(pfd, nfds, -1) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (infd != -1 && pfd[1].revents) {
+            if ((pfd[1].revents & (POLLERR | POLLHUP))
+                || !shell_write_rows(infd, &lnum, line1 + count, &off))
+            {
+                // Closing the pipe ends the input of the command
+                close(infd);
+                infd = -1;
+            }
+        }
+
+        if (pfd[0].revents) {
+            ssize_t nread = read(outfd, buf, SHELL_READ_SIZE);
+            if (nread > 0) {
+                file_reader_feed(&rr, buf, nread);
+            }
+            else if (nread == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close(outfd);
+                outfd = -1;
+            }
+        }
+    }
+
+    if (infd != -1) close(infd);
+    free(buf);
+    signal(SIGPIPE, old_sigpipe);
+
+    int wstatus = 0;
+    while (waitpid(pid, &wstatus, 0) == -1 && errno == EINTR)
+        ;
+    *status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : -1;
+
+    return file_reader_insert(&rr, at);
+}
+
+void
+shell_execute(const char *cmd)
+{
+    // The command gets the terminal as it was before the editor started
+    term_disable_raw_mode();
+    write(STDOUT_FILENO, "\x1b[2J\x1b[H", 7);
+
+    char *argv[] = { "sh", "-c", (char *)cmd, NULL };
+    pid_t pid;
+    int wstatus = 0;
+    if (posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, environ) == 0) {
+        while (waitpid(pid, &wstatus, 0) == -1 && errno == EINTR)
+            ;
+    }
+
+    char msg[64];
+    int len = 0;
+    if (WIFEXITED(wstatus) && WEXITSTATUS(wstatus))
+        len = snprintf(msg, sizeof(msg), "\nshell returned %d\n",
+                       WEXITSTATUS(wstatus));
+    const char *prompt = "\nPress ENTER or type command to continue";
+    write(STDOUT_FILENO, msg, len);
+    write(STDOUT_FILENO, prompt, strlen(prompt));
+
+    term_enable_raw_mode();
+    input_read_key();
+
+    // Nothing is known about the terminal contents anymore
+    screen_invalidate();
+}
@@ -0,0 +1,43 @@
+/**
+ * @file shell.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for running shell commands
+ */
+
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "config.h"
+
+/**
+ * @brief Run a shell command with lines as its input and insert its output
+ *
+ * The lines are written to the command straight from the gap buffers of the
+ * rows while its output is read, both through non-blocking pipes; the text
+ * is never copied into one string. Each line is freed once written since the
+ * output replaces it; the caller deletes the emptied rows. The output rows
+ * are inserted at once when the command exits. Error output is read along
+ * with the output.
+ *
+ * @param cmd Shell command
+ * @param line1 Index of the first line to write to the command
+ * @param count Number of lines to write and free; 0 to give the command no
+ *              input
+ * @param at Index to insert the output rows at
+ * @param status Return: exit status of the command
+ * @return Number of rows inserted or -1 if the command cannot be run
+ */
+long shell_filter(const char *cmd, linenr_T line1, linenr_T count,
+                  linenr_T at, int *status);
+
+/**
+ * @brief Run a shell command on the terminal
+ *
+ * Raw mode is left while the command runs; the screen is drawn again after a
+ * key is pressed.
+ *
+ * @param cmd Shell command
+ */
+void shell_execute(const char *cmd);
+
+#endif /* SHELL_H */
@@ -0,0 +1,496 @@
+/**
+ * @file sort.c
+ * @author re-nanashi
+ * @brief Sorting lines by permuting rows
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "sort.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "cold.h"
+#include "edit.h"
+#include "search.h"
+#include "swap.h"
+
+/* @brief Internal macros */
+// Most threads a sort runs on
+#define SORT_THREADS_MAX 64
+// Fewest lines given to a thread of its own
+#define SORT_LINES_PER_THREAD 32768
+// Runs this short are sorted by insertion
+#define SORT_INSERTION_MAX 16
+// Size of a block of text copied out of split rows
+#define SORT_BLOCK_SIZE 65536
+
+/* @brief Cached sort key of a line */
+typedef struct sortkey {
+    union {
+        /* text of the key; points into the row or into a copy of its text
+         * if the gap splits it */
+        struct {
+            const char *s;
+            size_t len;
+            /* first bytes of the key in an order that compares like the
+             * text; most comparisons end here without touching the row */
+            uint64_t prefix;
+        } str;
+        /* first number of the key */
+        struct {
+            long long value;
+            bool valid;
+        } num;
+    } u;
+    /* index of the line from the first sorted line */
+    linenr_T lnum;
+} sortkey_T;
+
+/* @brief Block of text copied out of rows split by their gap */
+typedef struct sortblock {
+    struct sortblock *next;
+    size_t used;
+    size_t cap;
+    char text[];
+} sortblock_T;
+
+/* @brief Work of a single thread */
+typedef struct sortjob {
+    /* keys to sort; the run in src ends up in dst */
+    sortkey_T *src;
+    sortkey_T *dst;
+    /* bounds of the runs within the key arrays; a merge takes lo..mid and
+     * mid..hi, extraction and sorting take lo..hi */
+    linenr_T lo;
+    linenr_T mid;
+    linenr_T hi;
+    /* index of the first sorted line */
+    linenr_T line1;
+    /* text copied out of split rows; freed after the sort */
+    sortblock_T *blocks;
+    /* rows gathered in sorted order and how many of lo..hi were kept */
+    editor_row_T *sorted;
+    linenr_T kept;
+    /* false if the pattern could not be compiled */
+    bool ok;
+} sortjob_T;
+
+// Options of the running sort; read by every thread
+static const sortopt_T *sort_opt;
+
+// Text of a row as one run of characters; copied to a block only when the
+// gap splits it
+static const char *
+sort_row_text(const editor_row_T *row, size_t *len, sortblock_T **blocks)
+{
+    *len = rbuf_len(row);
+    if (row->front + row->gap == row->size) return row->chars;
+    if (row->front == 0) return row->chars + row->gap;
+
+    sortblock_T *b = *blocks;
+    if (b == NULL || b->cap - b->used < *len) {
+        size_t cap = *len > SORT_BLOCK_SIZE ? *len : SORT_BLOCK_SIZE;
+        b = malloc(sizeof(sortblock_T) + cap);
+        b->next = *blocks;
+        b->used = 0;
+        b->cap = cap;
+        *blocks = b;
+    }
+    char *text = b->text + b->used;
+    rbuf_copy(row, 0, *len, text);
+    b->used += *len;
+    return text;
+}
+
+// First decimal number of text; a '-' right before it makes it negative
+static bool
+sort_parse_number(const char *s, size_t len, long long *value)
+{
+    size_t i = 0;
+    while (i < len && !isdigit((unsigned char)s[i]))
+        i++;
+    if (i == len) return false;
+
+    bool neg = i > 0 && s[i - 1] == '-';
+    long long n = 0;
+    for (; i < len && isdigit((unsigned char)s[i]); i++) {
+        int d = s[i] - '0';
+        n = n > (LLONG_MAX - d) / 10 ? LLONG_MAX : n * 10 + d;
+    }
+    *value = neg ? -n : n;
+    return true;
+}
+
+// First bytes of a key packed so that comparing two prefixes as numbers
+// orders them like their text
+static uint64_t
+sort_key_prefix(const char *s, size_t len, bool ignore_case)
+{
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); i++) {
+        unsigned char c = i < len ? s[i] : 0;
+        prefix = prefix << 8 | (ignore_case ? tolower(c) : c);
+    }
+    return prefix;
+}
+
+// Extract the keys of the lines lo..hi of a job
+static void
+sort_extract(sortjob_T *job)
+{
+    const sortopt_T *opt = sort_opt;
+
+    // Every thread needs its own pattern; the regex engine locks a pattern
+    // while matching it
+    spat_T sp;
+    if (opt->pat && !search_compile(&sp, opt->pat, opt->pat_len, true)) {
+        job->ok = false;
+        return;
+    }
+
+    for (linenr_T i = job->lo; i < job->hi; i++) {
+        size_t len;
+        const char *s = sort_row_text(&econfig.rows[job->line1 + i], &len,
+                                      &job->blocks);
+
+        // Without a match the key is empty
+        size_t start = 0, end = len;
+        if (opt->pat) {
+            if (!search_find(&sp, s, len, &start, &end))
+                start = end = 0;
+            else if (!opt->key_is_match)
+                start = end, end = len;
+        }
+
+        sortkey_T *k = &job->src[i];
+        k->lnum = i;
+        if (opt->numeric) {
+            k->u.num.valid =
+                sort_parse_number(s + start, end - start, &k->u.num.value);
+        }
+        else {
+            k->u.str.s = s + start;
+            k->u.str.len = end - start;
+            k->u.str.prefix =
+                sort_key_prefix(k->u.str.s, k->u.str.len, opt->ignore_case);
+        }
+    }
+
+    if (opt->pat) search_free(&sp);
+    job->ok = true;
+}
+
+// Compare two runs of text; the shorter sorts first when one is a prefix of
+// the other
+static int
+sort_compare_text(const char *a, size_t alen, const char *b, size_t blen,
+                  bool ignore_case)
+{
+    size_t n = alen < blen ? alen : blen;
+    if (ignore_case) {
+        for (size_t i = 0; i < n; i++) {
+            int d = tolower((unsigned char)a[i]) - tolower((unsigned char)b[i]);
+            if (d) return d;
+        }
+    }
+    else {
+        int d = memcmp(a, b, n);
+        if (d) return d;
+    }
+    return (alen > blen) - (alen < blen);
+}
+
+// Compare two keys; equal keys keep the order of their lines even when
+// sorting in reverse
+static int
+sort_compare(const sortkey_T *a, const sortkey_T *b)
+{
+    const sortopt_T *opt = sort_opt;
+    int res;
+
+    if (opt->numeric) {
+        if (a->u.num.valid != b->u.num.valid)
+            res = a->u.num.valid - b->u.num.valid;
+        else if (!a->u.num.valid)
+            res = 0;
+        else
+            res = (a->u.num.value > b->u.num.value)
+                  - (a->u.num.value < b->u.num.value);
+    }
+    else if (a->u.str.prefix != b->u.str.prefix) {
+        res = a->u.str.prefix > b->u.str.prefix ? 1 : -1;
+    }
+    else {
+        res = sort_compare_text(a->u.str.s, a->u.str.len, b->u.str.s,
+                                b->u.str.len, opt->ignore_case);
+    }
+
+    if (opt->reverse) res = -res;
+    if (res == 0) res = (a->lnum > b->lnum) - (a->lnum < b->lnum);
+    return res;
+}
+
+// Merge two sorted runs into dst
+static void
+sort_merge(const sortkey_T *a, linenr_T na, const sortkey_T *b, linenr_T nb,
+           sortkey_T *dst)
+{
+    linenr_T i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (sort_compare(&b[j], &a[i]) < 0)
+            *dst++ = b[j++];
+        else
+            *dst++ = a[i++];
+    }
+    memcpy(dst, a + i, (na - i) * sizeof(sortkey_T));
+    memcpy(dst + (na - i), b + j, (nb - j) * sizeof(sortkey_T));
+}
+
+// Merge sort the keys in a into b, or back into a when to_b is false. The
+// halves are sorted into the other array so that every level is a single
+// pass over the keys.
+static void
+sort_run(sortkey_T *a, sortkey_T *b, linenr_T n, bool to_b)
+{
+    if (n <= SORT_INSERTION_MAX) {
+        for (linenr_T i = 1; i < n; i++) {
+            sortkey_T k = a[i];
+            linenr_T j = i;
+            for (; j > 0 && sort_compare(&k, &a[j - 1]) < 0; j--)
+                a[j] = a[j - 1];
+            a[j] = k;
+        }
+        if (to_b) memcpy(b, a, n * sizeof(sortkey_T));
+        return;
+    }
+
+    linenr_T half = n / 2;
+    sort_run(a, b, half, !to_b);
+    sort_run(a + half, b + half, n - half, !to_b);
+    if (to_b)
+        sort_merge(a, half, a + half, n - half, b);
+    else
+        sort_merge(b, half, b + half, n - half, a);
+}
+
+// Thread extracting and sorting the keys of a job
+static void *
+sort_thread_run(void *arg)
+{
+    sortjob_T *job = arg;
+    sort_extract(job);
+    if (job->ok)
+        sort_run(job->src + job->lo, job->dst + job->lo, job->hi - job->lo,
+                 false);
+    return NULL;
+}
+
+// Thread merging two adjacent runs of a job
+static void *
+sort_thread_merge(void *arg)
+{
+    sortjob_T *job = arg;
+    sort_merge(job->src + job->lo, job->mid - job->lo, job->src + job->mid,
+               job->hi - job->mid, job->dst + job->lo);
+    return NULL;
+}
+
+// Run jobs on threads of their own; the last one runs on the calling thread
+static void
+sort_run_jobs(sortjob_T *jobs, int n, void *(*func)(void *))
+{
+    pthread_t threads[SORT_THREADS_MAX];
+    bool started[SORT_THREADS_MAX];
+
+    for (int i = 0; i < n - 1; i++)
+        started[i] = pthread_create(&threads[i], NULL, func, &jobs[i]) == 0;
+    func(&jobs[n - 1]);
+
+    // A job without a thread runs here instead
+    for (int i = 0; i < n - 1; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            func(&jobs[i]);
+    }
+}
+
+// Check if two lines are identical; a key holding the whole line is
+// compared without going back to the rows
+static bool
+sort_same_line(const sortkey_T *a, const sortkey_T *b, linenr_T line1)
+{
+    const sortopt_T *opt = sort_opt;
+    if (!opt->numeric && opt->pat == NULL) {
+        return a->u.str.prefix == b->u.str.prefix
+               && a->u.str.len == b->u.str.len
+               && sort_compare_text(a->u.str.s, a->u.str.len, b->u.str.s,
+                                    b->u.str.len, opt->ignore_case)
+                      == 0;
+    }
+
+    const editor_row_T *ra = &econfig.rows[line1 + a->lnum];
+    const editor_row_T *rb = &econfig.rows[line1 + b->lnum];
+    size_t len = rbuf_len(ra);
+    if (len != rbuf_len(rb)) return false;
+    for (size_t i = 0; i < len; i++) {
+        int ca = rbuf_char_at(ra, i), cb = rbuf_char_at(rb, i);
+        if (opt->ignore_case) {
+            ca = tolower(ca);
+            cb = tolower(cb);
+        }
+        if (ca != cb) return false;
+    }
+    return true;
+}
+
+// Thread gathering the rows of lo..hi in the order of the sorted keys. A
+// line identical to the line before it goes to the end of the slice to be
+// freed; it is identical to the kept line before it too, so the slices need
+// not wait for each other.
+static void *
+sort_thread_gather(void *arg)
+{
+    sortjob_T *job = arg;
+    const sortkey_T *keys = job->src;
+    bool unique = sort_opt->unique;
+    editor_row_T *out = job->sorted + job->lo;
+    linenr_T dup = job->hi - job->lo;
+
+    job->kept = 0;
+    for (linenr_T i = job->lo; i < job->hi; i++) {
+        editor_row_T *row = &econfig.rows[job->line1 + keys[i].lnum];
+        if (unique && i > 0
+            && sort_same_line(&keys[i - 1], &keys[i], job->line1))
+            out[--dup] = *row;
+        else
+            out[job->kept++] = *row;
+    }
+    return NULL;
+}
+
+long
+sort_lines(linenr_T line1, linenr_T count, const sortopt_T *opt)
+{
+    if (count < 2) return 0;
+    sort_opt = opt;
+
+    // The threads read the text of the rows; packed ones are unpacked first
+    cold_thaw_range(line1, line1 + count);
+
+    sortkey_T *keys = malloc(count * sizeof(sortkey_T));
+    sortkey_T *tmp = malloc(count * sizeof(sortkey_T));
+
+    // Split the lines between the processors
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nthreads = ncpu > 0 ? (int)ncpu : 1;
+    if (nthreads > SORT_THREADS_MAX) nthreads = SORT_THREADS_MAX;
+    if ((linenr_T)nthreads > count / SORT_LINES_PER_THREAD)
+        nthreads = count / SORT_LINES_PER_THREAD ? count / SORT_LINES_PER_THREAD
+                                                 : 1;
+
+    sortjob_T jobs[SORT_THREADS_MAX];
+    for (int i = 0; i < nthreads; i++) {
+        jobs[i] = (sortjob_T){ 0 };
+        jobs[i].src = keys;
+        jobs[i].dst = tmp;
+        jobs[i].lo = count * i / nthreads;
+        jobs[i].hi = count * (i + 1) / nthreads;
+        jobs[i].line1 = line1;
+    }
+
+    // Each thread extracts and sorts the keys of its share
+    sort_run_jobs(jobs, nthreads, sort_thread_run);
+    bool ok = true;
+    for (int i = 0; i < nthreads; i++)
+        ok = ok && jobs[i].ok;
+
+    // Merge adjacent runs in parallel until one is left; a run without a
+    // neighbor is copied along
+    linenr_T bounds[SORT_THREADS_MAX + 1];
+    int nruns = nthreads;
+    for (int i = 0; i < nthreads; i++)
+        bounds[i] = jobs[i].lo;
+    bounds[nruns] = count;
+
+    sortkey_T *src = keys, *dst = tmp;
+    while (ok && nruns > 1) {
+        sortjob_T merges[SORT_THREADS_MAX];
+        int n = 0;
+        for (int i = 0; i < nruns; i += 2) {
+            merges[n] = (sortjob_T){ 0 };
+            merges[n].src = src;
+            merges[n].dst = dst;
+            merges[n].lo = bounds[i];
+            merges[n].mid = bounds[i + 1];
+            merges[n].hi = i + 1 < nruns ? bounds[i + 2] : bounds[i + 1];
+            n++;
+        }
+        sort_run_jobs(merges, n, sort_thread_merge);
+
+        for (int i = 0; i < n; i++)
+            bounds[i] = merges[i].lo;
+        bounds[n] = count;
+        nruns = n;
+
+        sortkey_T *t = src;
+        src = dst;
+        dst = t;
+    }
+
+    long removed = -1;
+    if (ok) {
+        // The rows are moved in one gather; the keys being merged into are
+        // no longer needed and make room for it
+        free(dst);
+        dst = NULL;
+        editor_row_T *sorted = malloc(count * sizeof(editor_row_T));
+        for (int i = 0; i < nthreads; i++) {
+            jobs[i].src = src;
+            jobs[i].sorted = sorted;
+        }
+        sort_run_jobs(jobs, nthreads, sort_thread_gather);
+
+        // Close up the slices over the rows of the range; the rows after it
+        // follow the kept ones. The keys point into the duplicates until
+        // every slice is gathered.
+        editor_row_T *rows = econfig.rows + line1;
+        linenr_T n = 0;
+        for (int i = 0; i < nthreads; i++) {
+            editor_row_T *slice = sorted + jobs[i].lo;
+            for (linenr_T j = jobs[i].kept; j < jobs[i].hi - jobs[i].lo; j++)
+                row_free(&slice[j]);
+            memcpy(rows + n, slice, jobs[i].kept * sizeof(editor_row_T));
+            n += jobs[i].kept;
+        }
+        memmove(rows + n, rows + count,
+                (econfig.line_count - line1 - count) * sizeof(editor_row_T));
+        free(sorted);
+
+        removed = count - n;
+        econfig.line_count -= removed;
+        row_changed_lines(line1, line1 + count, -removed);
+        swap_lines_changed(line1, line1 + count, -removed);
+    }
+
+    for (int i = 0; i < nthreads; i++) {
+        while (jobs[i].blocks) {
+            sortblock_T *next = jobs[i].blocks->next;
+            free(jobs[i].blocks);
+            jobs[i].blocks = next;
+        }
+    }
+    free(src);
+    free(dst);
+    return removed;
+}
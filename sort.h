@@ -0,0 +1,50 @@
+/**
+ * @file sort.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for sorting lines
+ */
+
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+/* @brief How lines are compared when sorting */
+typedef struct sortopt {
+    /* compare the first decimal number of the keys; keys without one come
+     * first */
+    bool numeric;
+    /* ignore case when comparing keys and finding duplicates */
+    bool ignore_case;
+    /* sort in reverse order; lines with equal keys keep their order */
+    bool reverse;
+    /* keep only the first of a run of identical lines */
+    bool unique;
+    /* pattern selecting the key; the text after its match. NULL if the key
+     * is the whole line. Lines without a match have an empty key */
+    const char *pat;
+    /* length of pat */
+    size_t pat_len;
+    /* the key is the match of pat instead of the text after it */
+    bool key_is_match;
+} sortopt_T;
+
+/**
+ * @brief Sort lines
+ *
+ * Keys are extracted once per line into an array of line handles, which is
+ * merge sorted in parallel across the processors. The rows are then moved
+ * to the sorted order; no text is copied or rewritten.
+ *
+ * @param line1 Index of the first line to sort
+ * @param count Number of lines to sort
+ * @param opt Pointer to sort options
+ * @return Number of lines removed as duplicates or -1 if the pattern is
+ *         invalid
+ */
+long sort_lines(linenr_T line1, linenr_T count, const sortopt_T *opt);
+
+#endif /* SORT_H */
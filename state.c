@@ -1,13 +1,22 @@
 #include "state.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "input.h"
 #include "normal.h"
 #include "screen.h"
-#include "normal.h"
+#include "edit.h"
+#include "buffer.h"
+#include "ops.h"
+#include "register.h"
+#include "ex.h"
+#include "fold.h"
+#include "win.h"
 
 // Returns the current mode string "NORMAL", "VISUAL", "INSERT", and "COMMAND".
 const char *
@@ -15,6 +24,8 @@ get_mode(Mode mode)
 {
     switch (mode) {
         case MODE_VISUAL:
+            if (econfig.visual_type == 'V') return "V-LINE";
+            if (econfig.visual_type == CTRL_KEY('v')) return "V-BLOCK";
             return "VISUAL";
         case MODE_INSERT:
             return "INSERT";
@@ -30,8 +41,9 @@ void
 state_enter(state_callback s, cmdarg_T *arg)
 {
     while (1) {
-        // Flush the UI using data from previous state changes.
-        screen_refresh();
+        // Flush the UI using data from previous state changes; skip the frame
+        // if more keys are queued (e.g. key repeat) and draw once they're done
+        if (!input_pending()) screen_refresh();
         int key = input_read_key(); // read user keyboard input
 
         // Execute the state callback.
@@ -42,165 +54,658 @@ state_enter(state_callback s, cmdarg_T *arg)
     }
 }
 
-bool
-nv_mode(cmdarg_T *arg, int key)
+// Accumulate a typed digit into a count; saturates instead of overflowing
+static int
+count_add_digit(int count, int key)
 {
+    if (count > (INT_MAX - 9) / 10) return count;
+    return count * 10 + (key - '0');
+}
+
+// Read the register name typed after '"' into the operator arguments
+static bool
+nv_read_regname(cmdarg_T *ca)
+{
+    statusbar_set_message("\"");
+    screen_refresh();
+
+    int regname = input_read_key();
+    if (!reg_valid(regname)) {
+        statusbar_set_message("");
+        return false;
+    }
+
+    ca->oap->regname = regname;
+    statusbar_set_message("\"%c", regname);
+    return true;
+}
+
+// Start insert mode at the cursor
+static void
+nv_start_insert()
+{
+    // The cursor line is never folded while text is typed into it
+    fold_open_cursor();
+
+    // Update current mode then print to status bar.
+    econfig.mode = MODE_INSERT;
+    statusbar_set_message("-- INSERT --");
+    // Enter insert mode; MODE_INSERT
+    state_enter(insert_mode, NULL);
+}
+
+// Start visual mode of the given type with the selection at the cursor
+static void
+nv_start_visual(cmdarg_T *ca, int type)
+{
+    econfig.visual_type = type;
+    econfig.visual_start.lnum = econfig.cy;
+    econfig.visual_start.col = econfig.cx;
+    econfig.visual_eol = 0;
+    econfig.mode = MODE_VISUAL;
+
+    // Enter visual mode; MODE_VISUAL
+    cmdarg_T va = { 0 };
+    va.oap = ca->oap;
+    state_enter(visual_mode, &va);
+    econfig.visual_type = 0;
+}
+
+// Register executed last; used by "@@"
+static int last_executed_reg;
+
+// Start or stop recording typed keys to a register
+static void
+nv_record()
+{
+    if (input_recording()) {
+        input_record_stop();
+        return;
+    }
+
+    int regname = input_read_key();
+    if (regname != '"' && reg_valid(regname)) input_record_start(regname);
+}
+
+// Execute the keys in a register count times
+static void
+nv_execute_reg(cmdarg_T *ca)
+{
+    int regname = input_read_key();
+    if (regname == '@') regname = last_executed_reg;
+    if (regname == 0 || !reg_valid(regname)) return;
+
+    size_t len;
+    char *keys = reg_get_text(regname, &len);
+    if (keys == NULL) {
+        statusbar_set_message("Nothing in register %c", regname);
+        return;
+    }
+    last_executed_reg = regname;
+
+    // All repetitions are queued at once so they run without drawing
+    char *buf = malloc(len * ca->count1);
+    if (buf == NULL) {
+        free(keys);
+        return;
+    }
+    for (int k = 0; k < ca->count1; k++)
+        memcpy(buf + len * k, keys, len);
+    input_stuff(buf, len * ca->count1);
+    free(buf);
+    free(keys);
+}
+
+// Execute a normal mode command; ca->count0 holds the count typed before it
+static void
+nv_execute(cmdarg_T *ca)
+{
+    int key = ca->cmdchar;
+    ca->count1 = ca->count0 ? ca->count0 : 1;
+
+    // Shortcuts for an operator and a motion
+    static const struct {
+        int key, op, motion;
+    } op_shortcuts[] = { { 'x', 'd', 'l' }, { 'X', 'd', 'h' },
+                         { 'D', 'd', '$' }, { 'C', 'c', '$' },
+                         { 'Y', 'y', 'y' } };
+
+    int motion = 0;
+    for (size_t i = 0; i < sizeof(op_shortcuts) / sizeof(op_shortcuts[0]);
+         i++)
+    {
+        if (op_shortcuts[i].key == key) {
+            key = op_shortcuts[i].op;
+            motion = op_shortcuts[i].motion;
+        }
+    }
+
+    // Fold commands; "zf" is an operator folding the lines of its motion
+    if (key == 'z') {
+        int k = input_read_key();
+        if (k != 'f') {
+            fold_command(k, ca->count1);
+            return;
+        }
+    }
+
     if (key == ':') {
         // Update current mode
         econfig.mode = MODE_COMMAND;
+        // A count becomes the range of that many lines
+        econfig.cmdline[0] = '\0';
+        if (ca->count0 > 1)
+            snprintf(econfig.cmdline, sizeof(econfig.cmdline), ".,.+%d",
+                     ca->count0 - 1);
+        else if (ca->count0)
+            strcpy(econfig.cmdline, ".");
         // Enter command line mode; MODE_COMMAND
-        cmdarg_T cmdlarg;
-        cmdlarg.count0 = 0;
+        cmdarg_T cmdlarg = { 0 };
         state_enter(command_line_mode, &cmdlarg);
     }
     else if (key == 'i') {
-        // Update current mode then print to status bar.
-        econfig.mode = MODE_INSERT;
-        statusbar_set_message("-- INSERT --");
-        // Enter insert mode; MODE_INSERT
-        state_enter(insert_mode, NULL);
+        nv_start_insert();
+    }
+    else if (key == 'q') {
+        nv_record();
+    }
+    else if (key == '@') {
+        nv_execute_reg(ca);
     }
-    else if (key == 'R' || key == 'y' || key == 'd' || key == 'c') {
+    else if (key == 'v' || key == 'V' || key == CTRL_KEY('v')) {
+        nv_start_visual(ca, key);
+    }
+    else if (key == CTRL_KEY('w')) {
+        // Window command; the key after Ctrl-W picks it
+        screen_refresh();
+        win_command(input_read_key(), ca->count0);
+    }
+    else if (key == 'y' || key == 'd' || key == 'c' || key == '>'
+             || key == '<' || key == 'z')
+    {
         // Update current mode
         econfig.mode = MODE_OP_PENDING;
-        // TODO: Show operator that was pressed
         // Enter operator pending mode; MODE_OP_PENDING
-        cmdarg_T oparg;
+        cmdarg_T oparg = { 0 };
+        oparg.oap = ca->oap;
         oparg.cmdchar = key;
-        oparg.count1 = 0;
+        oparg.opcount = ca->count0;
+
+        // The motion of a shortcut is applied right away
+        if (motion) {
+            operator_pending_mode(&oparg, motion);
+            return;
+        }
+
+        if (ca->count0)
+            statusbar_set_message("%d%c", ca->count0, key);
+        else
+            statusbar_set_message("%c", key);
         state_enter(operator_pending_mode, &oparg);
     }
-    else if (isdigit(key) && key != '0') {
+    else {
+        // Default: Enter normal mode; MODE_NORMAL
+        nv_process_key(ca);
+    }
+}
+
+bool
+nv_mode(cmdarg_T *arg, int key)
+{
+    (void)arg;
+    oparg_T oa = { 0 };
+    cmdarg_T ca = { 0 };
+    ca.oap = &oa;
+
+    // Register name for the command that follows
+    if (key == '"') {
+        if (!nv_read_regname(&ca)) return true;
+        screen_refresh();
+        key = input_read_key();
+    }
+    ca.cmdchar = key;
+
+    if (isdigit(key) && key != '0') {
         // Update current mode
         econfig.mode = MODE_COUNT_PENDING;
         // Enter count pending mode; MODE_COUNT_PENDING
-        cmdarg_T ctarg;
-        ctarg.cmdchar = key;
-        // count_pending_mode converts the cmdchar (single digit unsigned int)
-        // into a character that is appended to the stringified opcount
-        // then back to number to be assigned to opcount
-        state_enter(count_pending_mode, &ctarg);
+        // count_pending_mode appends the digits typed after this one to the
+        // count then executes the command that follows with it
+        ca.count0 = key - '0';
+        statusbar_set_message("%d", ca.count0);
+        state_enter(count_pending_mode, &ca);
     }
     else {
-        // Default: Enter normal mode; MODE_NORMAL
-        nv_process_key(key);
+        nv_execute(&ca);
     }
 
+    // A cursor moved into a closed fold goes to its first line
+    fold_adjust_cursor();
     econfig.mode = MODE_NORMAL; // return to normal mode
 
     return true;
 }
 
-// TODO: Need to print mode in cmd bar and make sure that escape key is working
 bool
 command_line_mode(cmdarg_T *arg, int key)
 {
+    (void)arg;
+    char *cmdline = econfig.cmdline;
+    size_t len = strlen(cmdline);
 
-    if (key == '\r' || key == CTRL_KEY('[')) {
-        // Execute if key pressed is either <ESC> or <CR>
+    if (key == CTRL_KEY('[')) {
+        // Cancel the command line
+        cmdline[0] = '\0';
         return false;
     }
-    else {
-        arg->count0++;
-        statusbar_set_message("Command_line_mode(:) %d", arg->count0);
+    else if (key == '\r') {
+        // Execute the command line; it is copied as commands like :global
+        // may execute other command lines
+        char cmd[sizeof(econfig.cmdline)];
+        strcpy(cmd, cmdline);
+        cmdline[0] = '\0';
+        econfig.mode = MODE_NORMAL;
+        ex_execute(cmd);
+        return false;
+    }
+    else if (key == BACKSPACE || key == CTRL_KEY('h') || key == DEL_KEY) {
+        // Deleting past the start leaves command line mode
+        if (len == 0) return false;
+        cmdline[len - 1] = '\0';
+    }
+    else if (key == CTRL_KEY('u')) {
+        cmdline[0] = '\0';
+    }
+    else if ((isprint(key) || key == '\t')
+             && len < sizeof(econfig.cmdline) - 1)
+    {
+        cmdline[len] = key;
+        cmdline[len + 1] = '\0';
     }
 
     return true;
 }
 
-bool
-operator_pending_mode(cmdarg_T *arg, int key)
+// Check if only blanks are before a position in its line
+static bool
+op_in_indent(pos_T pos)
 {
+    editor_row_T *row = row_get(pos.lnum);
+    colnr_T len = rbuf_len(row);
+    for (colnr_T c = 0; c < pos.col && c < len; c++)
+        if (!isspace(rbuf_char_at(row, c))) return false;
+    return true;
+}
 
-    if (key == CTRL_KEY('[')) {
-        // Execute if key pressed is either <ESC> or <CR>
-        return false;
+// Compute the end of the text a motion moves over for an operator; the
+// cursor is left where it was
+static bool
+op_apply_motion(cmdarg_T *arg, int key, long count)
+{
+    oparg_T *oap = arg->oap;
+    int flags = nv_motion_flags(key);
+    if (flags == -1) return false;
+
+    editor_row_T *row = econfig.line_count ? row_get(econfig.cy) : NULL;
+    colnr_T len = row ? rbuf_len(row) : 0;
+
+    // "cw" on a non-blank works like "ce"
+    if (arg->cmdchar == 'c' && (key == 'w' || key == 'W') && econfig.cx < len
+        && !isspace(rbuf_char_at(row, econfig.cx)))
+    {
+        key = key == 'w' ? 'e' : 'E';
+        flags = MOTION_INCLUSIVE;
     }
-    else {
-        arg->count1++;
-        /* mode for operator keys: g, R, y, d, c */
-        statusbar_set_message("operator_pending_mode(%c) %d", arg->cmdchar,
-                              arg->count1);
+
+    oap->motion_type = flags & MOTION_LINEWISE ? MLINE : MCHAR;
+    oap->inclusive = (flags & MOTION_INCLUSIVE) != 0;
+
+    if (key == 'l' || key == ARROW_RIGHT) {
+        // "l" may move past the last character
+        oap->end.lnum = econfig.cy;
+        oap->end.col = econfig.cx + count < len ? econfig.cx + count : len;
+        return true;
+    }
+
+    // Move the cursor with the motion and take its position as the end
+    cmdarg_T mca = { 0 };
+    mca.oap = oap;
+    mca.cmdchar = key;
+    mca.count0 = arg->opcount || arg->count0 ? count : 0;
+    mca.count1 = count;
+    nv_process_key(&mca);
+
+    oap->end.lnum = econfig.cy;
+    oap->end.col = econfig.cx;
+    econfig.cy = oap->start.lnum;
+    econfig.cx = oap->start.col;
+    // A motion that failed cleared the operator
+    if (oap->op_type == 0) return false;
+
+    // Backward motions end before the start
+    if (oap->end.lnum < oap->start.lnum
+        || (oap->end.lnum == oap->start.lnum && oap->end.col < oap->start.col))
+    {
+        pos_T tmp = oap->start;
+        oap->start = oap->end;
+        oap->end = tmp;
+    }
+    if (oap->motion_type != MCHAR || oap->end.lnum == oap->start.lnum)
+        return true;
+
+    // An exclusive motion ending at the start of a line ends at the end of
+    // the line before; it takes whole lines when it started in the indent
+    if (!oap->inclusive && oap->end.col == 0) {
+        oap->end.lnum--;
+        len = rbuf_len(row_get(oap->end.lnum));
+        if (op_in_indent(oap->start))
+            oap->motion_type = MLINE;
+        else if (len) {
+            oap->end.col = len - 1;
+            oap->inclusive = true;
+        }
+    }
+
+    // A delete from the indent up to blanks at the end of a line takes
+    // whole lines
+    if (oap->op_type == 'd' && oap->motion_type == MCHAR
+        && op_in_indent(oap->start))
+    {
+        row = row_get(oap->end.lnum);
+        len = rbuf_len(row);
+        colnr_T c = oap->end.col + (oap->end.col < len && oap->inclusive);
+        while (c < len && isspace(rbuf_char_at(row, c)))
+            c++;
+        if (c >= len) oap->motion_type = MLINE;
     }
 
     return true;
 }
 
 bool
-count_pending_mode(cmdarg_T *arg, int key)
+operator_pending_mode(cmdarg_T *arg, int key)
 {
     if (key == CTRL_KEY('[')) {
-        // Execute if key pressed is either <ESC> or <CR>
+        // Cancel the operator
+        statusbar_set_message("");
         return false;
     }
-    else {
-        arg->count1++;
-        /* mode for operator keys: g, R, y, d, c */
-        statusbar_set_message("operator_pending_mode(%c) %d", arg->cmdchar,
-                              arg->count1);
+
+    // Register name typed after the operator
+    if (key == '"') {
+        nv_read_regname(arg);
+        return true;
     }
 
-    return true;
+    // Count typed between the operator and the motion; multiplies the count
+    // typed before the operator
+    if (isdigit(key) && (key != '0' || arg->count0)) {
+        arg->count0 = count_add_digit(arg->count0, key);
+        statusbar_set_message("%c%d", arg->cmdchar, arg->count0);
+        return true;
+    }
+
+    statusbar_set_message("");
+    if (econfig.line_count == 0) return false;
+
+    long count = (long)(arg->opcount ? arg->opcount : 1)
+                 * (arg->count0 ? arg->count0 : 1);
+
+    oparg_T *oap = arg->oap;
+    oap->op_type = arg->cmdchar;
+    oap->start.lnum = econfig.cy;
+    oap->start.col = econfig.cx;
+
+    if (key == arg->cmdchar) {
+        // Doubled operator works on count lines
+        oap->motion_type = MLINE;
+        oap->end.lnum = econfig.cy + count - 1;
+        oap->end.col = 0;
+    }
+    else if (!op_apply_motion(arg, key, count)) {
+        return false;
+    }
+
+    switch (oap->op_type) {
+        case 'd':
+            op_delete(oap);
+            break;
+        case 'y':
+            // Cursor moves to the start of the yanked text
+            if (op_yank(oap, false)) {
+                econfig.cy = oap->start.lnum;
+                if (oap->motion_type == MCHAR) econfig.cx = oap->start.col;
+            }
+            break;
+        case 'c':
+            op_change(oap);
+            nv_start_insert();
+            break;
+        case '>':
+        case '<':
+            op_shift(oap, oap->op_type == '>' ? 1 : -1);
+            break;
+        case 'z':
+            fold_create(oap->start.lnum, oap->end.lnum);
+            break;
+    }
+
+    return false;
 }
 
-/*
-// TODO: Command mode functions
-void execute_command(opcmdarg_T *);
-bool cmd_is_valid(const opcmdarg_T *);
+// Insert the text typed into the first line of a block into the other lines;
+// other selections insert before the first column or append to every line
+static void
+visual_block_insert(oparg_T *oap, bool append)
+{
+    if (oap->motion_type != MBLOCK) {
+        oap->motion_type = MBLOCK;
+        oap->start.col = 0;
+        oap->end.col = MAXCOL;
+    }
+
+    // Type the text into the first line
+    econfig.cy = oap->start.lnum;
+    econfig.cx = op_block_start(oap, append);
+    colnr_T col = econfig.cx;
+    colnr_T before = rbuf_len(row_get(econfig.cy));
+    nv_start_insert();
 
-// Where do we get the next input?
-bool
-command_line_mode(cmdarg_T *arg, int key)
+    // Nothing is repeated if the text was not typed on the first line
+    editor_row_T *row = row_get(oap->start.lnum);
+    colnr_T after = rbuf_len(row);
+    if (econfig.cy != oap->start.lnum || after <= before) return;
+
+    size_t len = after - before;
+    char *buf = malloc(len + 1);
+    rbuf_copy(row, col, len, buf);
+
+    oparg_T rest = *oap;
+    rest.start.lnum++;
+    op_block_insert(&rest, append, buf, len);
+    free(buf);
+
+    econfig.cy = oap->start.lnum;
+    econfig.cx = append ? col + len - 1 : col;
+}
+
+// Apply an operator to the selection; the selection ends before the text
+// changes so it is drawn once, with the result
+static void
+visual_operator(cmdarg_T *arg, int key, long count)
 {
-    size_t bufsize = 128, buflen = 0;
-    arg->oap = malloc(bufsize);
-    arg->oap[0] = '\0';
+    oparg_T *oap = arg->oap;
 
-    while (1) {
-        // Flush ui
-        statusbar_set_message(":");
-        screen_refresh();
+    // "D", "X" and "Y" work on whole lines, or to the end of lines in a block
+    if (key == 'D' || key == 'X' || key == 'Y' || key == 'C' || key == 'S') {
+        if (econfig.visual_type == CTRL_KEY('v') && key != 'S')
+            econfig.visual_eol = 1;
+        else
+            econfig.visual_type = 'V';
+        key = key == 'Y' ? 'y' : key == 'C' || key == 'S' ? 'c' : 'd';
+    }
+    if (key == 'x') key = 'd';
+    if (key == 's') key = 'c';
 
-        // Read keyboard input from user
-        int c = input_read_key();
-        if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
-            if (buflen != 0) arg->oap[--buflen] = '\0';
-        }
-        else if (c == '\x1b') {
-            // Escape command mode when user presses escape keybind
-            statusbar_set_message("");
-            free(arg->oap);
-            goto end;
-        }
-        else if (c == 0x0d) {
-            // Execute command when user presses enter
-            if (buflen != 0 && cmd_is_valid(arg->oap)) {
-                statusbar_set_message("");
-                execute_command(arg->oap); // free oap after use
-            }
-            goto end;
-        }
-        else if (!iscntrl(c) && c < 128) {
-            // Grow the buffer if size reaches the limit
-            if (buflen == bufsize - 1) {
-                bufsize *= 2;
-                arg->oap = realloc(arg->oap, bufsize);
+    oap->op_type = key;
+    op_visual_range(oap);
+    econfig.visual_type = 0;
+    econfig.mode = MODE_NORMAL;
+
+    switch (key) {
+        case 'd':
+            op_delete(oap);
+            break;
+        case 'y':
+            // Cursor moves to the start of the yanked text
+            if (op_yank(oap, false)) {
+                econfig.cy = oap->start.lnum;
+                if (oap->motion_type == MCHAR) econfig.cx = oap->start.col;
+                if (oap->motion_type == MBLOCK)
+                    econfig.cx = row_convert_rx_to_cx(
+                        row_get(econfig.cy), oap->start.col);
+                input_clamp_cursor();
             }
-            arg->oap[buflen++] = c;
-            arg->oap[buflen] = '\0';
-        }
+            break;
+        case 'c':
+            op_change(oap);
+            if (oap->motion_type == MBLOCK)
+                visual_block_insert(oap, false);
+            else
+                nv_start_insert();
+            break;
+        case '>':
+        case '<':
+            op_shift(oap, (key == '>' ? 1 : -1) * (int)count);
+            break;
+        case 'I':
+        case 'A':
+            visual_block_insert(oap, key == 'A');
+            break;
     }
-end:
-    return false;
-};
+}
 
 bool
-operator_pending_mode(cmdarg_T *arg, int k)
+visual_mode(cmdarg_T *arg, int key)
 {
+    // Count for the next motion or operator
+    if (isdigit(key) && (key != '0' || arg->count0)) {
+        arg->count0 = count_add_digit(arg->count0, key);
+        statusbar_set_message("%d", arg->count0);
+        return true;
+    }
+
+    // Register name for the operator
+    if (key == '"') {
+        nv_read_regname(arg);
+        return true;
+    }
+
+    int count0 = arg->count0;
+    arg->count0 = 0;
+    statusbar_set_message("");
+
+    switch (key) {
+        case CTRL_KEY('['):
+            return false;
+
+        // Switch the type of the selection; typing the current type ends it
+        case 'v':
+        case 'V':
+        case CTRL_KEY('v'):
+            if (key == econfig.visual_type) return false;
+            econfig.visual_type = key;
+            return true;
+
+        // Move the cursor to the other end of the selection
+        case 'o': {
+            pos_T start = econfig.visual_start;
+            econfig.visual_start.lnum = econfig.cy;
+            econfig.visual_start.col = econfig.cx;
+            econfig.cy = start.lnum;
+            econfig.cx = start.col;
+            input_clamp_cursor();
+            return true;
+        }
+
+        case 'd':
+        case 'x':
+        case 'X':
+        case 'D':
+        case 'y':
+        case 'Y':
+        case 'c':
+        case 's':
+        case 'C':
+        case 'S':
+        case '>':
+        case '<':
+        case 'I':
+        case 'A':
+            if (econfig.line_count == 0) return false;
+            visual_operator(arg, key, count0 ? count0 : 1);
+            return false;
+
+        // Fold the selected lines
+        case 'z':
+            if (input_read_key() != 'f') return true;
+            if (econfig.line_count == 0) return false;
+            op_visual_range(arg->oap);
+            fold_create(arg->oap->start.lnum, arg->oap->end.lnum);
+            econfig.cy = arg->oap->start.lnum;
+            return false;
+    }
+
+    // Motions extend the selection
+    int flags = nv_motion_flags(key);
+    if (flags == -1) return true;
+
+    cmdarg_T mca = { 0 };
+    mca.oap = arg->oap;
+    mca.cmdchar = key;
+    mca.count0 = count0;
+    mca.count1 = count0 ? count0 : 1;
+    nv_process_key(&mca);
+
+    // A block extends to the end of every line after "$" until the cursor
+    // moves horizontally
+    if (key == '$' || key == END_KEY)
+        econfig.visual_eol = 1;
+    else if (!(flags & MOTION_LINEWISE))
+        econfig.visual_eol = 0;
+
+    return true;
 }
-// bool count_pending_mode(cmdarg_T *arg, int k);
 
-*/
+bool
+count_pending_mode(cmdarg_T *arg, int key)
+{
+    if (key == CTRL_KEY('[')) {
+        // Cancel the count
+        statusbar_set_message("");
+        return false;
+    }
+
+    // Register name typed after the count
+    if (key == '"') {
+        nv_read_regname(arg);
+        return true;
+    }
+
+    if (isdigit(key)) {
+        // Append the digit to the count
+        arg->count0 = count_add_digit(arg->count0, key);
+        statusbar_set_message("%d", arg->count0);
+        return true;
+    }
+
+    // Execute the command with the count then leave count pending mode
+    statusbar_set_message("");
+    arg->cmdchar = key;
+    econfig.mode = MODE_NORMAL;
+    nv_execute(arg);
+    return false;
+}
 
 bool
 insert_mode(cmdarg_T *arg, int key)
@@ -14,7 +14,16 @@
 /* @brief Internal macros */
 #define ZEX_QUIT_TIMES 2
 
-typedef char oparg_T;
+/// Arguments for operators.
+typedef struct {
+    int op_type; ///< operator character: 'd', 'y', 'c', '>' or '<'
+    int regname; ///< register name; 0 if none was given
+    int motion_type; ///< MCHAR, MLINE or MBLOCK
+    bool inclusive; ///< true if the character at end is operated on
+    pos_T start; ///< start of the operated text
+    pos_T end; ///< end of the operated text; for MBLOCK the columns are
+               ///< screen columns and end.col is MAXCOL up to end of line
+} oparg_T;
 /// Arguments for Normal mode commands.
 typedef struct {
     oparg_T *oap; ///< Operator arguments
@@ -38,5 +47,6 @@ bool insert_mode(cmdarg_T *arg, int k);
 bool command_line_mode(cmdarg_T *arg, int k);
 bool operator_pending_mode(cmdarg_T *arg, int k);
 bool count_pending_mode(cmdarg_T *arg, int k);
+bool visual_mode(cmdarg_T *arg, int k);
 
 #endif /* STATE_H */
@@ -0,0 +1,588 @@
+/**
+ * @file swap.c
+ * @author re-nanashi
+ * @brief Append-only journal of the changes made to a buffer since its file
+ * was read or written
+ */
+
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
+#include "swap.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "edit.h"
+#include "file_io.h"
+#include "screen.h"
+
+/* @brief Internal macros */
+#define SWAP_MAGIC "ZEXSWP1\n"
+#define SWAP_MAGIC_LEN 8
+// Record types; the numbers of a record are LEB128 varints
+#define SWP_INSERT 'i' // lnum, col, len, text
+#define SWP_DELETE 'd' // lnum, col, n
+#define SWP_LINES 'l' // lnum, old count, new count, (len, text) per new line
+#define SWP_CHECK 'c' // line count after the records before it
+// Bytes kept in memory before they are written without waiting for a pause
+#define SWAP_BUF_MAX (64 << 10)
+// Pause after a change before its records are written
+#define SWAP_WRITE_IDLE_MS 300
+// Pause after a write before the file is synced; and the longest time
+// written records stay unsynced while typing goes on
+#define SWAP_SYNC_IDLE_MS 1000
+#define SWAP_SYNC_MAX_MS 10000
+
+/* @brief Journal of a buffer */
+typedef struct swapfile {
+    /* name of the journal file */
+    char *path;
+    /* journal file opened for appending */
+    int fd;
+    /* true once a write failed; nothing more is recorded */
+    bool failed;
+    /* encoded records not written yet */
+    char *buf;
+    size_t len, cap;
+    /* text record still growing with the next typed characters; 0 if none */
+    int stage_type;
+    linenr_T stage_lnum;
+    colnr_T stage_col;
+    /* inserted text or number of deleted characters */
+    char *stage_text;
+    size_t stage_len, stage_cap;
+    /* lines replaced by pend_new rows whose text is read once they are
+     * filled; pend_old lines were there before */
+    bool pending;
+    linenr_T pend_lnum, pend_old, pend_new;
+    /* records added since the last SWP_CHECK */
+    bool unchecked;
+    /* records written since the last sync */
+    bool unsynced;
+    /* times in ms of the last change, write and sync */
+    long long last_change, last_write, last_sync;
+    /* next open journal */
+    struct swapfile *next;
+} swap_T;
+
+/* @brief Every open journal */
+static swap_T *swap_list;
+
+static long long
+swap_now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Name of the journal of a file: ".<name>.swp" in the same directory
+static char *
+swap_path(const char *filename)
+{
+    const char *base = strrchr(filename, '/');
+    base = base ? base + 1 : filename;
+
+    size_t dirlen = base - filename;
+    char *path = malloc(dirlen + strlen(base) + 6);
+    memcpy(path, filename, dirlen);
+    sprintf(path + dirlen, ".%s.swp", base);
+    return path;
+}
+
+static void
+swap_reserve(swap_T *sp, size_t n)
+{
+    if (sp->len + n <= sp->cap) return;
+    while (sp->len + n > sp->cap)
+        sp->cap = sp->cap ? sp->cap * 2 : 4096;
+    sp->buf = realloc(sp->buf, sp->cap);
+}
+
+static void
+swap_put_varint(swap_T *sp, uint64_t v)
+{
+    swap_reserve(sp, 10);
+    do {
+        unsigned char b = v & 0x7f;
+        v >>= 7;
+        sp->buf[sp->len++] = b | (v ? 0x80 : 0);
+    } while (v);
+}
+
+static void
+swap_put_record(swap_T *sp, int type, uint64_t a, uint64_t b)
+{
+    swap_reserve(sp, 1);
+    sp->buf[sp->len++] = type;
+    swap_put_varint(sp, a);
+    swap_put_varint(sp, b);
+    sp->unchecked = type != SWP_CHECK;
+}
+
+// Write the encoded records; the journal stops recording if that fails
+static void
+swap_write_out(swap_T *sp)
+{
+    size_t off = 0;
+    while (off < sp->len) {
+        ssize_t n = write(sp->fd, sp->buf + off, sp->len - off);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
+            sp->failed = true;
+            statusbar_set_message("Cannot write swap file \"%s\": %s",
+                                  sp->path, strerror(errno));
+            break;
+        }
+        off += n;
+    }
+    sp->len = 0;
+    sp->unsynced = true;
+    sp->last_write = swap_now_ms();
+}
+
+// Describe the file the records apply to; a journal of another version of
+// it is still replayed but with a warning
+static void
+swap_put_header(swap_T *sp, const char *filename)
+{
+    struct stat st;
+    bool exists = stat(filename, &st) == 0;
+
+    swap_reserve(sp, SWAP_MAGIC_LEN);
+    memcpy(sp->buf + sp->len, SWAP_MAGIC, SWAP_MAGIC_LEN);
+    sp->len += SWAP_MAGIC_LEN;
+    swap_put_varint(sp, exists);
+    swap_put_varint(sp, exists ? (uint64_t)st.st_size : 0);
+    swap_put_varint(sp, exists ? (uint64_t)st.st_mtim.tv_sec : 0);
+    swap_put_varint(sp, exists ? (uint64_t)st.st_mtim.tv_nsec : 0);
+}
+
+static swap_T *
+swap_new(char *path, int fd)
+{
+    swap_T *sp = calloc(1, sizeof(swap_T));
+    sp->path = path;
+    sp->fd = fd;
+    sp->last_sync = swap_now_ms();
+    sp->next = swap_list;
+    swap_list = sp;
+    return sp;
+}
+
+static bool swap_get_varint(const char **p, const char *end, uint64_t *v);
+
+// Check if a journal holds records after its header
+static bool
+swap_has_records(const char *path)
+{
+    char head[64];
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return true;
+    ssize_t n = read(fd, head, sizeof(head));
+    close(fd);
+    if (n < SWAP_MAGIC_LEN || memcmp(head, SWAP_MAGIC, SWAP_MAGIC_LEN) != 0)
+        return n > 0;
+
+    const char *p = head + SWAP_MAGIC_LEN, *end = head + n;
+    uint64_t v;
+    for (int i = 0; i < 4; i++) {
+        if (!swap_get_varint(&p, end, &v)) return true;
+    }
+    return p < end;
+}
+
+bool
+swap_open()
+{
+    econfig.swap = NULL;
+    if (econfig.filename == NULL) return false;
+
+    // A journal without records is left by a session that wrote its file
+    // last; it is taken over
+    char *path = swap_path(econfig.filename);
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST && !swap_has_records(path)) {
+        unlink(path);
+        fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0600);
+    }
+    if (fd == -1) {
+        if (errno == EEXIST)
+            statusbar_set_message("Found swap file \"%s\"; recover with "
+                                  "zex -r %s",
+                                  path, econfig.filename);
+        free(path);
+        return false;
+    }
+
+    swap_T *sp = swap_new(path, fd);
+    swap_put_header(sp, econfig.filename);
+    econfig.swap = sp;
+    return true;
+}
+
+static void
+swap_free(swap_T *sp)
+{
+    close(sp->fd);
+    unlink(sp->path);
+    free(sp->path);
+    free(sp->buf);
+    free(sp->stage_text);
+    free(sp);
+}
+
+void
+swap_close(swap_T *sp)
+{
+    if (sp == NULL) return;
+
+    swap_T **pp = &swap_list;
+    while (*pp != sp)
+        pp = &(*pp)->next;
+    *pp = sp->next;
+    swap_free(sp);
+}
+
+void
+swap_remove_all()
+{
+    while (swap_list) {
+        swap_T *next = swap_list->next;
+        swap_free(swap_list);
+        swap_list = next;
+    }
+}
+
+// Encode the growing text record
+static void
+swap_end_stage(swap_T *sp)
+{
+    if (sp->stage_type == 0) return;
+
+    if (sp->stage_type == SWP_INSERT) {
+        swap_put_record(sp, SWP_INSERT, sp->stage_lnum, sp->stage_col);
+        swap_put_varint(sp, sp->stage_len);
+        swap_reserve(sp, sp->stage_len);
+        memcpy(sp->buf + sp->len, sp->stage_text, sp->stage_len);
+        sp->len += sp->stage_len;
+    }
+    else {
+        swap_put_record(sp, SWP_DELETE, sp->stage_lnum, sp->stage_col);
+        swap_put_varint(sp, sp->stage_len);
+    }
+    sp->stage_type = 0;
+    if (sp->len >= SWAP_BUF_MAX) swap_write_out(sp);
+}
+
+// Encode the replaced lines with the text the rows now hold
+static void
+swap_end_lines(swap_T *sp)
+{
+    if (!sp->pending) return;
+
+    swap_put_record(sp, SWP_LINES, sp->pend_lnum, sp->pend_old);
+    swap_put_varint(sp, sp->pend_new);
+    for (linenr_T i = 0; i < sp->pend_new; i++) {
+        const editor_row_T *row = row_get(sp->pend_lnum + i);
+        size_t len = rbuf_len(row);
+        swap_put_varint(sp, len);
+        swap_reserve(sp, len);
+        rbuf_copy(row, 0, len, sp->buf + sp->len);
+        sp->len += len;
+
+        // Replaced ranges may be as big as the file; stream them
+        if (sp->len >= SWAP_BUF_MAX) swap_write_out(sp);
+    }
+    sp->pending = false;
+}
+
+void
+swap_insert_text(linenr_T lnum, colnr_T col, const char *s, size_t len)
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL || sp->failed || len == 0) return;
+    if (sp->pending) {
+        swap_lines_changed(lnum, lnum + 1, 0);
+        return;
+    }
+
+    // Typed text continues the insertion before it
+    if (sp->stage_type != SWP_INSERT || sp->stage_lnum != lnum
+        || sp->stage_col + sp->stage_len != col)
+    {
+        swap_end_stage(sp);
+        sp->stage_type = SWP_INSERT;
+        sp->stage_lnum = lnum;
+        sp->stage_col = col;
+        sp->stage_len = 0;
+    }
+    if (sp->stage_len + len > sp->stage_cap) {
+        while (sp->stage_len + len > sp->stage_cap)
+            sp->stage_cap = sp->stage_cap ? sp->stage_cap * 2 : 64;
+        sp->stage_text = realloc(sp->stage_text, sp->stage_cap);
+    }
+    memcpy(sp->stage_text + sp->stage_len, s, len);
+    sp->stage_len += len;
+}
+
+void
+swap_delete_text(linenr_T lnum, colnr_T col, size_t n)
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL || sp->failed || n == 0) return;
+    if (sp->pending) {
+        swap_lines_changed(lnum, lnum + 1, 0);
+        return;
+    }
+
+    // Repeated deletes at the same place or backwards join the one before
+    if (sp->stage_type == SWP_DELETE && sp->stage_lnum == lnum
+        && (col == sp->stage_col || col + n == sp->stage_col))
+    {
+        sp->stage_col = col;
+        sp->stage_len += n;
+        return;
+    }
+    swap_end_stage(sp);
+    sp->stage_type = SWP_DELETE;
+    sp->stage_lnum = lnum;
+    sp->stage_col = col;
+    sp->stage_len = n;
+}
+
+void
+swap_lines_changed(linenr_T lnum, linenr_T lnume, long xtra)
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL || sp->failed) return;
+
+    // Changes before the pending lines are read widen them to one range
+    if (sp->pending) {
+        linenr_T hi = sp->pend_lnum + sp->pend_new;
+        linenr_T lo = lnum < sp->pend_lnum ? lnum : sp->pend_lnum;
+        if (lnume > hi) hi = lnume;
+        sp->pend_old = hi - lo + sp->pend_old - sp->pend_new;
+        sp->pend_new = hi - lo + xtra;
+        sp->pend_lnum = lo;
+        return;
+    }
+
+    swap_end_stage(sp);
+    sp->pend_lnum = lnum;
+    sp->pend_old = lnume - lnum;
+    sp->pend_new = lnume - lnum + xtra;
+    sp->pending = true;
+
+    // Deleted lines have no text to wait for
+    if (sp->pend_new == 0) swap_end_lines(sp);
+}
+
+void
+swap_capture()
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL) return;
+
+    sp->last_change = swap_now_ms();
+    if (sp->pending && !sp->failed) swap_end_lines(sp);
+}
+
+void
+swap_flush()
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL || sp->failed) return;
+
+    swap_end_lines(sp);
+    swap_end_stage(sp);
+    // The number of lines is checked once the whole file was read
+    if (sp->unchecked && !file_loading())
+        swap_put_record(sp, SWP_CHECK, econfig.line_count, 0);
+}
+
+void
+swap_idle()
+{
+    long long now = swap_now_ms();
+
+    // The records of the current buffer are completed once typing pauses;
+    // the other buffers were completed when they were left
+    swap_T *cur = econfig.swap;
+    if (cur && now - cur->last_change >= SWAP_WRITE_IDLE_MS) swap_flush();
+
+    for (swap_T *sp = swap_list; sp; sp = sp->next) {
+        if (sp->failed) continue;
+        bool settled =
+            sp != cur || now - sp->last_change >= SWAP_WRITE_IDLE_MS;
+        if (sp->len && settled) swap_write_out(sp);
+
+        // One sync covers everything written since the last one
+        if (sp->unsynced
+            && (now - sp->last_write >= SWAP_SYNC_IDLE_MS
+                || now - sp->last_sync >= SWAP_SYNC_MAX_MS))
+        {
+            fdatasync(sp->fd);
+            sp->unsynced = false;
+            sp->last_sync = now;
+        }
+    }
+}
+
+void
+swap_checkpoint()
+{
+    swap_T *sp = econfig.swap;
+    if (sp == NULL) return;
+
+    // The written file holds every change; the journal starts over from it
+    sp->len = 0;
+    sp->stage_type = 0;
+    sp->pending = false;
+    sp->unchecked = false;
+    sp->failed = ftruncate(sp->fd, 0) == -1;
+    swap_put_header(sp, econfig.filename);
+}
+
+static bool
+swap_get_varint(const char **p, const char *end, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char b = *(*p)++;
+        *v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Apply the record at *p; false if it is cut short or does not fit the rows
+static bool
+swap_replay(const char **p, const char *end)
+{
+    if (*p >= end) return false;
+    int type = *(*p)++;
+
+    uint64_t lnum, arg, n;
+    if (!swap_get_varint(p, end, &lnum) || !swap_get_varint(p, end, &arg))
+        return false;
+    if (type == SWP_CHECK) return lnum == econfig.line_count;
+    if (!swap_get_varint(p, end, &n)) return false;
+
+    if (type == SWP_INSERT) {
+        if (n > (uint64_t)(end - *p) || lnum >= econfig.line_count
+            || arg > rbuf_len(&econfig.rows[lnum]))
+            return false;
+        row_insert_str(row_get(lnum), arg, *p, n);
+        *p += n;
+        return true;
+    }
+    if (type == SWP_DELETE) {
+        if (lnum >= econfig.line_count
+            || arg + n > rbuf_len(&econfig.rows[lnum]))
+            return false;
+        row_delete_chars(row_get(lnum), arg, n);
+        return true;
+    }
+    if (type != SWP_LINES || lnum > econfig.line_count
+        || arg > econfig.line_count - lnum)
+        return false;
+
+    // Check that the text of every new line is there before changing rows
+    const char *text = *p;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t len;
+        if (!swap_get_varint(p, end, &len) || len > (uint64_t)(end - *p))
+            return false;
+        *p += len;
+    }
+
+    if (arg) row_delete_range(lnum, arg);
+    editor_row_T *rows = n ? row_open_range(lnum, n) : NULL;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t len;
+        swap_get_varint(&text, end, &len);
+        rbuf_init(&rows[i]);
+        rows[i].render = NULL;
+        rbuf_insertn(&rows[i], text, len);
+        row_update(&rows[i]);
+        text += len;
+    }
+    return true;
+}
+
+long
+swap_recover(const char *filename)
+{
+    // The changes were made to the whole file
+    file_load_finish();
+
+    char *path = swap_path(filename);
+    int fd = open(path, O_RDWR | O_APPEND);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1 || st.st_size < SWAP_MAGIC_LEN) {
+        if (fd != -1) close(fd);
+        free(path);
+        return -1;
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED
+        || memcmp(data, SWAP_MAGIC, SWAP_MAGIC_LEN) != 0)
+    {
+        if (data != MAP_FAILED) munmap(data, st.st_size);
+        close(fd);
+        free(path);
+        return -1;
+    }
+    const char *p = data + SWAP_MAGIC_LEN, *end = data + st.st_size;
+
+    // The file the journal started from
+    uint64_t exists, size, sec, nsec;
+    swap_get_varint(&p, end, &exists);
+    swap_get_varint(&p, end, &size);
+    swap_get_varint(&p, end, &sec);
+    swap_get_varint(&p, end, &nsec);
+    struct stat fst;
+    bool same = stat(filename, &fst) == 0
+                    ? exists && size == (uint64_t)fst.st_size
+                          && sec == (uint64_t)fst.st_mtim.tv_sec
+                          && nsec == (uint64_t)fst.st_mtim.tv_nsec
+                    : !exists;
+
+    // Replay up to the last complete record; a record cut short by the
+    // crash and anything after a failed check is dropped
+    long changes = 0;
+    const char *good = p;
+    while (p < end) {
+        int type = *p;
+        if (!swap_replay(&p, end)) break;
+        if (type != SWP_CHECK) changes++;
+        good = p;
+    }
+    size_t keep = good - data;
+    munmap(data, st.st_size);
+    if (keep < (size_t)st.st_size && ftruncate(fd, keep) == -1) {
+        close(fd);
+        free(path);
+        return -1;
+    }
+
+    // The journal goes on from the recovered text
+    swap_T *sp = swap_new(path, fd);
+    econfig.swap = sp;
+    statusbar_set_message("Recovered %ld changes from \"%s\"%s", changes, path,
+                          same ? "" : "; the file changed since");
+    return changes;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file swap.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for the swap journal
+ */
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "config.h"
+
+/**
+ * @brief Start the journal of the current buffer; econfig.swap
+ *
+ * The journal is ".<name>.swp" next to the file and records the changes made
+ * since the file was read. It is not started if that file already exists;
+ * the changes it holds are left for swap_recover.
+ *
+ * @return False if there is no journal for the buffer
+ */
+bool swap_open();
+
+/**
+ * @brief Stop a journal and remove its file
+ *
+ * @param sp Journal of a buffer; NULL is ignored
+ */
+void swap_close(struct swapfile *sp);
+
+/* @brief Remove the files of every journal; the editor exits normally */
+void swap_remove_all();
+
+/**
+ * @brief Record text inserted into a row of the current buffer
+ *
+ * Text typed in a run is kept as a single record.
+ *
+ * @param lnum Index of the row
+ * @param col Index of the first inserted character
+ * @param s Inserted text
+ * @param len Length of the text
+ */
+void swap_insert_text(linenr_T lnum, colnr_T col, const char *s, size_t len);
+
+/**
+ * @brief Record text deleted from a row of the current buffer
+ *
+ * @param lnum Index of the row
+ * @param col Index of the first deleted character
+ * @param n Number of deleted characters
+ */
+void swap_delete_text(linenr_T lnum, colnr_T col, size_t n);
+
+/**
+ * @brief Record lines of the current buffer replaced by other lines
+ *
+ * The text of the new lines is read when the journal is flushed, so the rows
+ * may be filled after this call.
+ *
+ * @param lnum Index of the first replaced line
+ * @param lnume Index after the last replaced line
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void swap_lines_changed(linenr_T lnum, linenr_T lnume, long xtra);
+
+/**
+ * @brief Read the text of the lines changed so far into their record
+ *
+ * Called before every key is read, when the rows hold the text of every
+ * change made by the commands before it.
+ */
+void swap_capture();
+
+/**
+ * @brief Complete the records of the current buffer up to a check of its
+ *        line count; they are written later
+ */
+void swap_flush();
+
+/**
+ * @brief Write the records to the journal file
+ *
+ * Called while no key is typed. The file is synced once typing pauses long
+ * enough, or at least every few seconds while it goes on.
+ */
+void swap_idle();
+
+/* @brief Drop the records of the current buffer; its file was written */
+void swap_checkpoint();
+
+/**
+ * @brief Apply the changes of a journal left by a lost session
+ *
+ * The file must have been read into the current buffer. The journal records
+ * the following changes again.
+ *
+ * @param filename Name of the file of the journal
+ * @return Number of changes applied or -1 if there is no journal
+ */
+long swap_recover(const char *filename);
+
+#endif /* SWAP_H */
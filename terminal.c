@@ -4,12 +4,19 @@
  * @brief Source file containing function definitions of terminal operations
  */
 
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+#define _BSD_SOURCE
+
 #include "terminal.h"
 
 #include <sys/ioctl.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 
 #include "config.h"
 #include "logger.h"
@@ -24,9 +31,12 @@ term_disable_raw_mode()
 void
 term_enable_raw_mode()
 {
-    // Disable raw mode at exit
+    // Disable raw mode at exit; raw mode is enabled again after running a
+    // shell command but only registered once
+    static int registered = 0;
     if (tcgetattr(STDIN_FILENO, &econfig.orig_termios) == -1) die("tcgetattr");
-    atexit(term_disable_raw_mode);
+    if (!registered) atexit(term_disable_raw_mode);
+    registered = 1;
 
     // Set terminal attributes
     struct termios raw = econfig.orig_termios;
@@ -40,6 +50,18 @@ term_enable_raw_mode()
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
 }
 
+int
+term_stdin_from_tty()
+{
+    // The old standard input is kept from shell commands
+    int fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    int tty = open("/dev/tty", O_RDWR);
+    if (fd == -1 || tty == -1 || dup2(tty, STDIN_FILENO) == -1)
+        die("/dev/tty");
+    close(tty);
+    return fd;
+}
+
 int
 term_get_cursor_pos(int *rows, int *cols)
 {
@@ -83,3 +105,45 @@ term_get_window_sz(int *rows, int *cols)
         return 0;
     }
 }
+
+int
+term_query_sync_output()
+{
+    const char *query = "\x1b[?2026$p\x1b[c";
+    if (term_write(query, strlen(query)) == -1) return 0;
+
+    // Read the replies until the end of the DA1 reply; a read times out after
+    // VTIME if the terminal doesn't answer at all
+    char buf[128];
+    unsigned int i = 0;
+    while (i < sizeof(buf) - 1) {
+        if (read(STDIN_FILENO, &buf[i], 1) != 1) break;
+        if (buf[i] == 'c') break;
+        i++;
+    }
+    buf[i] = '\0';
+
+    // DECRPM reply; 1 (set) and 2 (reset) mean the mode can be switched
+    int mode;
+    char *reply = strstr(buf, "\x1b[?2026;");
+    if (reply == NULL || sscanf(reply + 8, "%d$y", &mode) != 1) return 0;
+
+    return mode == 1 || mode == 2;
+}
+
+int
+term_write(const char *buf, size_t len)
+{
+    // Write in a loop as the terminal may accept only part of a large frame
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n == -1) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
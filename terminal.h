@@ -7,12 +7,23 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include <stddef.h>
+
 /* @brief Disable raw mode/non-canonical mode */
 void term_disable_raw_mode();
 
 /* @brief Enable raw mode/non-canonical mode */
 void term_enable_raw_mode();
 
+/**
+ * @brief Read keys from the terminal instead of the standard input
+ *
+ * The standard input gives text to edit; /dev/tty takes its place.
+ *
+ * @return Descriptor of the old standard input
+ */
+int term_stdin_from_tty();
+
 /**
  * @brief Get the current position of the cursor on the terminal
  *
@@ -29,4 +40,24 @@ int term_get_cursor_pos(int *numrows, int *numcols);
  */
 int term_get_window_sz(int *numrows, int *numcols);
 
+/**
+ * @brief Query whether the terminal supports synchronized output
+ *
+ * Requests the state of DEC private mode 2026 (DECRQM) followed by the
+ * primary device attributes (DA1), which every terminal answers, so that
+ * terminals ignoring the mode request don't stall the query.
+ *
+ * @return 1 if the mode is supported, 0 otherwise
+ */
+int term_query_sync_output();
+
+/**
+ * @brief Write the whole buffer to the terminal
+ *
+ * @param buf Bytes to write
+ * @param len Number of bytes
+ * @return 0 on success, -1 on error
+ */
+int term_write(const char *buf, size_t len);
+
 #endif /* TERMINAL_H */
@@ -0,0 +1,400 @@
+/**
+ * @file win.c
+ * @author re-nanashi
+ * @brief Windows viewing buffers; every window shows the rows of its buffer
+ * without a copy of them
+ */
+
+#include "win.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "buflist.h"
+#include "bracket.h"
+#include "byteidx.h"
+#include "fold.h"
+#include "input.h"
+
+/* @brief Internal macros */
+// Layouts of a frame
+#define FR_LEAF 0 // holds a window
+#define FR_ROW 1 // children side by side
+#define FR_COL 2 // children stacked
+
+/* @brief Part of the screen; a window or two frames splitting it */
+typedef struct winframe {
+    /* FR_ layout */
+    int layout;
+    /* frame split into this one and its sibling; NULL for the whole screen */
+    struct winframe *parent;
+    /* top or left frame, bottom or right frame */
+    struct winframe *child[2];
+    /* window of a leaf frame */
+    win_T *win;
+    /* position and size given by the last layout; includes status bars and
+     * separators */
+    int row, col, height, width;
+} winframe_T;
+
+/* @brief Layout of the whole screen */
+static winframe_T *topframe;
+/* @brief Windows from top left to bottom right */
+static win_T **windows;
+static int nwindows;
+/* @brief Window the editor shows the cursor of */
+static win_T *curwin;
+
+// Collect the windows of a frame in order
+static void
+win_collect(winframe_T *fr)
+{
+    if (fr->layout == FR_LEAF) {
+        windows[nwindows++] = fr->win;
+        return;
+    }
+    win_collect(fr->child[0]);
+    win_collect(fr->child[1]);
+}
+
+// Rebuild the list of windows after the layout changed
+static void
+win_update_list(int count)
+{
+    windows = realloc(windows, sizeof(win_T *) * count);
+    nwindows = 0;
+    win_collect(topframe);
+}
+
+static winframe_T *
+win_new_leaf(win_T *wp)
+{
+    winframe_T *fr = calloc(1, sizeof(winframe_T));
+    fr->layout = FR_LEAF;
+    fr->win = wp;
+    wp->frame = fr;
+    return fr;
+}
+
+static void
+win_free(win_T *wp)
+{
+    free(wp->cache);
+    fold_free(wp->folds);
+    free(wp);
+}
+
+// Free a frame and every window in it
+static void
+win_free_frame(winframe_T *fr, win_T *keep)
+{
+    if (fr->layout == FR_LEAF) {
+        if (fr->win != keep) win_free(fr->win);
+    }
+    else {
+        win_free_frame(fr->child[0], keep);
+        win_free_frame(fr->child[1], keep);
+    }
+    free(fr);
+}
+
+// Copy the view of the editor to the current window
+static void
+win_save()
+{
+    curwin->buf = buflist_current();
+    curwin->cx = econfig.cx;
+    curwin->cy = econfig.cy;
+    curwin->rx = econfig.rx;
+    curwin->col_offset = econfig.col_offset;
+    curwin->row_offset = econfig.row_offset;
+}
+
+// Make a window the current one; the editor takes its buffer and view
+static void
+win_enter(win_T *wp)
+{
+    if (wp == curwin) return;
+    win_save();
+
+    curwin = wp;
+    buflist_enter(wp->buf);
+    econfig.cx = wp->cx;
+    econfig.cy = wp->cy;
+    econfig.rx = wp->rx;
+    econfig.col_offset = wp->col_offset;
+    econfig.row_offset = wp->row_offset;
+    econfig.screenrows = wp->height;
+    econfig.screencols = wp->width;
+
+    // Lines may have been deleted through another window
+    if (econfig.cy >= econfig.line_count) {
+        econfig.cy = econfig.line_count ? econfig.line_count - 1 : 0;
+        econfig.cx = 0;
+    }
+    else if (econfig.cx > rbuf_len(&econfig.rows[econfig.cy])) {
+        econfig.cx = 0;
+    }
+}
+
+void
+win_init()
+{
+    curwin = calloc(1, sizeof(win_T));
+    curwin->buf = buflist_current();
+    topframe = win_new_leaf(curwin);
+    win_update_list(1);
+}
+
+// Give a frame and the frames in it their place on the screen
+static void
+win_layout_frame(winframe_T *fr, int row, int col, int height, int width)
+{
+    fr->row = row;
+    fr->col = col;
+    fr->height = height;
+    fr->width = width;
+
+    if (fr->layout == FR_LEAF) {
+        // The last row is the status bar
+        win_T *wp = fr->win;
+        wp->row = row;
+        wp->col = col;
+        wp->height = height > 1 ? height - 1 : 0;
+        wp->width = width > 0 ? width : 0;
+    }
+    else if (fr->layout == FR_COL) {
+        int top = height / 2;
+        win_layout_frame(fr->child[0], row, col, top, width);
+        win_layout_frame(fr->child[1], row + top, col, height - top, width);
+    }
+    else {
+        // A column between the frames separates them
+        int left = (width - 1) / 2;
+        win_layout_frame(fr->child[0], row, col, height, left);
+        win_layout_frame(fr->child[1], row, col + left + 1, height,
+                         width - left - 1);
+    }
+}
+
+void
+win_layout(int rows, int cols)
+{
+    win_save();
+    win_layout_frame(topframe, 0, 0, rows, cols);
+    econfig.screenrows = curwin->height;
+    econfig.screencols = curwin->width;
+}
+
+win_T *
+win_current()
+{
+    return curwin;
+}
+
+int
+win_count()
+{
+    return nwindows;
+}
+
+win_T *
+win_get(int i)
+{
+    return i < nwindows ? windows[i] : NULL;
+}
+
+bool
+win_split(bool vertical)
+{
+    // Both windows need a text row and a status bar, or a text column
+    winframe_T *fr = curwin->frame;
+    if (vertical ? fr->width < 3 : fr->height < 4) {
+        statusbar_set_message("Not enough room");
+        return false;
+    }
+
+    win_save();
+    win_T *wp = malloc(sizeof(win_T));
+    *wp = *curwin;
+    wp->cache = NULL;
+    wp->cache_valid = false;
+    wp->folds = fold_copy(curwin->folds);
+
+    // The leaf becomes the parent of the new window and the current one
+    fr->layout = vertical ? FR_ROW : FR_COL;
+    fr->child[0] = win_new_leaf(wp);
+    fr->child[1] = win_new_leaf(curwin);
+    fr->child[0]->parent = fr->child[1]->parent = fr;
+    fr->win = NULL;
+    win_update_list(nwindows + 1);
+
+    // Same buffer and view; only the window changes
+    curwin = wp;
+    return true;
+}
+
+bool
+win_close()
+{
+    winframe_T *fr = curwin->frame;
+    winframe_T *parent = fr->parent;
+    if (parent == NULL) return false;
+
+    // The sibling takes the place of the parent
+    winframe_T *sib = parent->child[parent->child[0] == fr ? 1 : 0];
+    parent->layout = sib->layout;
+    parent->win = sib->win;
+    parent->child[0] = sib->child[0];
+    parent->child[1] = sib->child[1];
+    if (parent->layout == FR_LEAF) {
+        parent->win->frame = parent;
+    }
+    else {
+        parent->child[0]->parent = parent;
+        parent->child[1]->parent = parent;
+    }
+    free(sib);
+    free(fr);
+    win_update_list(nwindows - 1);
+
+    // The cursor goes to the first window where the closed one was
+    winframe_T *next = parent;
+    while (next->layout != FR_LEAF)
+        next = next->child[0];
+    win_T *closed = curwin;
+    win_enter(next->win);
+    win_free(closed);
+    return true;
+}
+
+void
+win_only()
+{
+    if (nwindows == 1) return;
+
+    win_free_frame(topframe, curwin);
+    topframe = win_new_leaf(curwin);
+    win_update_list(1);
+}
+
+// Window at a screen position; NULL if there is none
+static win_T *
+win_at(int row, int col)
+{
+    for (int i = 0; i < nwindows; i++) {
+        winframe_T *fr = windows[i]->frame;
+        if (row >= fr->row && row < fr->row + fr->height && col >= fr->col
+            && col < fr->col + fr->width)
+            return windows[i];
+    }
+    return NULL;
+}
+
+// Go to the window next to the current one in a direction given by a key
+static void
+win_goto_dir(int key, long count)
+{
+    for (long n = 0; n < count; n++) {
+        winframe_T *fr = curwin->frame;
+        // The cursor position picks between the windows along the edge
+        int row = curwin->row + (int)(econfig.cy - econfig.row_offset);
+        int col = curwin->col + (int)(econfig.rx - econfig.col_offset);
+
+        win_T *wp = NULL;
+        if (key == 'h') wp = win_at(row, fr->col - 2);
+        if (key == 'l') wp = win_at(row, fr->col + fr->width + 1);
+        if (key == 'k') wp = win_at(fr->row - 1, col);
+        if (key == 'j') wp = win_at(fr->row + fr->height, col);
+        if (wp == NULL) break;
+        win_enter(wp);
+    }
+}
+
+void
+win_command(int key, long count)
+{
+    // Ctrl-W with a control key works like the letter
+    if (key >= 1 && key <= 26) key += 'a' - 1;
+
+    int idx = 0;
+    while (idx < nwindows && windows[idx] != curwin)
+        idx++;
+
+    switch (key) {
+        case 's':
+        case 'S':
+            win_split(false);
+            break;
+
+        case 'v':
+            win_split(true);
+            break;
+
+        // Next or previous window, or the count-th one
+        case 'w':
+        case 'W':
+            if (count)
+                idx = (count <= nwindows ? count : nwindows) - 1;
+            else
+                idx = (idx + (key == 'w' ? 1 : nwindows - 1)) % nwindows;
+            win_enter(windows[idx]);
+            break;
+
+        case 't':
+            win_enter(windows[0]);
+            break;
+
+        case 'b':
+            win_enter(windows[nwindows - 1]);
+            break;
+
+        case 'h':
+        case 'j':
+        case 'k':
+        case 'l':
+            win_goto_dir(key, count ? count : 1);
+            break;
+
+        case 'c':
+        case 'q':
+            if (!win_close()) statusbar_set_message("Cannot close last window");
+            break;
+
+        case 'o':
+            win_only();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void
+win_changed_lines(linenr_T lnum, linenr_T lnume, long xtra)
+{
+    int cur = buflist_current();
+    byteidx_changed_lines(lnum, lnume, xtra);
+    bracket_changed_lines(lnum, lnume, xtra);
+    for (int i = 0; i < nwindows; i++) {
+        win_T *wp = windows[i];
+        fold_changed_lines(wp->folds, lnum, lnume, xtra);
+        if (!wp->cache_valid || wp->cache_buf != cur) continue;
+
+        // Lines added or removed above a window move the lines it shows;
+        // lines changed past its last line show when it reached the end
+        linenr_T top = wp->cache_top, bot = wp->cache_bot;
+        if ((lnum < bot || wp->cache_eof) && (lnume > top || xtra != 0))
+            wp->cache_valid = false;
+    }
+}
+
+bool
+win_shows_buffer(int buf)
+{
+    for (int i = 0; i < nwindows; i++) {
+        if (windows[i] != curwin && windows[i]->buf == buf) return true;
+    }
+    return false;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file win.h
+ * @author re-nanashi
+ * @brief Header file containing declarations for windows
+ */
+
+#ifndef WIN_H
+#define WIN_H
+
+#include <stdbool.h>
+
+#include "config.h"
+#include "screen.h"
+
+/* @brief View of a buffer on part of the screen */
+typedef struct window {
+    /* index of the shown buffer in the buffer list */
+    int buf;
+    /* cursor and scroll position; kept in the editor while current */
+    colnr_T cx;
+    linenr_T cy;
+    colnr_T rx;
+    colnr_T col_offset;
+    linenr_T row_offset;
+    /* position and size of the text area on the screen; the status bar of
+     * the window is the row below it */
+    int row;
+    int col;
+    int height;
+    int width;
+    /* text area cells drawn last; reused until an edit touches the lines
+     * the window shows or the view changes */
+    screen_cell_T *cache;
+    /* view the cache was drawn for */
+    int cache_buf;
+    linenr_T cache_top;
+    colnr_T cache_left;
+    /* screen lines of the top row not shown; -1 if rows are not wrapped */
+    long cache_skip;
+    /* line after the last line shown */
+    linenr_T cache_bot;
+    /* true if screen lines past the last line of the buffer were drawn;
+     * lines added at the end are shown there */
+    bool cache_eof;
+    int cache_height;
+    int cache_width;
+    /* false once the cache no longer matches the shown lines */
+    bool cache_valid;
+    /* folds made in the window; NULL if none were */
+    struct foldset *folds;
+    /* frame of the layout holding the window */
+    struct winframe *frame;
+} win_T;
+
+/* @brief Create the first window; shows the current buffer */
+void win_init();
+
+/**
+ * @brief Lay the windows out on the screen
+ *
+ * The size of the current window becomes the size of the editor screen.
+ *
+ * @param rows Rows for the windows and their status bars
+ * @param cols Cols for the windows and their separators
+ */
+void win_layout(int rows, int cols);
+
+/* @brief Get the current window */
+win_T *win_current();
+
+/* @brief Get the number of windows */
+int win_count();
+
+/**
+ * @brief Get a window; windows are ordered from top left to bottom right
+ *
+ * @param i Index of the window
+ */
+win_T *win_get(int i);
+
+/**
+ * @brief Split the current window in two showing the same buffer
+ *
+ * The new window is above, or left of it when vertical, and becomes the
+ * current window.
+ *
+ * @param vertical True to put the windows side by side
+ * @return False if there is no room
+ */
+bool win_split(bool vertical);
+
+/**
+ * @brief Close the current window; the buffer stays in the buffer list
+ *
+ * @return False if it is the last window
+ */
+bool win_close();
+
+/* @brief Close every window except the current one */
+void win_only();
+
+/**
+ * @brief Execute a window command typed after Ctrl-W
+ *
+ * @param key Key typed after Ctrl-W
+ * @param count Count typed before Ctrl-W; 0 if none
+ */
+void win_command(int key, long count);
+
+/**
+ * @brief Invalidate the drawn text of windows showing changed lines
+ *
+ * The folds of the windows, the byte index and the bracket depths move with
+ * the lines.
+ *
+ * @param lnum First changed line of the current buffer
+ * @param lnume Line after the last changed line
+ * @param xtra Number of lines added after them; negative if removed
+ */
+void win_changed_lines(linenr_T lnum, linenr_T lnume, long xtra);
+
+/**
+ * @brief Check if a window other than the current one shows a buffer
+ *
+ * @param buf Index of the buffer in the buffer list
+ */
+bool win_shows_buffer(int buf);
+
+#endif /* WIN_H */